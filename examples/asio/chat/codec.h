@@ -1,10 +1,7 @@
 #ifndef MUDUO_EXAMPLES_ASIO_CHAT_CODEC_H
 #define MUDUO_EXAMPLES_ASIO_CHAT_CODEC_H
 
-#include "muduo/base/Logging.h"
-#include "muduo/net/Buffer.h"
-#include "muduo/net/Endian.h"
-#include "muduo/net/TcpConnection.h"
+#include "muduo/net/codec/LengthFieldCodec.h"
 
 class LengthHeaderCodec : muduo::noncopyable
 {
@@ -13,8 +10,12 @@ class LengthHeaderCodec : muduo::noncopyable
                                 const muduo::string& message,
                                 muduo::Timestamp)> StringMessageCallback;
 
+  // 4-byte big endian length, up to 64KiB
+  typedef muduo::net::LengthFieldCodec<muduo::net::FixedLengthField<4>, 65536> Codec;
+
   explicit LengthHeaderCodec(const StringMessageCallback& cb)
-    : messageCallback_(cb)
+    : messageCallback_(cb),
+      codec_(std::bind(&LengthHeaderCodec::onFrames, this, muduo::_1, muduo::_2, muduo::_3))
   {
   }
 
@@ -22,30 +23,7 @@ class LengthHeaderCodec : muduo::noncopyable
                  muduo::net::Buffer* buf,
                  muduo::Timestamp receiveTime)
   {
-    while (buf->readableBytes() >= kHeaderLen) // kHeaderLen == 4
-    {
-      // FIXME: use Buffer::peekInt32()
-      const void* data = buf->peek();
-      int32_t be32 = *static_cast<const int32_t*>(data); // SIGBUS
-      const int32_t len = muduo::net::sockets::networkToHost32(be32);
-      if (len > 65536 || len < 0)
-      {
-        LOG_ERROR << "Invalid length " << len;
-        conn->shutdown();  // FIXME: disable reading
-        break;
-      }
-      else if (buf->readableBytes() >= len + kHeaderLen)
-      {
-        buf->retrieve(kHeaderLen);
-        muduo::string message(buf->peek(), len);
-        messageCallback_(conn, message, receiveTime);
-        buf->retrieve(len);
-      }
-      else
-      {
-        break;
-      }
-    }
+    codec_.onMessage(conn, buf, receiveTime);
   }
 
   // FIXME: TcpConnectionPtr
@@ -53,16 +31,23 @@ class LengthHeaderCodec : muduo::noncopyable
             const muduo::StringPiece& message)
   {
     muduo::net::Buffer buf;
-    buf.append(message.data(), message.size());
-    int32_t len = static_cast<int32_t>(message.size());
-    int32_t be32 = muduo::net::sockets::hostToNetwork32(len);
-    buf.prepend(&be32, sizeof be32);
+    Codec::encode(&buf, message);
     conn->send(&buf);
   }
 
  private:
+  void onFrames(const muduo::net::TcpConnectionPtr& conn,
+                const Codec::Frames& frames,
+                muduo::Timestamp receiveTime)
+  {
+    for (const muduo::StringPiece& frame : frames)
+    {
+      messageCallback_(conn, frame.as_string(), receiveTime);
+    }
+  }
+
   StringMessageCallback messageCallback_;
-  const static size_t kHeaderLen = sizeof(int32_t);
+  Codec codec_;
 };
 
 #endif  // MUDUO_EXAMPLES_ASIO_CHAT_CODEC_H
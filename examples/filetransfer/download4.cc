@@ -0,0 +1,69 @@
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpServer.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char* g_file = NULL;
+
+// file data goes from page cache to socket by sendfile(2), no user space copy.
+void onFileSent(int fd, const TcpConnectionPtr& conn, bool complete)
+{
+  ::close(fd);
+  LOG_INFO << "FileServer - " << (complete ? "done" : "aborted");
+  conn->shutdown();
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  LOG_INFO << "FileServer - " << conn->peerAddress().toIpPort() << " -> "
+           << conn->localAddress().toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+  if (conn->connected())
+  {
+    LOG_INFO << "FileServer - Sending file " << g_file
+             << " to " << conn->peerAddress().toIpPort();
+    int fd = ::open(g_file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && ::fstat(fd, &st) == 0)
+    {
+      conn->sendFile(fd, 0, st.st_size, std::bind(onFileSent, fd, _1, _2));
+    }
+    else
+    {
+      if (fd >= 0)
+      {
+        ::close(fd);
+      }
+      conn->shutdown();
+      LOG_INFO << "FileServer - no such file";
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  LOG_INFO << "pid = " << getpid();
+  if (argc > 1)
+  {
+    g_file = argv[1];
+
+    EventLoop loop;
+    InetAddress listenAddr(2021);
+    TcpServer server(&loop, listenAddr, "FileServer");
+    server.setConnectionCallback(onConnection);
+    server.start();
+    loop.loop();
+  }
+  else
+  {
+    fprintf(stderr, "Usage: %s file_for_downloading\n", argv[0]);
+  }
+}
+
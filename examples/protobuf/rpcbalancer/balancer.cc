@@ -7,6 +7,8 @@
 #include "muduo/net/protorpc/RpcCodec.h"
 #include "muduo/net/protorpc/rpc.pb.h"
 
+#include <map>
+
 #include <stdio.h>
 #include <unistd.h>
 
@@ -9,6 +9,8 @@
 #include "muduo/net/protorpc/RpcCodec.h"
 #include "muduo/net/protorpc/rpc.pb.h"
 
+#include <map>
+
 #include <endian.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -1,5 +1,7 @@
 #include "examples/socks4a/tunnel.h"
 
+#include <map>
+
 #include <malloc.h>
 #include <stdio.h>
 #include <sys/resource.h>
@@ -4,6 +4,7 @@
 #include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/InetAddress.h"
+#include "muduo/net/Relay.h"
 #include "muduo/net/TcpClient.h"
 #include "muduo/net/TcpServer.h"
 
@@ -36,10 +37,7 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
         std::bind(&Tunnel::onClientConnection, shared_from_this(), _1));
     client_.setMessageCallback(
         std::bind(&Tunnel::onClientMessage, shared_from_this(), _1, _2, _3));
-    serverConn_->setHighWaterMarkCallback(
-        std::bind(&Tunnel::onHighWaterMarkWeak,
-                  std::weak_ptr<Tunnel>(shared_from_this()), kServer, _1, _2),
-        1024*1024);
+    serverConn_->setHighWaterMark(kHighWaterMark);
   }
 
   void connect()
@@ -68,21 +66,20 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
 
   void onClientConnection(const muduo::net::TcpConnectionPtr& conn)
   {
-    using std::placeholders::_1;
-    using std::placeholders::_2;
-
     LOG_DEBUG << (conn->connected() ? "UP" : "DOWN");
     if (conn->connected())
     {
       conn->setTcpNoDelay(true);
-      conn->setHighWaterMarkCallback(
-          std::bind(&Tunnel::onHighWaterMarkWeak,
-                    std::weak_ptr<Tunnel>(shared_from_this()), kClient, _1, _2),
-          1024*1024);
+      conn->setHighWaterMark(kHighWaterMark);
+      // stop reading one side while the other side can't keep up
+      conn->throttle(serverConn_);
+      serverConn_->throttle(conn);
       serverConn_->setContext(conn);
-      serverConn_->startRead();
       clientConn_ = conn;
-      if (serverConn_->inputBuffer()->readableBytes() > 0)
+      // splice(2) both ways, falls back to copying through Buffer
+      bool relayed = static_cast<bool>(muduo::net::Relay::start(serverConn_, conn));
+      serverConn_->startRead();
+      if (!relayed && serverConn_->inputBuffer()->readableBytes() > 0)
       {
         conn->send(serverConn_->inputBuffer());
       }
@@ -109,83 +106,9 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
     }
   }
 
-  enum ServerClient
-  {
-    kServer, kClient
-  };
-
-  void onHighWaterMark(ServerClient which,
-                       const muduo::net::TcpConnectionPtr& conn,
-                       size_t bytesToSent)
-  {
-    using std::placeholders::_1;
-
-    LOG_INFO << (which == kServer ? "server" : "client")
-             << " onHighWaterMark " << conn->name()
-             << " bytes " << bytesToSent;
-
-    if (which == kServer)
-    {
-      if (serverConn_->outputBuffer()->readableBytes() > 0)
-      {
-        clientConn_->stopRead();
-        serverConn_->setWriteCompleteCallback(
-            std::bind(&Tunnel::onWriteCompleteWeak,
-                      std::weak_ptr<Tunnel>(shared_from_this()), kServer, _1));
-      }
-    }
-    else
-    {
-      if (clientConn_->outputBuffer()->readableBytes() > 0)
-      {
-        serverConn_->stopRead();
-        clientConn_->setWriteCompleteCallback(
-            std::bind(&Tunnel::onWriteCompleteWeak,
-                      std::weak_ptr<Tunnel>(shared_from_this()), kClient, _1));
-      }
-    }
-  }
-
-  static void onHighWaterMarkWeak(const std::weak_ptr<Tunnel>& wkTunnel,
-                                  ServerClient which,
-                                  const muduo::net::TcpConnectionPtr& conn,
-                                  size_t bytesToSent)
-  {
-    std::shared_ptr<Tunnel> tunnel = wkTunnel.lock();
-    if (tunnel)
-    {
-      tunnel->onHighWaterMark(which, conn, bytesToSent);
-    }
-  }
-
-  void onWriteComplete(ServerClient which, const muduo::net::TcpConnectionPtr& conn)
-  {
-    LOG_INFO << (which == kServer ? "server" : "client")
-             << " onWriteComplete " << conn->name();
-    if (which == kServer)
-    {
-      clientConn_->startRead();
-      serverConn_->setWriteCompleteCallback(muduo::net::WriteCompleteCallback());
-    }
-    else
-    {
-      serverConn_->startRead();
-      clientConn_->setWriteCompleteCallback(muduo::net::WriteCompleteCallback());
-    }
-  }
-
-  static void onWriteCompleteWeak(const std::weak_ptr<Tunnel>& wkTunnel,
-                                  ServerClient which,
-                                  const muduo::net::TcpConnectionPtr& conn)
-  {
-    std::shared_ptr<Tunnel> tunnel = wkTunnel.lock();
-    if (tunnel)
-    {
-      tunnel->onWriteComplete(which, conn);
-    }
-  }
-
  private:
+  static const size_t kHighWaterMark = 1024*1024;
+
   muduo::net::TcpClient client_;
   muduo::net::TcpConnectionPtr serverConn_;
   muduo::net::TcpConnectionPtr clientConn_;
@@ -52,8 +52,22 @@ string Timestamp::toFormattedString(bool showMicroseconds) const
   return buf;
 }
 
+namespace
+{
+Timestamp::Clock g_clock = NULL;
+}
+
+void Timestamp::setClock(Clock clock)
+{
+  g_clock = clock;
+}
+
 Timestamp Timestamp::now()
 {
+  if (g_clock)
+  {
+    return g_clock();
+  }
   struct timeval tv;
   gettimeofday(&tv, NULL);
   int64_t seconds = tv.tv_sec;
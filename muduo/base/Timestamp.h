@@ -66,6 +66,15 @@ namespace muduo
     /// Get time of now.
     ///
     static Timestamp now();
+
+    ///
+    /// Replaces the clock of now(), eg. by a simulation's virtual clock,
+    /// NULL restores gettimeofday(). Not thread safe, set it before
+    /// starting any thread.
+    ///
+    typedef Timestamp (*Clock)();
+    static void setClock(Clock clock);
+
     static Timestamp invalid()
     {
       return Timestamp();
@@ -26,7 +26,9 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     : loop_(loop),
       acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),
       acceptChannel_(loop, acceptSocket_.fd()),
+      acceptBatch_(1),
       listening_(false),
+      paused_(false),
       idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
   assert(idleFd_ >= 0);
@@ -36,6 +38,24 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
   acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listenFd)
+    : loop_(loop),
+      acceptSocket_(listenFd),
+      acceptChannel_(loop, listenFd),
+      acceptBatch_(1),
+      listening_(false),
+      paused_(false),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+{
+  assert(idleFd_ >= 0);
+  // flags of the open file description came along, but don't count on it
+  int flags = ::fcntl(listenFd, F_GETFL, 0);
+  ::fcntl(listenFd, F_SETFL, flags | O_NONBLOCK);
+  flags = ::fcntl(listenFd, F_GETFD, 0);
+  ::fcntl(listenFd, F_SETFD, flags | FD_CLOEXEC);
+  acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
   acceptChannel_.disableAll();
@@ -48,7 +68,36 @@ void Acceptor::listen()
   loop_->assertInLoopThread();
   listening_ = true;
   acceptSocket_.listen();
-  acceptChannel_.enableReading();
+  if (!paused_)
+  {
+    acceptChannel_.enableReading();
+  }
+}
+
+void Acceptor::pause()
+{
+  loop_->assertInLoopThread();
+  if (!paused_)
+  {
+    paused_ = true;
+    if (acceptChannel_.isReading())
+    {
+      acceptChannel_.disableReading();
+    }
+  }
+}
+
+void Acceptor::resume()
+{
+  loop_->assertInLoopThread();
+  if (paused_)
+  {
+    paused_ = false;
+    if (listening_)
+    {
+      acceptChannel_.enableReading();
+    }
+  }
 }
 
 void Acceptor::handleRead()
@@ -56,33 +105,45 @@ void Acceptor::handleRead()
   loop_->assertInLoopThread();
   InetAddress peerAddr;
 
-  // FIXME loop until no more
-  int connfd = acceptSocket_.accept(&peerAddr);// 从全连接队列取出一个连接
-  if (connfd >= 0)
+  // a callback may pause() us, eg. TcpServer::setMaxConnections()
+  for (int i = 0; i < acceptBatch_ && !paused_; ++i)
   {
-    // string hostport = peerAddr.toIpPort();
-    // LOG_TRACE << "Accepts of " << hostport;
-    if (newConnectionCallback_)
+    int connfd = acceptSocket_.accept(&peerAddr);// 从全连接队列取出一个连接
+    if (connfd >= 0)
     {
-      newConnectionCallback_(connfd, peerAddr);
+      // string hostport = peerAddr.toIpPort();
+      // LOG_TRACE << "Accepts of " << hostport;
+      if (newConnectionCallback_)
+      {
+        newConnectionCallback_(connfd, peerAddr);
+      }
+      else
+      {
+        sockets::close(connfd);
+      }
     }
-    else
+    else if (errno == EAGAIN)
     {
-      sockets::close(connfd);
+      break; // 全连接队列已空, or another loop took it
     }
-  }
-  else  // 如果打开的文件描述符达到上限了，则丢弃全连接队列中的连接，避免可读事件一直被触发。
-  {
-    LOG_SYSERR << "in Acceptor::handleRead";
-    // Read the section named "The special problem of
-    // accept()ing when you can't" in libev's doc.
-    // By Marc Lehmann, author of libev.
-    if (errno == EMFILE) /* Too many open files */ // 电平触发会一直触发read事件,如果不作处理会一直报errno
+    else  // 如果打开的文件描述符达到上限了，则丢弃全连接队列中的连接，避免可读事件一直被触发。
     {
-      ::close(idleFd_); // 关闭空闲的文件描述符， 腾出一个
-      idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-      ::close(idleFd_);
-      idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      LOG_SYSERR << "in Acceptor::handleRead";
+      // Read the section named "The special problem of
+      // accept()ing when you can't" in libev's doc.
+      // By Marc Lehmann, author of libev.
+      if (errno == EMFILE) /* Too many open files */ // 电平触发会一直触发read事件,如果不作处理会一直报errno
+      {
+        ::close(idleFd_); // 关闭空闲的文件描述符， 腾出一个
+        idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+        ::close(idleFd_);
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      }
+      break;
     }
   }
+  if (batchDoneCallback_)
+  {
+    batchDoneCallback_();
+  }
 }
@@ -31,15 +31,35 @@ namespace muduo
     {
     public:
       typedef std::function<void(int sockfd, const InetAddress &)> NewConnectionCallback;
+      typedef std::function<void()> BatchDoneCallback;
 
       Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport = true);
+      // Takes over a bound, usually listening, socket, eg. from HotRestart.
+      Acceptor(EventLoop *loop, int listenFd);
       ~Acceptor();
 
       void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+      // Called after each readable event, once its batch of new connections is done.
+      void setBatchDoneCallback(const BatchDoneCallback &cb) { batchDoneCallback_ = cb; }
+
+      // Accepts up to @c batch connections per readable event, 1 by default.
+      void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+      // TCP_DEFER_ACCEPT, see Socket::setDeferAccept().
+      void setDeferAccept(int seconds) { acceptSocket_.setDeferAccept(seconds); }
+      // EPOLLEXCLUSIVE, for a listen fd shared by several loops or processes.
+      // Must be called before listen().
+      void setExclusive() { acceptChannel_.setExclusive(); }
 
       void listen();
 
       bool listening() const { return listening_; }
+      int listenFd() const { return acceptSocket_.fd(); }
+
+      // Stops accepting, new connections wait in the listen backlog,
+      // and the kernel drops SYNs once it is full.
+      void pause();
+      void resume();
+      bool paused() const { return paused_; }
 
       // Deprecated, use the correct spelling one above.
       // Leave the wrong spelling here in case one needs to grep it for error messages.
@@ -52,7 +72,10 @@ namespace muduo
       Socket acceptSocket_; // listen socket
       Channel acceptChannel_; // handleread
       NewConnectionCallback newConnectionCallback_;
+      BatchDoneCallback batchDoneCallback_;
+      int acceptBatch_;
       bool listening_;
+      bool paused_;
       int idleFd_;
     };
 
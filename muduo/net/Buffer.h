@@ -15,6 +15,7 @@
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 
+#include "muduo/net/ByteScan.h"
 #include "muduo/net/Endian.h"
 
 #include <algorithm>
@@ -87,20 +88,43 @@ namespace muduo
       }
 
       // 成功返回第一次出现关键字的位置，失败返回NULL
+      // SIMD if the CPU has it, see ByteScan.h
       const char *findCRLF() const
       {
-        // FIXME: replace with memmem()?
-        const char *crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-        return crlf == beginWrite() ? NULL : crlf;
+        return scan::findCRLF(peek(), beginWrite());
       }
 
       const char *findCRLF(const char *start) const
       {
         assert(peek() <= start);
         assert(start <= beginWrite());
-        // FIXME: replace with memmem()?
-        const char *crlf = std::search(start, beginWrite(), kCRLF, kCRLF + 2);
-        return crlf == beginWrite() ? NULL : crlf;
+        return scan::findCRLF(start, beginWrite());
+      }
+
+      // end of HTTP headers
+      const char *findDoubleCRLF() const
+      {
+        return scan::findDoubleCRLF(peek(), beginWrite());
+      }
+
+      const char *findDoubleCRLF(const char *start) const
+      {
+        assert(peek() <= start);
+        assert(start <= beginWrite());
+        return scan::findDoubleCRLF(start, beginWrite());
+      }
+
+      // first of any byte in set, eg. " ?" of a request line
+      const char *findAnyOf(const StringPiece &set) const
+      {
+        return scan::findAnyOf(peek(), beginWrite(), set.data(), static_cast<size_t>(set.size()));
+      }
+
+      const char *findAnyOf(const char *start, const StringPiece &set) const
+      {
+        assert(peek() <= start);
+        assert(start <= beginWrite());
+        return scan::findAnyOf(start, beginWrite(), set.data(), static_cast<size_t>(set.size()));
       }
 
       const char *findEOL() const
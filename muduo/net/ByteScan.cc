@@ -0,0 +1,279 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/ByteScan.h"
+
+#include <atomic>
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MUDUO_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace muduo::net;
+
+namespace
+{
+
+const char *findCRLFScalar(const char *begin, const char *end)
+{
+  // memchr is vectorized by libc
+  const char *p = begin;
+  while (end - p >= 2)
+  {
+    const char *cr = static_cast<const char *>(memchr(p, '\r', end - p - 1));
+    if (cr == NULL)
+    {
+      break;
+    }
+    if (cr[1] == '\n')
+    {
+      return cr;
+    }
+    p = cr + 1;
+  }
+  return NULL;
+}
+
+const char *findDoubleCRLFScalar(const char *begin, const char *end)
+{
+  const char *p = begin;
+  while ((p = findCRLFScalar(p, end)) != NULL)
+  {
+    if (end - p >= 4 && p[2] == '\r' && p[3] == '\n')
+    {
+      return p;
+    }
+    p += 2;
+  }
+  return NULL;
+}
+
+const char *findAnyOfScalar(const char *begin, const char *end,
+                            const char *set, size_t setLen)
+{
+  bool table[256] = { false };
+  for (size_t i = 0; i < setLen; ++i)
+  {
+    table[static_cast<unsigned char>(set[i])] = true;
+  }
+  for (const char *p = begin; p < end; ++p)
+  {
+    if (table[static_cast<unsigned char>(*p)])
+    {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+#ifdef MUDUO_SCAN_X86
+
+// SSE2 is in every x86-64 CPU, the Isa is kSse42 for pcmpestri.
+const char *findCRLFSse(const char *begin, const char *end)
+{
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const char *p = begin;
+  // p[1, 17) must be readable
+  for (; end - p > 16; p += 16)
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+    int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char *findCRLFAvx2(const char *begin, const char *end)
+{
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const char *p = begin;
+  for (; end - p > 32; p += 32)
+  {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+    int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr),
+                                                     _mm256_cmpeq_epi8(b, lf)));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findCRLFSse(p, end);
+}
+
+const char *findDoubleCRLFSse(const char *begin, const char *end)
+{
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const char *p = begin;
+  // p[3, 19) must be readable
+  for (; end - p >= 19; p += 16)
+  {
+    __m128i m = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), cr),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1)), lf)),
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2)), cr),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3)), lf)));
+    int mask = _mm_movemask_epi8(m);
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findDoubleCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char *findDoubleCRLFAvx2(const char *begin, const char *end)
+{
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const char *p = begin;
+  for (; end - p >= 35; p += 32)
+  {
+    __m256i m = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), cr),
+                         _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1)), lf)),
+        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2)), cr),
+                         _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 3)), lf)));
+    int mask = _mm256_movemask_epi8(m);
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findDoubleCRLFSse(p, end);
+}
+
+__attribute__((target("sse4.2")))
+const char *findAnyOfSse42(const char *begin, const char *end,
+                           const char *set, size_t setLen)
+{
+  char padded[16] = { 0 };
+  memcpy(padded, set, setLen);
+  const __m128i needles = _mm_loadu_si128(reinterpret_cast<const __m128i *>(padded));
+  const int n = static_cast<int>(setLen);
+  const char *p = begin;
+  for (; end - p >= 16; p += 16)
+  {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    int index = _mm_cmpestri(needles, n, data, 16,
+                             _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+    if (index < 16)
+    {
+      return p + index;
+    }
+  }
+  return findAnyOfScalar(p, end, set, setLen);
+}
+
+scan::Isa cpuIsa()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return scan::kAvx2;
+  }
+  else if (__builtin_cpu_supports("sse4.2"))
+  {
+    return scan::kSse42;
+  }
+  return scan::kScalar;
+}
+
+#else
+
+scan::Isa cpuIsa()
+{
+  return scan::kScalar;
+}
+
+#endif // MUDUO_SCAN_X86
+
+const scan::Isa kCpuIsa = cpuIsa();
+std::atomic<int> g_isa(kCpuIsa);
+
+}  // namespace
+
+scan::Isa scan::isa()
+{
+  return static_cast<Isa>(g_isa.load(std::memory_order_relaxed));
+}
+
+void scan::setIsa(Isa isa)
+{
+  g_isa.store(isa < kCpuIsa ? isa : kCpuIsa, std::memory_order_relaxed);
+}
+
+const char *scan::isaName(Isa isa)
+{
+  switch (isa)
+  {
+  case kAvx2:
+    return "avx2";
+  case kSse42:
+    return "sse4.2";
+  default:
+    return "scalar";
+  }
+}
+
+const char *scan::findCRLF(const char *begin, const char *end)
+{
+#ifdef MUDUO_SCAN_X86
+  switch (isa())
+  {
+  case kAvx2:
+    return findCRLFAvx2(begin, end);
+  case kSse42:
+    return findCRLFSse(begin, end);
+  default:
+    break;
+  }
+#endif
+  return findCRLFScalar(begin, end);
+}
+
+const char *scan::findDoubleCRLF(const char *begin, const char *end)
+{
+#ifdef MUDUO_SCAN_X86
+  switch (isa())
+  {
+  case kAvx2:
+    return findDoubleCRLFAvx2(begin, end);
+  case kSse42:
+    return findDoubleCRLFSse(begin, end);
+  default:
+    break;
+  }
+#endif
+  return findDoubleCRLFScalar(begin, end);
+}
+
+const char *scan::findAnyOf(const char *begin, const char *end,
+                            const char *set, size_t setLen)
+{
+#ifdef MUDUO_SCAN_X86
+  if (isa() != kScalar && setLen > 0 && setLen <= 16)
+  {
+    return findAnyOfSse42(begin, end, set, setLen);
+  }
+#endif
+  return findAnyOfScalar(begin, end, set, setLen);
+}
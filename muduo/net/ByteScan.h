@@ -0,0 +1,51 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BYTESCAN_H
+#define MUDUO_NET_BYTESCAN_H
+
+#include <stddef.h>
+
+namespace muduo
+{
+  namespace net
+  {
+    ///
+    /// Delimiter search for protocol parsers, with SSE4.2 and AVX2 versions
+    /// picked by the CPU at run time and a scalar fallback.
+    /// All of them return NULL if not found in [begin, end).
+    ///
+    namespace scan
+    {
+      enum Isa
+      {
+        kScalar,
+        kSse42,
+        kAvx2,
+      };
+
+      /// The instruction set in use, the widest this CPU has by default.
+      Isa isa();
+      /// For tests and benchmarks, capped by what the CPU has.
+      void setIsa(Isa isa);
+      const char *isaName(Isa isa);
+
+      /// "\r\n"
+      const char *findCRLF(const char *begin, const char *end);
+      /// "\r\n\r\n", end of HTTP headers
+      const char *findDoubleCRLF(const char *begin, const char *end);
+      /// First byte in set[0, setLen), SIMD if setLen <= 16
+      const char *findAnyOf(const char *begin, const char *end,
+                            const char *set, size_t setLen);
+    } // namespace scan
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_BYTESCAN_H
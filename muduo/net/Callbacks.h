@@ -60,12 +60,16 @@ namespace muduo
 
     class Buffer;
     class TcpConnection;
+    class TlsContext;
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
+    typedef std::shared_ptr<TlsContext> TlsContextPtr;
     typedef std::function<void()> TimerCallback;
     typedef std::function<void(const TcpConnectionPtr &)> ConnectionCallback;
     typedef std::function<void(const TcpConnectionPtr &)> CloseCallback;
     typedef std::function<void(const TcpConnectionPtr &)> WriteCompleteCallback;
     typedef std::function<void(const TcpConnectionPtr &, size_t)> HighWaterMarkCallback;
+    // complete is false if the connection went down before the file was sent.
+    typedef std::function<void(const TcpConnectionPtr &, bool complete)> SendFileCallback;
 
     // the data has been read to (buf, len)
     typedef std::function<void(const TcpConnectionPtr &,
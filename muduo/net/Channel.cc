@@ -30,7 +30,8 @@ Channel::Channel(EventLoop *loop, int fd__)
       logHup_(true),
       tied_(false),
       eventHandling_(false),
-      addedToLoop_(false)
+      addedToLoop_(false),
+      exclusive_(false)
 {
 }
 
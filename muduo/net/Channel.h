@@ -94,6 +94,12 @@ namespace muduo
 
       void doNotLogHup() { logHup_ = false; }
 
+      /// EPOLLEXCLUSIVE, wakes one of the epoll instances waiting on a
+      /// shared listen fd. Call before the first enableReading(),
+      /// it's added to epoll only, so toggle events with disableAll().
+      void setExclusive() { exclusive_ = true; }
+      bool exclusive() const { return exclusive_; }
+
       EventLoop *ownerLoop() { return loop_; }
       void remove();
 
@@ -119,6 +125,7 @@ namespace muduo
       bool tied_;
       bool eventHandling_; // 是否正在处理事件
       bool addedToLoop_;
+      bool exclusive_;
       ReadEventCallback readCallback_;
       EventCallback writeCallback_;
       EventCallback closeCallback_;
@@ -0,0 +1,278 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_COROUTINE_H
+#define MUDUO_NET_COROUTINE_H
+
+// C++20 only, the rest of muduo stays C++11.
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+namespace muduo
+{
+  namespace net
+  {
+    namespace coro
+    {
+
+      ///
+      /// Return type of a detached coroutine, it starts running right away
+      /// and its frame is freed when it returns.
+      ///
+      /// void onConnection(const TcpConnectionPtr& conn)
+      /// {
+      ///   if (conn->connected())
+      ///     session(conn);  // a coro::Task
+      /// }
+      struct Task
+      {
+        struct promise_type
+        {
+          Task get_return_object() { return Task(); }
+          std::suspend_never initial_suspend() noexcept { return {}; }
+          std::suspend_never final_suspend() noexcept { return {}; }
+          void return_void() {}
+          void unhandled_exception() { std::terminate(); }
+        };
+      };
+
+      ///
+      /// Awaitable reads on a TcpConnection, resumed in the connection's loop
+      /// from its message/write complete/connection callbacks, which the
+      /// Stream takes over. Awaiters live in the coroutine frame, so awaiting
+      /// allocates nothing.
+      ///
+      /// Create it in the connection's loop, keep it in the coroutine frame,
+      /// one awaiting coroutine at a time.
+      ///
+      /// coro::Task session(TcpConnectionPtr conn)
+      /// {
+      ///   coro::Stream stream(conn);
+      ///   StringPiece line;
+      ///   while (!(line = co_await stream.readUntil("\r\n")).empty())
+      ///   {
+      ///     conn->send(line);
+      ///     co_await stream.drain();
+      ///   }
+      /// }
+      class Stream : noncopyable
+      {
+      public:
+        struct ReadAwaiter
+        {
+          bool await_ready() { return stream->tryRead(this); }
+          void await_suspend(std::coroutine_handle<> h)
+          {
+            handle = h;
+            stream->reader_ = this;
+          }
+          /// The bytes asked for, valid until the next read on the Stream,
+          /// empty if the connection is closed before they arrive.
+          StringPiece await_resume() const { return result; }
+
+          Stream *stream;
+          size_t length;    // read(n)
+          StringPiece delim; // readUntil(delim), if not empty
+          StringPiece result;
+          std::coroutine_handle<> handle;
+        };
+
+        struct DrainAwaiter
+        {
+          bool await_ready() const
+          {
+            return stream->closed_ || stream->conn_->outputEmpty();
+          }
+          void await_suspend(std::coroutine_handle<> h) { stream->drainer_ = h; }
+          /// false if the connection is closed.
+          bool await_resume() const { return !stream->closed_; }
+
+          Stream *stream;
+        };
+
+        explicit Stream(const TcpConnectionPtr &conn)
+            : conn_(conn),
+              reader_(nullptr),
+              consume_(0),
+              closed_(!conn->connected()),
+              self_(std::make_shared<Stream *>(this))
+        {
+          conn_->getLoop()->assertInLoopThread();
+          // the callbacks outlive us, when the coroutine returns
+          // the connection behaves as with default callbacks.
+          std::weak_ptr<Stream *> weak(self_);
+          conn_->setMessageCallback(
+              [weak](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+                if (std::shared_ptr<Stream *> s = weak.lock())
+                  (*s)->onMessage();
+                else
+                  buf->retrieveAll();
+              });
+          conn_->setWriteCompleteCallback(
+              [weak](const TcpConnectionPtr &) {
+                if (std::shared_ptr<Stream *> s = weak.lock())
+                  (*s)->onWriteComplete();
+              });
+          conn_->setConnectionCallback(
+              [weak](const TcpConnectionPtr &c) {
+                std::shared_ptr<Stream *> s = weak.lock();
+                if (s && !c->connected())
+                  (*s)->onClose();
+              });
+        }
+
+        ~Stream()
+        {
+          // don't reset callbacks here, we may be inside one of them
+          self_.reset();
+          consume();
+        }
+
+        const TcpConnectionPtr &connection() const { return conn_; }
+        bool closed() const { return closed_; }
+
+        /// Resumes with exactly @c n bytes.
+        ReadAwaiter read(size_t n) { return ReadAwaiter{this, n, StringPiece(), StringPiece(), {}}; }
+        /// Resumes with bytes up to and including @c delim,
+        /// @c delim must outlive the co_await.
+        ReadAwaiter readUntil(StringPiece delim) { return ReadAwaiter{this, 0, delim, StringPiece(), {}}; }
+        /// Resumes when the output buffer is empty.
+        DrainAwaiter drain() { return DrainAwaiter{this}; }
+
+      private:
+        void consume()
+        {
+          if (consume_ > 0)
+          {
+            conn_->inputBuffer()->retrieve(consume_);
+            consume_ = 0;
+          }
+        }
+
+        bool tryRead(ReadAwaiter *r)
+        {
+          consume();
+          Buffer *buf = conn_->inputBuffer();
+          size_t n = 0;
+          if (r->delim.empty())
+          {
+            n = buf->readableBytes() >= r->length ? r->length : 0;
+          }
+          else
+          {
+            const char *end = buf->beginWrite();
+            const char *pos = std::search(buf->peek(), end, r->delim.begin(), r->delim.end());
+            n = pos == end ? 0 : pos - buf->peek() + r->delim.size();
+          }
+          if (n > 0 || (r->delim.empty() && r->length == 0))
+          {
+            r->result = StringPiece(buf->peek(), static_cast<int>(n));
+            consume_ = n;
+            return true;
+          }
+          r->result = StringPiece();
+          return closed_;
+        }
+
+        // Resuming may end the coroutine and destroy us, so it's the last thing.
+        void onMessage()
+        {
+          if (reader_ && tryRead(reader_))
+          {
+            ReadAwaiter *r = reader_;
+            reader_ = nullptr;
+            r->handle.resume();
+          }
+        }
+
+        void onWriteComplete()
+        {
+          if (drainer_ && conn_->outputEmpty())
+          {
+            std::exchange(drainer_, nullptr).resume();
+          }
+        }
+
+        void onClose()
+        {
+          closed_ = true;
+          if (reader_)
+          {
+            ReadAwaiter *r = reader_;
+            reader_ = nullptr;
+            tryRead(r);
+            r->handle.resume();
+          }
+          else if (drainer_)
+          {
+            std::exchange(drainer_, nullptr).resume();
+          }
+        }
+
+        TcpConnectionPtr conn_;
+        ReadAwaiter *reader_;
+        std::coroutine_handle<> drainer_;
+        size_t consume_; // bytes handed out by the last read
+        bool closed_;
+        std::shared_ptr<Stream *> self_; // one allocation per Stream
+      };
+
+      struct SleepAwaiter
+      {
+        bool await_ready() const { return seconds <= 0; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+          loop->runAfter(seconds, [h] { h.resume(); });
+        }
+        void await_resume() const {}
+
+        EventLoop *loop;
+        double seconds;
+      };
+
+      /// Resumes in @c loop after @c seconds, call it in @c loop.
+      inline SleepAwaiter sleep(EventLoop *loop, double seconds)
+      {
+        return SleepAwaiter{loop, seconds};
+      }
+
+      struct SwitchAwaiter
+      {
+        bool await_ready() const { return loop->isInLoopThread(); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+          loop->queueInLoop([h] { h.resume(); });
+        }
+        void await_resume() const {}
+
+        EventLoop *loop;
+      };
+
+      /// Continues the coroutine in @c loop's thread.
+      inline SwitchAwaiter switchTo(EventLoop *loop)
+      {
+        return SwitchAwaiter{loop};
+      }
+
+    } // namespace coro
+  } // namespace net
+} // namespace muduo
+
+#endif // C++20
+
+#endif // MUDUO_NET_COROUTINE_H
@@ -68,12 +68,18 @@ EventLoop::EventLoop()
       quit_(false),
       eventHandling_(false),
       callingPendingFunctors_(false),
+      iterating_(false),
       iteration_(0),
       threadId_(CurrentThread::tid()),
       poller_(Poller::newDefaultPoller(this)),
       timerQueue_(new TimerQueue(this)),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
+      pollTimers_(false),
+      busyPollUs_(0),
+      spinning_(false),
+      busyPollStats_(),
+      wakeupsAvoided_(0),
       currentActiveChannel_(NULL)
 {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
@@ -91,6 +97,11 @@ EventLoop::EventLoop()
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
     // we are always reading the wakeupfd
     wakeupChannel_->enableReading();
+    if (poller_->virtualClock())
+    {
+        // a timerfd runs on the real clock
+        setTimerfd(false);
+    }
 }
 
 EventLoop::~EventLoop()
@@ -117,8 +128,15 @@ void EventLoop::loop()
     while (!quit_)
     {
         activeChannels_.clear();
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        int timeoutMs = busyPollUs_ > 0 ? busyPollTimeout() : kPollTimeMs;
+        if (pollTimers_)
+        {
+            timeoutMs = timerQueue_->pollTimeout(timeoutMs);
+        }
+        Timestamp lastReturn = pollReturnTime_;
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
         ++iteration_;
+        iterating_ = true;
         // if (Logger::logLevel() <= Logger::TRACE)
         if (Logger::logLevel() <= Logger::DEBUG)
         {
@@ -134,9 +152,34 @@ void EventLoop::loop()
         }
         currentActiveChannel_ = NULL;
         eventHandling_ = false;
+        if (pollTimers_)
+        {
+            timerQueue_->runExpired();
+        }
 
-        doPendingFunctors();
+        size_t functors = doPendingFunctors();
+        // those registered by iteration end functors wake up the next iteration
+        iterating_ = false;
+        functors += doIterationEndFunctors();
+        if (busyPollUs_ > 0)
+        {
+            if (!activeChannels_.empty() || functors > 0 || !spinning_)
+            {
+                // after work, or back from sleep
+                spinning_ = true;
+                lastActive_ = pollReturnTime_;
+            }
+            else if (timeoutMs == 0)
+            {
+                ++busyPollStats_.idleSpins;
+                busyPollStats_.idleSpinMicroseconds +=
+                    pollReturnTime_.microSecondsSinceEpoch() - lastReturn.microSecondsSinceEpoch();
+            }
+        }
     }
+    // functors queued before quit() still run, eg. the connections
+    // a destructing TcpServer hands back, rather than be dropped unrun.
+    doPendingFunctors();
 
     LOG_INFO << "EventLoop " << this << " stop looping";
     looping_ = false;
@@ -181,6 +224,26 @@ void EventLoop::queueInLoop(Functor cb)
     // 或者调用queueInLoop的线程是当前IO线程，并且此时正在调用pendingfunctor, 需要唤醒。为了防止在执行pendingFunctors_时，Functor函数中又调用了queueInLoop
     // 只有当前IO线程的事件回调中调用queueInLoop才不需要唤醒
     if (!isInLoopThread() || callingPendingFunctors_)
+    {
+        // a spinning loop checks pendingFunctors_ at every poll,
+        // it stops spinning before its last check, see busyPollTimeout()
+        if (spinning_)
+        {
+            ++wakeupsAvoided_;
+        }
+        else
+        {
+            wakeup();
+        }
+    }
+}
+
+void EventLoop::runAtIterationEnd(Functor cb)
+{
+    assertInLoopThread();
+    iterationEndFunctors_.push_back(std::move(cb));
+    // outside of an iteration, eg. before loop(), get one going
+    if (!iterating_ && !spinning_)
     {
         wakeup();
     }
@@ -192,6 +255,60 @@ size_t EventLoop::queueSize() const
     return pendingFunctors_.size();
 }
 
+void EventLoop::setBusyPoll(int spinMicroseconds)
+{
+    assertInLoopThread();
+    busyPollUs_ = std::max(spinMicroseconds, 0);
+    if (busyPollUs_ == 0)
+    {
+        spinning_ = false;
+    }
+}
+
+void EventLoop::setTimerfd(bool on)
+{
+    assertInLoopThread();
+    pollTimers_ = !on;
+    timerQueue_->setUseTimerfd(on);
+}
+
+void EventLoop::setTimerSlack(double seconds)
+{
+    assertInLoopThread();
+    timerQueue_->setSlack(seconds);
+}
+
+EventLoop::BusyPollStats EventLoop::busyPollStats() const
+{
+    BusyPollStats stats = busyPollStats_;
+    stats.wakeupsAvoided = wakeupsAvoided_.load();
+    return stats;
+}
+
+// Zero timeout within the spin budget, then blocks as usual.
+int EventLoop::busyPollTimeout()
+{
+    if (spinning_)
+    {
+        int64_t idle = Timestamp::now().microSecondsSinceEpoch() - lastActive_.microSecondsSinceEpoch();
+        if (idle < busyPollUs_)
+        {
+            ++busyPollStats_.spins;
+            return 0;
+        }
+        // pairs with queueInLoop(): it either sees spinning_ false and
+        // writes the eventfd, or its functor is seen here.
+        spinning_ = false;
+        if (queueSize() > 0)
+        {
+            ++busyPollStats_.spins;
+            return 0;
+        }
+        ++busyPollStats_.sleeps;
+    }
+    return kPollTimeMs;
+}
+
 TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 {
     return timerQueue_->addTimer(std::move(cb), time, 0.0);
@@ -275,7 +392,7 @@ void EventLoop::handleRead()
   2.由于doPendingFunctors()调用的Functor时，其他线程可能再次调用queueInLoop(cb), 这时queueInLoop()就必须wakeup(), 否则新增的cb可能就不能及时调用了（因为只有fd事件被触发才能调到由于doPendingFunctors）。
   3.muduo没有反复执行doPendingFunctors()直到pendingFunctors_为空，这是有意的，否则IO线程可能陷入死循环，无法处理IO事件。
 */
-void EventLoop::doPendingFunctors()
+size_t EventLoop::doPendingFunctors()
 {
     std::vector<Functor> functors;
     callingPendingFunctors_ = true;
@@ -290,6 +407,25 @@ void EventLoop::doPendingFunctors()
         functor();
     }
     callingPendingFunctors_ = false;
+    return functors.size();
+}
+
+size_t EventLoop::doIterationEndFunctors()
+{
+    if (iterationEndFunctors_.empty())
+    {
+        return 0;
+    }
+    std::vector<Functor> functors;
+    functors.swap(iterationEndFunctors_);
+    // functors queued by them run in the next iteration, wake it up
+    callingPendingFunctors_ = true;
+    for (const Functor &functor : functors)
+    {
+        functor();
+    }
+    callingPendingFunctors_ = false;
+    return functors.size();
 }
 
 void EventLoop::printActiveChannels() const
@@ -86,6 +86,32 @@ namespace muduo
 
             size_t queueSize() const;
 
+            /// Runs callback at the end of this iteration, after events,
+            /// timers and queued functors, eg. TcpConnection flushes the
+            /// writes it coalesced, see TcpConnection::setCoalesceWrites().
+            /// Must be called in the loop thread.
+            void runAtIterationEnd(Functor cb);
+
+            /// Busy polling for low latency: after any work the loop keeps
+            /// polling with zero timeout for @c spinMicroseconds before it
+            /// blocks, and functors queued meanwhile don't write the eventfd.
+            /// Sockets of its connections get SO_BUSY_POLL.
+            /// Burns a CPU while spinning, 0 (the default) turns it off.
+            /// Must be called in the loop thread.
+            void setBusyPoll(int spinMicroseconds);
+            int busyPollMicroseconds() const { return busyPollUs_; }
+
+            /// What busy polling costs and saves, read in the loop thread.
+            struct BusyPollStats
+            {
+                int64_t spins;            // zero timeout polls
+                int64_t idleSpins;        // spins without events or functors
+                int64_t idleSpinMicroseconds; // CPU time burnt by idle spins
+                int64_t sleeps;           // spin budget used up, blocking poll
+                int64_t wakeupsAvoided;   // queueInLoop() without eventfd write
+            };
+            BusyPollStats busyPollStats() const;
+
             // timers
 
             ///
@@ -109,6 +135,16 @@ namespace muduo
             ///
             void cancel(TimerId timerId);
 
+            /// Expires timers through the poll timeout instead of a timerfd,
+            /// for loops adding and cancelling many short timers, eg. a
+            /// timeout per request. Timers may be up to 1ms late.
+            /// Must be called in the loop thread.
+            void setTimerfd(bool on);
+            /// Timers of runEvery() may run up to @c seconds late, so that
+            /// they expire together and wake the loop up less often.
+            /// Must be called in the loop thread.
+            void setTimerSlack(double seconds);
+
             // internal usage
             void wakeup();
             void updateChannel(Channel *channel); // 在Poller中添加或者更新通道
@@ -147,7 +183,9 @@ namespace muduo
         private:
             void abortNotInLoopThread();
             void handleRead(); // waked up
-            void doPendingFunctors();
+            size_t doPendingFunctors();
+            size_t doIterationEndFunctors();
+            int busyPollTimeout();
 
             void printActiveChannels() const; // DEBUG
 
@@ -157,6 +195,7 @@ namespace muduo
             std::atomic<bool> quit_;          // 是否处于退出状态
             bool eventHandling_; /* atomic */ // 事件处理状态
             bool callingPendingFunctors_;     /* atomic */
+            bool iterating_;                  // between poll and iteration end functors
             int64_t iteration_;
             const pid_t threadId_;     // 当前对象所属线程id
             Timestamp pollReturnTime_; // 调用poll函数返回的时间戳
@@ -168,12 +207,21 @@ namespace muduo
             std::unique_ptr<Channel> wakeupChannel_;
             boost::any context_;
 
+            bool pollTimers_; // timers by poll timeout, no timerfd
+            int busyPollUs_; // 0 if not busy polling
+            // loop is polling with zero timeout, no need to wakeup()
+            std::atomic<bool> spinning_;
+            Timestamp lastActive_; // last poll with work, while spinning
+            BusyPollStats busyPollStats_;
+            std::atomic<int64_t> wakeupsAvoided_;
+
             // scratch variables
             ChannelList activeChannels_;    // Poller返回的活动通道
             Channel *currentActiveChannel_; // 当前正在处理的活动通道
 
             mutable MutexLock mutex_;
             std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+            std::vector<Functor> iterationEndFunctors_; // in loop thread
         };
 
     } // namespace net
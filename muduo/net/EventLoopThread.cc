@@ -8,8 +8,13 @@
 
 #include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -20,7 +25,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
       thread_(std::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(mutex_),
-      callback_(cb)
+      callback_(cb),
+      numaNode_(-1)
 {
 }
 
@@ -54,8 +60,53 @@ EventLoop *EventLoopThread::startLoop()
     return loop;
 }
 
+void EventLoopThread::setCpuAffinity(const std::vector<int> &cpus, int numaNode)
+{
+    assert(!thread_.started());
+    cpus_ = cpus;
+    numaNode_ = numaNode;
+}
+
+namespace
+{
+    const int kMpolPreferred = 1; // MPOL_PREFERRED in <numaif.h>, without libnuma
+}
+
+void EventLoopThread::bindToCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus_)
+    {
+        CPU_SET(cpu, &set);
+    }
+    if (::sched_setaffinity(0, sizeof set, &set) < 0)
+    {
+        LOG_SYSERR << "EventLoopThread::bindToCpus " << thread_.name();
+    }
+    if (numaNode_ >= 0)
+    {
+        // pages first touched by this thread, eg. buffers of its
+        // connections, come from numaNode_
+        unsigned long nodemask[4] = {0};
+        const int kBits = static_cast<int>(8 * sizeof nodemask[0]);
+        if (numaNode_ < kBits * 4)
+        {
+            nodemask[numaNode_ / kBits] |= 1UL << (numaNode_ % kBits);
+            if (::syscall(SYS_set_mempolicy, kMpolPreferred, nodemask, kBits * 4 + 1) < 0)
+            {
+                LOG_SYSERR << "EventLoopThread::bindToCpus set_mempolicy node " << numaNode_;
+            }
+        }
+    }
+}
+
 void EventLoopThread::threadFunc()
 {
+    if (!cpus_.empty())
+    {
+        bindToCpus();
+    }
     EventLoop loop;
 
     if (callback_)
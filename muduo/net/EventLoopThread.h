@@ -15,6 +15,8 @@
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Thread.h"
 
+#include <vector>
+
 /*
   EventLoopThread创建了一个线程
   在线程函数中创建了一个EventLoop对象并调用EventLoop:loop
@@ -36,8 +38,14 @@ namespace muduo
             ~EventLoopThread();
             EventLoop *startLoop();
 
+            /// Runs the thread on @c cpus only, and allocates its memory on
+            /// @c numaNode if not -1, set before the EventLoop is created so
+            /// the loop's own memory is local. Must be called before startLoop().
+            void setCpuAffinity(const std::vector<int> &cpus, int numaNode = -1);
+
         private:
             void threadFunc();
+            void bindToCpus();
 
             EventLoop *loop_ GUARDED_BY(mutex_);
             bool exiting_;
@@ -45,6 +53,8 @@ namespace muduo
             MutexLock mutex_;
             Condition cond_ GUARDED_BY(mutex_);
             ThreadInitCallback callback_;
+            std::vector<int> cpus_; // empty if not bound
+            int numaNode_;
         };
 
     } // namespace net
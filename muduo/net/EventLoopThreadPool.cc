@@ -11,7 +11,12 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/FileUtil.h"
+
+#include <algorithm>
+
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -42,6 +47,20 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     char buf[name_.size() + 32];
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
     EventLoopThread *t = new EventLoopThread(cb, buf);
+    std::vector<int> cpus;
+    if (!nodes_.empty())
+    {
+      int node = nodes_[i % nodes_.size()];
+      cpus = cpusOfNode(node);
+      t->setCpuAffinity(cpus, node);
+    }
+    else if (!cpus_.empty())
+    {
+      cpus.push_back(cpus_[i % cpus_.size()]);
+      t->setCpuAffinity(cpus);
+    }
+    loopCpus_.push_back(cpus);
+    cursors_.push_back(0);
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));
     loops_.push_back(t->startLoop()); // 启动EventLoop线程，在进入事件循环之前，会调用cb
   }
@@ -99,3 +118,79 @@ std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
     return loops_;
   }
 }
+
+int EventLoopThreadPool::loopIndexForCpu(int cpu)
+{
+  baseLoop_->assertInLoopThread();
+  // 2 if pinned to cpu, 1 if sharing it with others on its node
+  auto rank = [this, cpu](size_t i) {
+    const std::vector<int> &cpus = loopCpus_[i];
+    if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end())
+    {
+      return 0;
+    }
+    return cpus.size() == 1 ? 2 : 1;
+  };
+  int best = 0;
+  size_t first = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < loopCpus_.size(); ++i)
+  {
+    int r = rank(i);
+    if (r > best)
+    {
+      best = r;
+      first = i;
+      count = 1;
+    }
+    else if (r == best)
+    {
+      ++count;
+    }
+  }
+  if (best == 0)
+  {
+    return -1;
+  }
+  // round-robin among the best, loops of a node share the cursor of the first
+  size_t skip = cursors_[first]++ % count;
+  for (size_t i = first; i < loopCpus_.size(); ++i)
+  {
+    if (rank(i) == best && skip-- == 0)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  assert(false);
+  return -1;
+}
+
+// cpulist is like "0-3,8-11"
+std::vector<int> EventLoopThreadPool::cpusOfNode(int node)
+{
+  std::vector<int> cpus;
+  char path[64];
+  snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+  string content;
+  if (FileUtil::readFile(path, 1024, &content) != 0)
+  {
+    return cpus;
+  }
+  const char *p = content.c_str();
+  while (*p >= '0' && *p <= '9')
+  {
+    char *end = NULL;
+    long first = strtol(p, &end, 10);
+    long last = first;
+    if (*end == '-')
+    {
+      last = strtol(end + 1, &end, 10);
+    }
+    for (long cpu = first; cpu <= last; ++cpu)
+    {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    p = *end == ',' ? end + 1 : end;
+  }
+  return cpus;
+}
@@ -35,6 +35,14 @@ namespace muduo
             EventLoopThreadPool(EventLoop *baseLoop, const string &nameArg);
             ~EventLoopThreadPool();
             void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+            /// Pins thread i to cpus[i % cpus.size()].
+            /// Must be called before start().
+            void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
+            /// Binds thread i to the CPUs and memory of nodes[i % nodes.size()],
+            /// takes precedence over setCpuAffinity().
+            /// Must be called before start().
+            void setNumaNodes(const std::vector<int> &nodes) { nodes_ = nodes; }
             void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
             // valid after calling start()
@@ -46,6 +54,14 @@ namespace muduo
 
             std::vector<EventLoop *> getAllLoops();
 
+            /// Index in getAllLoops() of a loop running on @c cpu, preferring
+            /// one pinned to it over one on its NUMA node, -1 if none.
+            /// Round-robin among loops on the same CPUs.
+            int loopIndexForCpu(int cpu);
+
+            /// CPUs of a NUMA node, from sysfs, empty if unknown.
+            static std::vector<int> cpusOfNode(int node);
+
             bool started() const
             {
                 return started_;
@@ -64,6 +80,10 @@ namespace muduo
             int next_;  // 新连接到来，所选择的EventLoop对象下标
             std::vector<std::unique_ptr<EventLoopThread>> threads_; // IO线程列表
             std::vector<EventLoop *> loops_;                        // EventLoop列表
+            std::vector<int> cpus_;
+            std::vector<int> nodes_;
+            std::vector<std::vector<int>> loopCpus_; // CPUs of each of loops_, empty if not bound
+            std::vector<size_t> cursors_;            // of loopIndexForCpu(), by first loop of a group
         };
 
     } // namespace net
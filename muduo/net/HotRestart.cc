@@ -0,0 +1,309 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/HotRestart.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+  // one message: server names separated by '\n', their listen fds in SCM_RIGHTS
+  const int kMaxFds = 64;
+  const size_t kMaxNames = 4096;
+
+  bool toUnixAddr(const string &path, struct sockaddr_un *addr)
+  {
+    memZero(addr, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if (path.size() >= sizeof addr->sun_path)
+    {
+      LOG_ERROR << "HotRestart path too long " << path;
+      return false;
+    }
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+  }
+}
+
+HotRestart::HotRestart(EventLoop *loop, const string &path)
+    : loop_(loop),
+      path_(path),
+      listenFd_(-1),
+      drainTimeout_(30.0),
+      drainedCallback_(std::bind(&EventLoop::quit, loop)),
+      draining_(0),
+      handedOver_(false)
+{
+}
+
+HotRestart::~HotRestart()
+{
+  if (channel_)
+  {
+    loop_->assertInLoopThread();
+    stop();
+  }
+}
+
+bool HotRestart::takeOver(const string &path,
+                          std::map<string, int> *listenFds,
+                          double timeout)
+{
+  listenFds->clear();
+  struct sockaddr_un addr;
+  if (!toUnixAddr(path, &addr))
+  {
+    return false;
+  }
+  int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    LOG_SYSERR << "HotRestart::takeOver socket";
+    return false;
+  }
+  if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), static_cast<socklen_t>(sizeof addr)) < 0)
+  {
+    if (errno != ENOENT && errno != ECONNREFUSED)
+    {
+      LOG_SYSERR << "HotRestart::takeOver connect " << path;
+    }
+    ::close(fd);
+    return false; // nobody to take over from, a cold start
+  }
+  struct timeval tv;
+  tv.tv_sec = static_cast<time_t>(timeout);
+  tv.tv_usec = static_cast<suseconds_t>((timeout - static_cast<double>(tv.tv_sec)) * 1000 * 1000);
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, static_cast<socklen_t>(sizeof tv));
+
+  char names[kMaxNames];
+  struct iovec iov;
+  iov.iov_base = names;
+  iov.iov_len = sizeof names;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  } control;
+  struct msghdr msg;
+  memZero(&msg, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+  ssize_t n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  int savedErrno = errno;
+  ::close(fd);
+  if (n < 0)
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "HotRestart::takeOver recvmsg " << path;
+    return false;
+  }
+
+  std::vector<int> fds;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *received = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+      fds.insert(fds.end(), received, received + count);
+    }
+  }
+  if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+  {
+    LOG_ERROR << "HotRestart::takeOver truncated message from " << path;
+  }
+
+  size_t i = 0;
+  const char *begin = names;
+  const char *end = names + n;
+  while (begin < end && i < fds.size())
+  {
+    const char *eol = static_cast<const char *>(memchr(begin, '\n', static_cast<size_t>(end - begin)));
+    if (eol == NULL)
+    {
+      break;
+    }
+    string name(begin, eol);
+    if (!listenFds->insert(std::make_pair(name, fds[i])).second)
+    {
+      LOG_WARN << "HotRestart::takeOver duplicated server name " << name;
+      sockets::close(fds[i]);
+    }
+    ++i;
+    begin = eol + 1;
+  }
+  for (; i < fds.size(); ++i)
+  {
+    sockets::close(fds[i]);
+  }
+  LOG_INFO << "HotRestart::takeOver " << listenFds->size() << " listen sockets from " << path;
+  return true;
+}
+
+void HotRestart::start()
+{
+  loop_->runInLoop(std::bind(&HotRestart::startInLoop, this));
+}
+
+void HotRestart::startInLoop()
+{
+  loop_->assertInLoopThread();
+  assert(!channel_);
+  struct sockaddr_un addr;
+  if (!toUnixAddr(path_, &addr))
+  {
+    return;
+  }
+  listenFd_ = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0)
+  {
+    LOG_SYSFATAL << "HotRestart::start socket";
+  }
+  ::unlink(path_.c_str()); // left by a crashed process
+  // only our user may take our sockets
+  mode_t mask = ::umask(077);
+  int ret = ::bind(listenFd_, reinterpret_cast<struct sockaddr *>(&addr), static_cast<socklen_t>(sizeof addr));
+  ::umask(mask);
+  if (ret < 0 || ::listen(listenFd_, SOMAXCONN) < 0)
+  {
+    LOG_SYSFATAL << "HotRestart::start listen " << path_;
+  }
+  channel_.reset(new Channel(loop_, listenFd_));
+  channel_->setReadCallback(std::bind(&HotRestart::handleRead, this));
+  channel_->enableReading();
+  LOG_INFO << "HotRestart::start listening on " << path_;
+}
+
+void HotRestart::stop()
+{
+  channel_->disableAll();
+  channel_->remove();
+  // we may be in its handleEvent(), free it after, as TcpConnection does
+  std::shared_ptr<Channel> channel(std::move(channel_));
+  loop_->queueInLoop([channel] {});
+  sockets::close(listenFd_);
+  listenFd_ = -1;
+  ::unlink(path_.c_str());
+}
+
+void HotRestart::handleRead()
+{
+  loop_->assertInLoopThread();
+  int connfd = ::accept4(listenFd_, NULL, NULL, SOCK_CLOEXEC);
+  if (connfd < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "HotRestart::handleRead accept";
+    }
+    return;
+  }
+  // free the path before the new process may bind it for its successor
+  stop();
+  bool ok = sendListenFds(connfd);
+  sockets::close(connfd);
+  if (!ok)
+  {
+    startInLoop(); // wait for another try
+    return;
+  }
+
+  handedOver_ = true;
+  LOG_INFO << "HotRestart::handleRead handed over " << servers_.size()
+           << " listen sockets, draining";
+  draining_ = servers_.size();
+  if (draining_ == 0)
+  {
+    if (drainedCallback_)
+    {
+      drainedCallback_();
+    }
+    return;
+  }
+  for (TcpServer *server : servers_)
+  {
+    assert(server->getLoop() == loop_);
+    server->drain(drainTimeout_, std::bind(&HotRestart::serverDrained, this));
+  }
+}
+
+bool HotRestart::sendListenFds(int fd)
+{
+  string names;
+  std::vector<int> fds;
+  for (TcpServer *server : servers_)
+  {
+    names += server->name();
+    names += '\n';
+    fds.push_back(server->listenFd());
+  }
+  if (fds.size() > static_cast<size_t>(kMaxFds) || names.size() >= kMaxNames)
+  {
+    LOG_ERROR << "HotRestart::sendListenFds too many servers " << fds.size();
+    return false;
+  }
+  names += '\n'; // never an empty message
+
+  struct iovec iov;
+  iov.iov_base = &*names.begin();
+  iov.iov_len = names.size();
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  } control;
+  memZero(&control, sizeof control);
+  struct msghdr msg;
+  memZero(&msg, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (!fds.empty())
+  {
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  }
+  if (::sendmsg(fd, &msg, MSG_NOSIGNAL) < 0)
+  {
+    LOG_SYSERR << "HotRestart::sendListenFds";
+    return false;
+  }
+  return true;
+}
+
+void HotRestart::serverDrained()
+{
+  loop_->assertInLoopThread();
+  assert(draining_ > 0);
+  if (--draining_ == 0)
+  {
+    LOG_INFO << "HotRestart::serverDrained all servers drained";
+    if (drainedCallback_)
+    {
+      drainedCallback_();
+    }
+  }
+}
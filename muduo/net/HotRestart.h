@@ -0,0 +1,102 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HOTRESTART_H
+#define MUDUO_NET_HOTRESTART_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    class Channel;
+    class EventLoop;
+    class TcpServer;
+
+    ///
+    /// Restarting a server without refusing connections.
+    ///
+    /// The running process listens on a Unix socket at @c path. A new process
+    /// calls takeOver(@c path) before creating its servers, gets the listen
+    /// sockets of the old one with SCM_RIGHTS and serves on them with
+    /// TcpServer(loop, listenFd, name). Connections waiting in the listen
+    /// backlog are accepted by the new process.
+    ///
+    /// Once the sockets are sent, the old process stops accepting, drains its
+    /// connections, force closing those left after the drain timeout, then
+    /// calls the drained callback, which quits the loop by default.
+    ///
+    /// Usage:
+    ///   std::map<string, int> fds;
+    ///   std::unique_ptr<TcpServer> server;
+    ///   if (HotRestart::takeOver(path, &fds) && fds.count("echo"))
+    ///     server.reset(new TcpServer(&loop, fds["echo"], "echo"));
+    ///   else
+    ///     server.reset(new TcpServer(&loop, listenAddr, "echo"));
+    ///   HotRestart restart(&loop, path);
+    ///   restart.addServer(get_pointer(server));
+    ///   server->start();
+    ///   restart.start(); // ready for the next one
+    ///   loop.loop();
+    class HotRestart : noncopyable
+    {
+    public:
+      typedef std::function<void()> DrainedCallback;
+
+      HotRestart(EventLoop *loop, const string &path);
+      ~HotRestart();
+
+      /// Listen sockets of the old process by server name, empty if none.
+      /// Returns false if no process is listening on @c path.
+      /// Blocks up to @c timeout seconds, call it before looping.
+      static bool takeOver(const string &path,
+                           std::map<string, int> *listenFds,
+                           double timeout = 5.0);
+
+      /// Its listen socket is handed over by name(), must outlive us.
+      void addServer(TcpServer *server) { servers_.push_back(server); }
+      /// 30 seconds by default.
+      void setDrainTimeout(double seconds) { drainTimeout_ = seconds; }
+      void setDrainedCallback(const DrainedCallback &cb) { drainedCallback_ = cb; }
+
+      /// Listens on path, replacing a stale one.
+      /// Thread safe.
+      void start();
+
+      bool handedOver() const { return handedOver_; }
+
+    private:
+      void startInLoop();
+      void handleRead();
+      bool sendListenFds(int fd);
+      void serverDrained();
+      void stop();
+
+      EventLoop *loop_;
+      const string path_;
+      int listenFd_;
+      std::unique_ptr<Channel> channel_;
+      std::vector<TcpServer *> servers_;
+      double drainTimeout_;
+      DrainedCallback drainedCallback_;
+      size_t draining_;
+      bool handedOver_;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_HOTRESTART_H
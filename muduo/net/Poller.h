@@ -11,9 +11,14 @@
 #ifndef MUDUO_NET_POLLER_H
 #define MUDUO_NET_POLLER_H
 
-#include <map>
 #include <vector>
 
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <assert.h>
+
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/EventLoop.h"
 
@@ -50,6 +55,10 @@ namespace muduo
 
       virtual bool hasChannel(Channel *channel) const;
 
+      /// True if time only moves in poll(), eg. SimPoller,
+      /// the loop then runs its timers from the poll timeout.
+      virtual bool virtualClock() const { return false; }
+
       static Poller *newDefaultPoller(EventLoop *loop);
 
       void assertInLoopThread() const
@@ -58,8 +67,66 @@ namespace muduo
       }
 
     protected:
-      typedef std::map<int, Channel *> ChannelMap;  //key是文件描述符，value是Channel*
-      ChannelMap channels_;
+      ///
+      /// Channels indexed by fd, fds are small and dense, so a flat vector
+      /// beats a std::map in both lookup cost and memory.
+      ///
+      /// Each add() bumps the slot's generation, so an event tagged with an
+      /// old (fd, generation) is recognized as stale after the fd is reused.
+      class ChannelTable
+      {
+      public:
+        ChannelTable() : size_(0) {}
+
+        Channel *find(int fd) const
+        {
+          return static_cast<size_t>(fd) < slots_.size() ? slots_[fd].channel : NULL;
+        }
+        // NULL if the slot has been reused since
+        Channel *find(int fd, uint32_t generation) const
+        {
+          return static_cast<size_t>(fd) < slots_.size() && slots_[fd].generation == generation
+                     ? slots_[fd].channel
+                     : NULL;
+        }
+        uint32_t generation(int fd) const { return slots_[fd].generation; }
+        size_t size() const { return size_; }
+
+        // returns the new generation of this fd
+        uint32_t add(int fd, Channel *channel)
+        {
+          if (static_cast<size_t>(fd) >= slots_.size())
+          {
+            slots_.resize(std::max(static_cast<size_t>(fd) + 1, slots_.size() * 2));
+          }
+          Slot &slot = slots_[fd];
+          assert(slot.channel == NULL);
+          slot.channel = channel;
+          ++size_;
+          return ++slot.generation;
+        }
+
+        void remove(int fd)
+        {
+          assert(find(fd) != NULL);
+          slots_[fd].channel = NULL;
+          --size_;
+        }
+
+      private:
+        struct Slot
+        {
+          Slot() : channel(NULL), generation(0) {}
+
+          Channel *channel;
+          uint32_t generation;
+        };
+
+        std::vector<Slot> slots_;
+        size_t size_;
+      };
+
+      ChannelTable channels_; // fd -> Channel*
 
     private:
       EventLoop *ownerLoop_;
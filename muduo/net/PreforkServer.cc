@@ -0,0 +1,318 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/PreforkServer.h"
+
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <atomic>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct PreforkServer::SharedSlot
+{
+  std::atomic<int> connections; // written by the worker
+};
+
+namespace
+{
+  const double kReapInterval = 0.1;
+  const double kPublishInterval = 0.1;
+  // a worker dying sooner is restarted after that long, not to fork in a loop
+  const double kMinUptime = 1.0;
+
+  // utime, stime and rss of /proc/pid/stat
+  bool readProcStat(pid_t pid, double *cpuSeconds, int64_t *rssBytes)
+  {
+    char path[64];
+    snprintf(path, sizeof path, "/proc/%d/stat", pid);
+    string stat;
+    if (FileUtil::readFile(path, 4096, &stat) != 0)
+    {
+      return false;
+    }
+    // the command may have spaces, fields start after the last ')'
+    size_t pos = stat.rfind(')');
+    if (pos == string::npos)
+    {
+      return false;
+    }
+    unsigned long utime = 0, stime = 0;
+    long rss = 0;
+    // state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt
+    // utime stime cutime cstime priority nice num_threads itrealvalue starttime vsize rss
+    if (sscanf(stat.c_str() + pos + 1,
+               " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u %*u %ld",
+               &utime, &stime, &rss) != 3)
+    {
+      return false;
+    }
+    *cpuSeconds = static_cast<double>(utime + stime) / ProcessInfo::clockTicksPerSecond();
+    *rssBytes = static_cast<int64_t>(rss) * ProcessInfo::pageSize();
+    return true;
+  }
+}
+
+PreforkServer::PreforkServer(EventLoop *loop,
+                             const InetAddress &listenAddr,
+                             const string &nameArg,
+                             int numWorkers)
+    : loop_(CHECK_NOTNULL(loop)),
+      name_(nameArg),
+      listenFd_(sockets::createNonblockingOrDie(listenAddr.family())),
+      numThreads_(0),
+      drainTimeout_(10.0),
+      workers_(numWorkers),
+      slots_(NULL),
+      started_(false),
+      stopping_(false)
+{
+  assert(numWorkers > 0);
+  int optval = 1;
+  ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR,
+               &optval, static_cast<socklen_t>(sizeof optval));
+  sockets::bindOrDie(listenFd_, listenAddr.getSockAddr());
+
+  void *slots = ::mmap(NULL, sizeof(SharedSlot) * workers_.size(), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (slots == MAP_FAILED)
+  {
+    LOG_SYSFATAL << "PreforkServer::PreforkServer mmap";
+  }
+  slots_ = static_cast<SharedSlot *>(slots);
+  for (size_t i = 0; i < workers_.size(); ++i)
+  {
+    new (&slots_[i]) SharedSlot;
+    slots_[i].connections = 0;
+    workers_[i].index = static_cast<int>(i);
+  }
+}
+
+PreforkServer::~PreforkServer()
+{
+  loop_->assertInLoopThread();
+  loop_->cancel(reapTimer_);
+  for (const WorkerStats &worker : workers_)
+  {
+    if (worker.pid > 0)
+    {
+      // they drain on their own
+      ::kill(worker.pid, SIGTERM);
+    }
+  }
+  ::munmap(slots_, sizeof(SharedSlot) * workers_.size());
+  sockets::close(listenFd_);
+}
+
+void PreforkServer::start()
+{
+  loop_->assertInLoopThread();
+  assert(!started_);
+  started_ = true;
+  sockets::listenOrDie(listenFd_);
+  LOG_INFO << "PreforkServer::start [" << name_ << "] - " << workers_.size() << " workers";
+  for (size_t i = 0; i < workers_.size(); ++i)
+  {
+    spawn(static_cast<int>(i));
+  }
+  // polls waitpid() instead of taking SIGCHLD from the application
+  reapTimer_ = loop_->runEvery(kReapInterval, std::bind(&PreforkServer::reap, this));
+}
+
+void PreforkServer::stop()
+{
+  loop_->assertInLoopThread();
+  stopping_ = true;
+  int running = 0;
+  for (const WorkerStats &worker : workers_)
+  {
+    if (worker.pid > 0)
+    {
+      ::kill(worker.pid, SIGTERM);
+      ++running;
+    }
+  }
+  LOG_INFO << "PreforkServer::stop [" << name_ << "] - " << running << " workers";
+  if (running == 0)
+  {
+    loop_->cancel(reapTimer_);
+    if (stoppedCallback_)
+    {
+      stoppedCallback_();
+    }
+  }
+}
+
+void PreforkServer::spawn(int index)
+{
+  loop_->assertInLoopThread();
+  WorkerStats &worker = workers_[index];
+  if (stopping_ || worker.pid > 0)
+  {
+    return;
+  }
+  slots_[index].connections = 0;
+  pid_t pid = ::fork();
+  if (pid < 0)
+  {
+    LOG_SYSERR << "PreforkServer::spawn [" << name_ << "] - worker " << index;
+    loop_->runAfter(kMinUptime, std::bind(&PreforkServer::spawn, this, index));
+  }
+  else if (pid == 0)
+  {
+    runWorker(index);
+    ::_exit(0); // skips destructors of the master
+  }
+  else
+  {
+    LOG_INFO << "PreforkServer::spawn [" << name_ << "] - worker " << index << " pid " << pid;
+    worker.pid = pid;
+    worker.started = Timestamp::now();
+  }
+}
+
+// In the child, whose only thread is the master loop's, so its EventLoop
+// runs in a new thread.
+void PreforkServer::runWorker(int index)
+{
+  // taken by the signalfd of the worker loop
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGTERM);
+  ::pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  char name[32];
+  snprintf(name, sizeof name, "%s-%d", name_.c_str(), index);
+  Thread thread(std::bind(&PreforkServer::workerThread, this, index), name);
+  thread.start();
+  thread.join();
+}
+
+void PreforkServer::workerThread(int index)
+{
+  EventLoop loop;
+  TcpServer server(&loop, listenFd_, name_);
+  server.setExclusiveAccept();
+  server.setThreadNum(numThreads_);
+  if (workerInitCallback_)
+  {
+    workerInitCallback_(&server, index);
+  }
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGTERM);
+  int sigfd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (sigfd < 0)
+  {
+    LOG_SYSFATAL << "PreforkServer::workerThread signalfd";
+  }
+  Channel sigChannel(&loop, sigfd);
+  sigChannel.setReadCallback([&](Timestamp) {
+    struct signalfd_siginfo info;
+    if (::read(sigfd, &info, sizeof info) == sizeof info && !server.draining())
+    {
+      server.drain(drainTimeout_, std::bind(&EventLoop::quit, &loop));
+    }
+  });
+  sigChannel.enableReading();
+
+  SharedSlot *slot = &slots_[index];
+  loop.runEvery(kPublishInterval, [&server, slot] {
+    slot->connections = server.numConnections();
+  });
+
+  server.start();
+  loop.loop();
+  sigChannel.disableAll();
+  sigChannel.remove();
+  ::close(sigfd);
+}
+
+void PreforkServer::reap()
+{
+  loop_->assertInLoopThread();
+  bool running = false;
+  for (WorkerStats &worker : workers_)
+  {
+    int status = 0;
+    if (worker.pid <= 0 || ::waitpid(worker.pid, &status, WNOHANG) <= 0)
+    {
+      running = running || worker.pid > 0;
+      continue;
+    }
+    worker.pid = 0;
+    worker.lastExitStatus = status;
+    slots_[worker.index].connections = 0;
+    if (stopping_)
+    {
+      continue;
+    }
+    if (WIFSIGNALED(status))
+    {
+      LOG_ERROR << "PreforkServer::reap [" << name_ << "] - worker " << worker.index
+                << " killed by signal " << WTERMSIG(status);
+    }
+    else
+    {
+      LOG_ERROR << "PreforkServer::reap [" << name_ << "] - worker " << worker.index
+                << " exited with " << WEXITSTATUS(status);
+    }
+    ++worker.restarts;
+    double uptime = timeDifference(Timestamp::now(), worker.started);
+    if (uptime < kMinUptime)
+    {
+      loop_->runAfter(kMinUptime - uptime, std::bind(&PreforkServer::spawn, this, worker.index));
+    }
+    else
+    {
+      spawn(worker.index);
+    }
+    running = true;
+  }
+  if (stopping_ && !running)
+  {
+    LOG_INFO << "PreforkServer::reap [" << name_ << "] - all workers stopped";
+    loop_->cancel(reapTimer_);
+    if (stoppedCallback_)
+    {
+      stoppedCallback_();
+    }
+  }
+}
+
+std::vector<PreforkServer::WorkerStats> PreforkServer::workerStats() const
+{
+  loop_->assertInLoopThread();
+  std::vector<WorkerStats> stats(workers_);
+  for (WorkerStats &worker : stats)
+  {
+    if (worker.pid > 0)
+    {
+      worker.connections = slots_[worker.index].connections;
+      readProcStat(worker.pid, &worker.cpuSeconds, &worker.rssBytes);
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,117 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PREFORKSERVER_H
+#define MUDUO_NET_PREFORKSERVER_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    class EventLoop;
+    class InetAddress;
+    class TcpServer;
+
+    ///
+    /// TcpServer in several processes sharing one listen socket.
+    ///
+    /// The master binds, then forks @c numWorkers workers, each running a
+    /// TcpServer with its own EventLoop and optional IO threads, accepting
+    /// with EPOLLEXCLUSIVE. The master restarts workers that die, and knows
+    /// their connections, CPU time and memory, see workerStats() and
+    /// PreforkInspector. For libraries with global locks, or allocators that
+    /// don't scale with threads.
+    ///
+    /// SIGTERM makes a worker drain its connections and exit.
+    class PreforkServer : noncopyable
+    {
+    public:
+      /// Called in each worker, before starting its server.
+      typedef std::function<void(TcpServer *, int workerIndex)> WorkerInitCallback;
+      typedef std::function<void()> StoppedCallback;
+
+      struct WorkerStats
+      {
+        int index;
+        pid_t pid;          // 0 if not running
+        int restarts;
+        int lastExitStatus; // from waitpid()
+        Timestamp started;
+        int connections;
+        double cpuSeconds;  // user + system
+        int64_t rssBytes;
+      };
+
+      PreforkServer(EventLoop *loop,
+                    const InetAddress &listenAddr,
+                    const string &nameArg,
+                    int numWorkers);
+      ~PreforkServer();
+
+      const string &name() const { return name_; }
+      EventLoop *getLoop() const { return loop_; }
+
+      /// Must be called before @c start
+      void setWorkerInitCallback(const WorkerInitCallback &cb) { workerInitCallback_ = cb; }
+      /// IO threads of each worker, 0 by default.
+      /// Must be called before @c start
+      void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+      /// Seconds a stopping worker waits for its connections, 10 by default.
+      void setDrainTimeout(double seconds) { drainTimeout_ = seconds; }
+      /// Called once all workers exited after stop().
+      void setStoppedCallback(const StoppedCallback &cb) { stoppedCallback_ = cb; }
+
+      /// Listens and forks the workers, returns in the master only.
+      /// Not thread safe, but in loop
+      void start();
+      /// Sends SIGTERM to the workers, without restarting them.
+      /// Not thread safe, but in loop
+      void stop();
+
+      /// Not thread safe, but in loop
+      std::vector<WorkerStats> workerStats() const;
+      int numWorkers() const { return static_cast<int>(workers_.size()); }
+
+    private:
+      struct SharedSlot;
+
+      void spawn(int index);
+      void runWorker(int index);
+      void workerThread(int index);
+      void reap();
+
+      EventLoop *loop_;
+      const string name_;
+      int listenFd_;
+      int numThreads_;
+      double drainTimeout_;
+      WorkerInitCallback workerInitCallback_;
+      StoppedCallback stoppedCallback_;
+      std::vector<WorkerStats> workers_; // connections and below are filled in workerStats()
+      SharedSlot *slots_; // shared with workers, one per worker
+      TimerId reapTimer_;
+      bool started_;
+      bool stopping_;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_PREFORKSERVER_H
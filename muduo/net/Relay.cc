@@ -0,0 +1,299 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/Relay.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+Relay::Direction::Direction()
+    : inPipe(0),
+      eof(false),
+      done(false),
+      paused(false),
+      bytes(0)
+{
+  pipe[0] = pipe[1] = -1;
+}
+
+RelayPtr Relay::start(const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+{
+  a->getLoop()->assertInLoopThread();
+  RelayPtr relay;
+  if (a->getLoop() != b->getLoop())
+  {
+    LOG_ERROR << "Relay::start " << a->name() << " and " << b->name() << " are in different loops";
+    return relay;
+  }
+  if (a->isTls() || b->isTls() || !a->connected() || !b->connected() || a->relay_ || b->relay_)
+  {
+    LOG_ERROR << "Relay::start " << a->name() << " and " << b->name() << " can't be relayed";
+    return relay;
+  }
+  relay.reset(new Relay(a, b));
+  if (!relay->init())
+  {
+    relay.reset();
+    return relay;
+  }
+  a->relay_ = relay;
+  b->relay_ = relay;
+  LOG_DEBUG << "Relay::start " << a->name() << " <-> " << b->name();
+
+  // anything read before starting goes ahead of the pipe, via outputBuffer_
+  if (a->inputBuffer_.readableBytes() > 0)
+  {
+    relay->dirs_[0].bytes += a->inputBuffer_.readableBytes();
+    b->send(&a->inputBuffer_);
+  }
+  if (b->inputBuffer_.readableBytes() > 0)
+  {
+    relay->dirs_[1].bytes += b->inputBuffer_.readableBytes();
+    a->send(&b->inputBuffer_);
+  }
+  return relay;
+}
+
+Relay::Relay(const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+    : a_(get_pointer(a)),
+      b_(get_pointer(b)),
+      pipeSize_(0)
+{
+  dirs_[0].src = a;
+  dirs_[0].dst = b;
+  dirs_[1].src = b;
+  dirs_[1].dst = a;
+}
+
+Relay::~Relay()
+{
+  for (Direction &dir : dirs_)
+  {
+    if (dir.pipe[0] >= 0)
+    {
+      ::close(dir.pipe[0]);
+      ::close(dir.pipe[1]);
+    }
+  }
+}
+
+bool Relay::init()
+{
+  for (Direction &dir : dirs_)
+  {
+    if (::pipe2(dir.pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+      LOG_SYSERR << "Relay::init pipe2";
+      return false;
+    }
+  }
+  int size = ::fcntl(dirs_[0].pipe[0], F_GETPIPE_SZ);
+  pipeSize_ = size > 0 ? static_cast<size_t>(size) : 64 * 1024;
+  return true;
+}
+
+Relay::Direction *Relay::from(TcpConnection *conn)
+{
+  return conn == a_ ? &dirs_[0] : &dirs_[1];
+}
+
+Relay::Direction *Relay::to(TcpConnection *conn)
+{
+  return conn == a_ ? &dirs_[1] : &dirs_[0];
+}
+
+bool Relay::handleRead(TcpConnection *conn)
+{
+  Direction *dir = from(conn);
+  if (dir->done || dir->eof)
+  {
+    return false;
+  }
+  RelayPtr guardThis(shared_from_this());
+  pump(dir);
+  return true;
+}
+
+bool Relay::handleWrite(TcpConnection *conn)
+{
+  Direction *dir = to(conn);
+  if (dir->done)
+  {
+    return false;
+  }
+  RelayPtr guardThis(shared_from_this());
+  pump(dir);
+  return !dir->done && dir->inPipe > 0;
+}
+
+void Relay::handleClose(TcpConnection *conn)
+{
+  RelayPtr guardThis(shared_from_this());
+  // nowhere to deliver, drop it
+  Direction *in = to(conn);
+  if (!in->done)
+  {
+    in->inPipe = 0;
+    finish(in);
+  }
+  // deliver what is left, then shutdown the other side
+  Direction *out = from(conn);
+  if (!out->done)
+  {
+    out->eof = true;
+    pump(out);
+  }
+  detachIfDone();
+}
+
+// Moves data src -> pipe -> dst until either side would block.
+// Only reads into an empty pipe, so EAGAIN on reading means src is empty,
+// and a non-empty pipe means dst is full.
+void Relay::pump(Direction *dir)
+{
+  TcpConnectionPtr src(dir->src.lock());
+  TcpConnectionPtr dst(dir->dst.lock());
+  if (!dst || dst->disconnected())
+  {
+    dir->inPipe = 0;
+    finish(dir);
+    detachIfDone();
+    return;
+  }
+
+  bool hasRead = false; // one read(2) per readable event, like Buffer::readFd
+  while (true)
+  {
+    if (dir->inPipe > 0)
+    {
+      if (dst->outputBuffer_.readableBytes() > 0 || !dst->pendingFiles_.empty())
+      {
+        // earlier send()s first, dst->handleWrite() calls us back
+        pauseSource(dir, src);
+        break;
+      }
+      ssize_t n = ::splice(dir->pipe[0], NULL, dst->channel_.fd(), NULL,
+                           dir->inPipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0)
+      {
+        dir->inPipe -= n;
+        dir->bytes += n;
+        continue;
+      }
+      else if (n < 0 && errno == EAGAIN)
+      {
+        pauseSource(dir, src);
+        if (!dst->channel_.isWriting())
+        {
+          dst->channel_.enableWriting();
+        }
+        break;
+      }
+      LOG_SYSERR << "Relay::pump splice to " << dst->name();
+      dir->inPipe = 0;
+      finish(dir);
+      dst->forceClose();
+      if (src)
+      {
+        src->forceClose();
+      }
+      break;
+    }
+
+    if (dir->eof)
+    {
+      finish(dir);
+      dst->shutdown();
+      detachIfDone();
+      break;
+    }
+    resumeSource(dir);
+    if (hasRead || !src || !src->reading_ || src->readPauses_ > 0)
+    {
+      break;
+    }
+
+    hasRead = true;
+    ssize_t n = ::splice(src->channel_.fd(), NULL, dir->pipe[1], NULL,
+                         pipeSize_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0)
+    {
+      dir->inPipe += n;
+    }
+    else if (n == 0)
+    {
+      // src->handleClose() calls back handleClose(), which drains and shuts down dst
+      src->handleClose();
+      break;
+    }
+    else if (errno == EAGAIN)
+    {
+      break;
+    }
+    else
+    {
+      LOG_SYSERR << "Relay::pump splice from " << src->name();
+      src->handleError();
+      src->handleClose();
+      break;
+    }
+  }
+}
+
+void Relay::finish(Direction *dir)
+{
+  resumeSource(dir);
+  dir->done = true;
+}
+
+void Relay::pauseSource(Direction *dir, const TcpConnectionPtr &src)
+{
+  if (!dir->paused && src && src->channel_.isReading())
+  {
+    src->channel_.disableReading();
+    dir->paused = true;
+  }
+}
+
+void Relay::resumeSource(Direction *dir)
+{
+  if (dir->paused)
+  {
+    dir->paused = false;
+    TcpConnectionPtr src(dir->src.lock());
+    // respect stopRead() called meanwhile
+    if (src && !src->disconnected() && src->reading_ && src->readPauses_ == 0
+        && !src->channel_.isReading())
+    {
+      src->channel_.enableReading();
+    }
+  }
+}
+
+void Relay::detachIfDone()
+{
+  if (dirs_[0].done && dirs_[1].done)
+  {
+    RelayPtr guardThis(shared_from_this());
+    for (Direction &dir : dirs_)
+    {
+      TcpConnectionPtr conn(dir.src.lock());
+      if (conn && conn->relay_.get() == this)
+      {
+        conn->relay_.reset();
+      }
+    }
+  }
+}
@@ -0,0 +1,96 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_RELAY_H
+#define MUDUO_NET_RELAY_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Callbacks.h"
+
+#include <memory>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    class Relay;
+    typedef std::shared_ptr<Relay> RelayPtr;
+
+    ///
+    /// Zero-copy relaying between two TcpConnections, for tunnels and L4 proxies.
+    ///
+    /// Bytes go socket -> pipe -> socket with splice(2), one pipe per direction,
+    /// never through user space. Reading from one side is paused while the
+    /// other side can't take more, so at most one pipe of data is in flight.
+    ///
+    /// Once started, messageCallback of both connections is not called,
+    /// don't send() on them either. When one side closes, what is left in
+    /// the pipe is delivered and the other side is shutdown(), the other
+    /// direction is dropped and the surviving connection goes back to normal.
+    ///
+    /// The Relay is owned by the connections, the returned pointer is
+    /// only for statistics.
+    class Relay : noncopyable, public std::enable_shared_from_this<Relay>
+    {
+    public:
+      /// Both must be connected, plain TCP (no TLS) and in the same loop,
+      /// must be called in that loop. Data already in their input buffers
+      /// is forwarded first. Returns null on failure, with both unchanged.
+      static RelayPtr start(const TcpConnectionPtr &a, const TcpConnectionPtr &b);
+
+      ~Relay();
+
+      int64_t bytesFromA() const { return dirs_[0].bytes; }
+      int64_t bytesFromB() const { return dirs_[1].bytes; }
+
+    private:
+      friend class TcpConnection;
+
+      struct Direction
+      {
+        Direction();
+
+        std::weak_ptr<TcpConnection> src;
+        std::weak_ptr<TcpConnection> dst;
+        int pipe[2];
+        size_t inPipe;
+        bool eof;     // src closed, shutdown dst after draining the pipe
+        bool done;
+        bool paused;  // src reading paused by us
+        int64_t bytes;
+      };
+
+      Relay(const TcpConnectionPtr &a, const TcpConnectionPtr &b);
+      bool init();
+
+      // called by TcpConnection, return false if not relaying in that direction
+      bool handleRead(TcpConnection *conn);
+      // return true if still waiting for conn to be writable
+      bool handleWrite(TcpConnection *conn);
+      void handleClose(TcpConnection *conn);
+
+      void pump(Direction *dir);
+      void finish(Direction *dir);
+      void pauseSource(Direction *dir, const TcpConnectionPtr &src);
+      void resumeSource(Direction *dir);
+      void detachIfDone();
+      Direction *from(TcpConnection *conn);
+      Direction *to(TcpConnection *conn);
+
+      TcpConnection *a_; // for identity only, may be dangling after close
+      TcpConnection *b_;
+      Direction dirs_[2]; // a -> b, b -> a
+      size_t pipeSize_;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_RELAY_H
@@ -0,0 +1,636 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/SimNetwork.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/Callbacks.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace muduo
+{
+  namespace net
+  {
+    namespace detail
+    {
+
+      struct SimSegment
+      {
+        Timestamp arrival;
+        size_t len;
+        bool fin;
+      };
+
+      // One direction of a connection.
+      struct SimPipe
+      {
+        explicit SimPipe(const SimNetwork::Link &l)
+            : link(l), delivered(0), finSent(false), finDelivered(false), readerClosed(false)
+        {
+        }
+
+        // in order, as TCP reassembles them
+        void deliver(Timestamp now)
+        {
+          while (!inFlight.empty() && !(now < inFlight.front().arrival))
+          {
+            delivered += inFlight.front().len;
+            finDelivered = finDelivered || inFlight.front().fin;
+            inFlight.pop_front();
+          }
+        }
+
+        SimNetwork::Link link;
+        Buffer data;      // written and not read, the first delivered bytes have arrived
+        size_t delivered;
+        std::deque<SimSegment> inFlight;
+        Timestamp linkFree;  // when the last segment has left the sender
+        bool finSent;
+        bool finDelivered;
+        bool readerClosed;
+      };
+
+      typedef std::shared_ptr<SimPipe> SimPipePtr;
+
+      struct SimSocket
+      {
+        enum State
+        {
+          kIdle,
+          kListening,
+          kConnecting,
+          kConnected,
+        };
+
+        SimSocket()
+            : state(kIdle), bound(false), refused(false), error(0)
+        {
+          memZero(&local, sizeof local);
+          memZero(&peer, sizeof peer);
+        }
+
+        State state;
+        bool bound;
+        bool refused;
+        int error;               // SO_ERROR
+        Timestamp established;   // kConnecting, the SYN-ACK arrives
+        struct sockaddr_in6 local;
+        struct sockaddr_in6 peer;
+        SimPipePtr in;
+        SimPipePtr out;
+        std::deque<std::pair<Timestamp, int>> backlog;  // kListening
+      };
+
+      class SimSockets : public sockets::Hooks
+      {
+      public:
+        SimSockets(SimNetwork *net, uint64_t seed)
+            : sent(0), lost(0), reordered(0), net_(net), rng_(seed), nextPort_(32768)
+        {
+        }
+
+        bool owns(int sockfd) const override
+        {
+          return sockets_.find(sockfd) != sockets_.end();
+        }
+
+        int socket(sa_family_t family) override
+        {
+          // a real fd keeps the number unique and takes setsockopt()
+          int fd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+          if (fd >= 0)
+          {
+            sockets_[fd].local.sin6_family = family;
+          }
+          return fd;
+        }
+
+        int connect(int sockfd, const struct sockaddr *addr) override
+        {
+          SimSocket &sock = sockets_[sockfd];
+          if (sock.state != SimSocket::kIdle)
+          {
+            errno = EISCONN;
+            return -1;
+          }
+          copyAddr(&sock.peer, addr);
+          if (!sock.bound)
+          {
+            sock.local = sock.peer;
+            setPort(&sock.local, nextPort_++);
+            sock.bound = true;
+          }
+          Timestamp now = net_->now();
+          sock.out.reset(new SimPipe(link));
+          sock.in.reset(new SimPipe(link));
+          sock.state = SimSocket::kConnecting;
+          sock.established = addTime(now, 2 * link.latency);
+
+          SimSocket *listener = findListener(sock.peer);
+          sock.refused = listener == NULL;
+          if (listener)
+          {
+            int fd = ::socket(sock.local.sin6_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+            if (fd < 0)
+            {
+              return -1;
+            }
+            SimSocket &accepted = sockets_[fd];
+            accepted.state = SimSocket::kConnected;
+            accepted.bound = true;
+            accepted.local = sock.peer;
+            accepted.peer = sock.local;
+            accepted.in = sock.out;
+            accepted.out = sock.in;
+            listener->backlog.push_back(std::make_pair(addTime(now, link.latency), fd));
+          }
+          errno = EINPROGRESS;
+          return -1;
+        }
+
+        int bind(int sockfd, const struct sockaddr *addr) override
+        {
+          struct sockaddr_in6 local;
+          copyAddr(&local, addr);
+          if (port(local) == 0)
+          {
+            setPort(&local, nextPort_++);
+          }
+          for (const auto &it : sockets_)
+          {
+            if (it.second.bound && it.second.state == SimSocket::kListening &&
+                port(it.second.local) == port(local))
+            {
+              errno = EADDRINUSE;
+              return -1;
+            }
+          }
+          SimSocket &sock = sockets_[sockfd];
+          sock.local = local;
+          sock.bound = true;
+          return 0;
+        }
+
+        int listen(int sockfd) override
+        {
+          sockets_[sockfd].state = SimSocket::kListening;
+          return 0;
+        }
+
+        int accept(int sockfd, struct sockaddr_in6 *addr) override
+        {
+          SimSocket &sock = sockets_[sockfd];
+          if (sock.state != SimSocket::kListening)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+          if (sock.backlog.empty() || net_->now() < sock.backlog.front().first)
+          {
+            errno = EAGAIN;
+            return -1;
+          }
+          int fd = sock.backlog.front().second;
+          sock.backlog.pop_front();
+          *addr = sockets_[fd].peer;
+          return fd;
+        }
+
+        ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt) override
+        {
+          SimSocket &sock = update(sockfd);
+          if (sock.state != SimSocket::kConnected)
+          {
+            errno = sock.state == SimSocket::kConnecting ? EAGAIN : ENOTCONN;
+            return -1;
+          }
+          SimPipe *pipe = get_pointer(sock.in);
+          pipe->deliver(net_->now());
+          if (pipe->delivered == 0)
+          {
+            if (pipe->finDelivered)
+            {
+              return 0;
+            }
+            errno = EAGAIN;
+            return -1;
+          }
+          size_t n = 0;
+          for (int i = 0; i < iovcnt && n < pipe->delivered; ++i)
+          {
+            size_t len = std::min(iov[i].iov_len, pipe->delivered - n);
+            memcpy(iov[i].iov_base, pipe->data.peek() + n, len);
+            n += len;
+          }
+          pipe->data.retrieve(n);
+          pipe->delivered -= n;
+          return static_cast<ssize_t>(n);
+        }
+
+        ssize_t write(int sockfd, const void *buf, size_t count) override
+        {
+          SimSocket &sock = update(sockfd);
+          if (sock.state != SimSocket::kConnected)
+          {
+            errno = sock.state == SimSocket::kConnecting ? EAGAIN : EPIPE;
+            return -1;
+          }
+          SimPipe *pipe = get_pointer(sock.out);
+          if (pipe->finSent)
+          {
+            errno = EPIPE;
+            return -1;
+          }
+          if (pipe->readerClosed)
+          {
+            // taken and dropped, until the FIN of the peer tells us
+            sock.in->deliver(net_->now());
+            if (sock.in->finDelivered)
+            {
+              errno = EPIPE;
+              return -1;
+            }
+            return static_cast<ssize_t>(count);
+          }
+          size_t space = pipe->link.bufferBytes - std::min(pipe->link.bufferBytes, pipe->data.readableBytes());
+          if (space == 0)
+          {
+            errno = EAGAIN;
+            return -1;
+          }
+          size_t n = std::min(count, space);
+          pipe->data.append(static_cast<const char *>(buf), n);
+          transmit(pipe, n, false);
+          return static_cast<ssize_t>(n);
+        }
+
+        int close(int sockfd) override
+        {
+          SimSocket &sock = sockets_[sockfd];
+          for (const auto &pending : sock.backlog)
+          {
+            shutdown(&sockets_[pending.second]);
+            ::close(pending.second);
+            sockets_.erase(pending.second);
+          }
+          shutdown(&sockets_[sockfd]);
+          sockets_.erase(sockfd);
+          return ::close(sockfd);
+        }
+
+        int shutdownWrite(int sockfd) override
+        {
+          SimSocket &sock = update(sockfd);
+          if (sock.state != SimSocket::kConnected)
+          {
+            errno = ENOTCONN;
+            return -1;
+          }
+          sendFin(get_pointer(sock.out));
+          return 0;
+        }
+
+        int getSocketError(int sockfd) override
+        {
+          SimSocket &sock = update(sockfd);
+          int error = sock.error;
+          sock.error = 0;
+          return error;
+        }
+
+        struct sockaddr_in6 getLocalAddr(int sockfd) override
+        {
+          return sockets_[sockfd].local;
+        }
+
+        struct sockaddr_in6 getPeerAddr(int sockfd) override
+        {
+          return sockets_[sockfd].peer;
+        }
+
+        int events(int sockfd)
+        {
+          SimSocket &sock = update(sockfd);
+          Timestamp now = net_->now();
+          int revents = 0;
+          if (sock.state == SimSocket::kListening)
+          {
+            if (!sock.backlog.empty() && !(now < sock.backlog.front().first))
+            {
+              revents |= POLLIN;
+            }
+          }
+          else if (sock.state == SimSocket::kConnected)
+          {
+            sock.in->deliver(now);
+            if (sock.in->delivered > 0 || sock.in->finDelivered)
+            {
+              revents |= POLLIN;
+            }
+            const SimPipe &out = *sock.out;
+            if (out.readerClosed || out.finSent || out.data.readableBytes() < out.link.bufferBytes)
+            {
+              revents |= POLLOUT;
+            }
+          }
+          else if (sock.error)
+          {
+            // a refused connect, SO_ERROR tells the rest
+            revents |= POLLOUT;
+          }
+          return revents;
+        }
+
+        Timestamp nextEvent()
+        {
+          Timestamp now = net_->now();
+          Timestamp next;
+          for (auto &it : sockets_)
+          {
+            SimSocket &sock = update(it.first);
+            Timestamp when;
+            if (sock.state == SimSocket::kConnecting)
+            {
+              when = sock.established;
+            }
+            else if (sock.state == SimSocket::kListening)
+            {
+              for (const auto &pending : sock.backlog)
+              {
+                if (now < pending.first)
+                {
+                  when = pending.first;
+                  break;
+                }
+              }
+            }
+            else if (sock.state == SimSocket::kConnected)
+            {
+              sock.in->deliver(now);
+              if (!sock.in->inFlight.empty())
+              {
+                when = sock.in->inFlight.front().arrival;
+              }
+            }
+            if (when.valid() && (!next.valid() || when < next))
+            {
+              next = when;
+            }
+          }
+          return next;
+        }
+
+        SimNetwork::Link link;
+        int64_t sent;
+        int64_t lost;
+        int64_t reordered;
+
+      private:
+        SimSocket &update(int sockfd)
+        {
+          SimSocket &sock = sockets_[sockfd];
+          if (sock.state == SimSocket::kConnecting && !(net_->now() < sock.established))
+          {
+            if (sock.refused)
+            {
+              sock.state = SimSocket::kIdle;
+              sock.error = ECONNREFUSED;
+            }
+            else
+            {
+              sock.state = SimSocket::kConnected;
+            }
+          }
+          return sock;
+        }
+
+        void shutdown(SimSocket *sock)
+        {
+          if (sock->out && !sock->out->readerClosed)
+          {
+            sendFin(get_pointer(sock->out));
+          }
+          if (sock->in)
+          {
+            sock->in->readerClosed = true;
+            sock->in->data.retrieveAll();
+            sock->in->delivered = 0;
+          }
+        }
+
+        void sendFin(SimPipe *pipe)
+        {
+          if (!pipe->finSent)
+          {
+            pipe->finSent = true;
+            transmit(pipe, 0, true);
+          }
+        }
+
+        void transmit(SimPipe *pipe, size_t len, bool fin)
+        {
+          const SimNetwork::Link &l = pipe->link;
+          Timestamp now = net_->now();
+          size_t mss = std::max(l.mss, static_cast<size_t>(1));
+          do
+          {
+            size_t seg = std::min(len, mss);
+            len -= seg;
+            Timestamp depart = pipe->linkFree < now ? now : pipe->linkFree;
+            pipe->linkFree = l.bandwidth > 0 ? addTime(depart, static_cast<double>(seg) / l.bandwidth)
+                                             : depart;
+            double delay = l.latency;
+            while (l.lossRate > 0 && uniform() < l.lossRate)
+            {
+              delay += l.rto;
+              ++lost;
+            }
+            if (l.reorderRate > 0 && uniform() < l.reorderRate)
+            {
+              delay += l.reorderDelay;
+              ++reordered;
+            }
+            SimSegment segment = {addTime(pipe->linkFree, delay), seg, fin && len == 0};
+            pipe->inFlight.push_back(segment);
+            ++sent;
+          } while (len > 0);
+        }
+
+        SimSocket *findListener(const struct sockaddr_in6 &addr)
+        {
+          for (auto &it : sockets_)
+          {
+            SimSocket &sock = it.second;
+            if (sock.state == SimSocket::kListening && port(sock.local) == port(addr) &&
+                (isAny(sock.local) || sameHost(sock.local, addr)))
+            {
+              return &sock;
+            }
+          }
+          return NULL;
+        }
+
+        // 53 bits, the same on every platform unlike std::uniform_real_distribution
+        double uniform()
+        {
+          return static_cast<double>(rng_() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        static void copyAddr(struct sockaddr_in6 *to, const struct sockaddr *addr)
+        {
+          memZero(to, sizeof *to);
+          memcpy(to, addr, addr->sa_family == AF_INET ? sizeof(struct sockaddr_in) : sizeof *to);
+        }
+
+        // sin_port and sin6_port are at the same offset
+        static uint16_t port(const struct sockaddr_in6 &addr)
+        {
+          return ntohs(addr.sin6_port);
+        }
+
+        static void setPort(struct sockaddr_in6 *addr, uint16_t port)
+        {
+          addr->sin6_port = htons(port);
+        }
+
+        static bool isAny(const struct sockaddr_in6 &addr)
+        {
+          if (addr.sin6_family == AF_INET)
+          {
+            return sockets::sockaddr_in_cast(sockets::sockaddr_cast(&addr))->sin_addr.s_addr == htonl(INADDR_ANY);
+          }
+          return memcmp(&addr.sin6_addr, &in6addr_any, sizeof in6addr_any) == 0;
+        }
+
+        static bool sameHost(const struct sockaddr_in6 &a, const struct sockaddr_in6 &b)
+        {
+          if (a.sin6_family != b.sin6_family)
+          {
+            return false;
+          }
+          if (a.sin6_family == AF_INET)
+          {
+            return sockets::sockaddr_in_cast(sockets::sockaddr_cast(&a))->sin_addr.s_addr ==
+                   sockets::sockaddr_in_cast(sockets::sockaddr_cast(&b))->sin_addr.s_addr;
+          }
+          return memcmp(&a.sin6_addr, &b.sin6_addr, sizeof a.sin6_addr) == 0;
+        }
+
+        SimNetwork *net_;
+        std::mt19937_64 rng_;
+        std::map<int, SimSocket> sockets_;  // ordered by fd, so is every run
+        uint16_t nextPort_;
+      };
+
+    } // namespace detail
+  }   // namespace net
+} // namespace muduo
+
+using namespace muduo;
+using namespace muduo::net;
+
+SimNetwork *SimNetwork::current_ = NULL;
+
+SimNetwork::Link::Link()
+    : latency(0.0001),
+      bandwidth(0),
+      lossRate(0),
+      rto(0.2),
+      reorderRate(0),
+      reorderDelay(0.001),
+      mss(1460),
+      bufferBytes(256 * 1024)
+{
+}
+
+SimNetwork::SimNetwork(uint64_t seed)
+    : now_(Timestamp::fromUnixTime(1577836800)),  // 2020-01-01, the same in every run
+      sockets_(new detail::SimSockets(this, seed))
+{
+  if (current_)
+  {
+    LOG_FATAL << "Another SimNetwork " << current_ << " exists";
+  }
+  current_ = this;
+  Timestamp::setClock(&SimNetwork::clock);
+  sockets::setHooks(get_pointer(sockets_));
+}
+
+SimNetwork::~SimNetwork()
+{
+  // sockets still open are closed by their owners through ::close()
+  sockets::setHooks(NULL);
+  Timestamp::setClock(NULL);
+  current_ = NULL;
+}
+
+void SimNetwork::setLink(const Link &link)
+{
+  sockets_->link = link;
+}
+
+const SimNetwork::Link &SimNetwork::link() const
+{
+  return sockets_->link;
+}
+
+int64_t SimNetwork::segmentsSent() const
+{
+  return sockets_->sent;
+}
+
+int64_t SimNetwork::segmentsLost() const
+{
+  return sockets_->lost;
+}
+
+int64_t SimNetwork::segmentsReordered() const
+{
+  return sockets_->reordered;
+}
+
+bool SimNetwork::owns(int fd) const
+{
+  return sockets_->owns(fd);
+}
+
+int SimNetwork::events(int fd)
+{
+  return sockets_->events(fd);
+}
+
+Timestamp SimNetwork::nextEvent()
+{
+  return sockets_->nextEvent();
+}
+
+void SimNetwork::advanceTo(Timestamp when)
+{
+  assert(!(when < now_));
+  now_ = when;
+}
+
+Timestamp SimNetwork::clock()
+{
+  return current_->now_;
+}
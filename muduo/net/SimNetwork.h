@@ -0,0 +1,100 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SIMNETWORK_H
+#define MUDUO_NET_SIMNETWORK_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
+
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    namespace detail
+    {
+      class SimSockets;
+    }
+
+    ///
+    /// A deterministic TCP network on a virtual clock, to reproduce latency
+    /// and backpressure behaviour of TcpServer and TcpClient in tests.
+    ///
+    /// While it exists, Timestamp::now() is virtual, sockets from
+    /// sockets::createNonblockingOrDie() are simulated, and EventLoops
+    /// created afterwards poll with SimPoller, which moves the clock to the
+    /// next event instead of sleeping. Code under test runs unchanged, all in
+    /// the thread of the SimNetwork: TcpServer without IO threads, TcpClients
+    /// on the same loop. The same seed gives the same run.
+    ///
+    /// Data is delivered in order as TCP does, a lost or reordered segment
+    /// holds back the ones behind it. sendfile() is a copy, splice() and
+    /// socket options are not simulated.
+    class SimNetwork : noncopyable
+    {
+    public:
+      /// One direction of a connection.
+      struct Link
+      {
+        Link();
+
+        double latency;      // one way, in seconds
+        double bandwidth;    // bytes per second of each connection, 0 is unlimited
+        double lossRate;     // a lost segment is retransmitted after rto
+        double rto;
+        double reorderRate;  // a reordered segment arrives reorderDelay late
+        double reorderDelay;
+        size_t mss;
+        size_t bufferBytes;  // written but not read, write() gets EAGAIN beyond
+      };
+
+      explicit SimNetwork(uint64_t seed = 1);
+      ~SimNetwork();
+
+      /// For connections made afterwards.
+      void setLink(const Link &link);
+      const Link &link() const;
+
+      Timestamp now() const { return now_; }
+
+      int64_t segmentsSent() const;
+      int64_t segmentsLost() const;
+      int64_t segmentsReordered() const;
+
+      /// NULL if there is none.
+      static SimNetwork *current() { return current_; }
+
+      // internal usage, by SimPoller
+      bool owns(int fd) const;
+      /// POLLIN, POLLOUT and POLLERR ready on a simulated socket now.
+      int events(int fd);
+      /// The earliest arrival or handshake after now, invalid if none.
+      Timestamp nextEvent();
+      void advanceTo(Timestamp when);
+
+    private:
+      static Timestamp clock();
+
+      static SimNetwork *current_;
+
+      Timestamp now_;
+      std::unique_ptr<detail::SimSockets> sockets_;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_SIMNETWORK_H
@@ -14,7 +14,6 @@
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
-#include <stdio.h> // snprintf
 
 using namespace muduo;
 using namespace muduo::net;
@@ -26,35 +25,12 @@ Socket::~Socket()
 
 bool Socket::getTcpInfo(struct tcp_info *tcpi) const
 {
-  socklen_t len = sizeof(*tcpi);
-  memZero(tcpi, len);
-  return ::getsockopt(sockfd_, SOL_TCP, TCP_INFO, tcpi, &len) == 0;
+  return sockets::getTcpInfo(sockfd_, tcpi);
 }
 
 bool Socket::getTcpInfoString(char *buf, int len) const
 {
-  struct tcp_info tcpi;
-  bool ok = getTcpInfo(&tcpi);
-  if (ok)
-  {
-    snprintf(buf, len, "unrecovered=%u "
-                       "rto=%u ato=%u snd_mss=%u rcv_mss=%u "
-                       "lost=%u retrans=%u rtt=%u rttvar=%u "
-                       "sshthresh=%u cwnd=%u total_retrans=%u",
-             tcpi.tcpi_retransmits, // Number of unrecovered [RTO] timeouts
-             tcpi.tcpi_rto,         // Retransmit timeout in usec
-             tcpi.tcpi_ato,         // Predicted tick of soft clock in usec
-             tcpi.tcpi_snd_mss,
-             tcpi.tcpi_rcv_mss,
-             tcpi.tcpi_lost,    // Lost packets
-             tcpi.tcpi_retrans, // Retransmitted packets out
-             tcpi.tcpi_rtt,     // Smoothed round trip time in usec
-             tcpi.tcpi_rttvar,  // Medium deviation
-             tcpi.tcpi_snd_ssthresh,
-             tcpi.tcpi_snd_cwnd,
-             tcpi.tcpi_total_retrans); // Total retransmits for entire connection
-  }
-  return ok;
+  return sockets::getTcpInfoString(sockfd_, buf, len);
 }
 
 void Socket::bindAddress(const InetAddress &addr)
@@ -86,10 +62,7 @@ void Socket::shutdownWrite()
 
 void Socket::setTcpNoDelay(bool on)
 {
-  int optval = on ? 1 : 0;
-  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY,
-               &optval, static_cast<socklen_t>(sizeof optval));
-  // FIXME CHECK
+  sockets::setTcpNoDelay(sockfd_, on);
 }
 
 // 端口复用
@@ -121,8 +94,14 @@ void Socket::setReusePort(bool on)
 
 void Socket::setKeepAlive(bool on)
 {
-  int optval = on ? 1 : 0;
-  ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE,
-               &optval, static_cast<socklen_t>(sizeof optval));
-  // FIXME CHECK
+  sockets::setKeepAlive(sockfd_, on);
+}
+
+void Socket::setDeferAccept(int seconds)
+{
+  if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                   &seconds, static_cast<socklen_t>(sizeof seconds)) < 0)
+  {
+    LOG_SYSERR << "TCP_DEFER_ACCEPT failed.";
+  }
 }
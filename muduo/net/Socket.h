@@ -81,6 +81,12 @@ namespace muduo
       ///
       void setKeepAlive(bool on);
 
+      ///
+      /// TCP_DEFER_ACCEPT, wakes up accept only when data arrives,
+      /// or after about @c seconds, 0 to disable.
+      ///
+      void setDeferAccept(int seconds);
+
     private:
       const int sockfd_;
     };
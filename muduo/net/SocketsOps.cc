@@ -12,9 +12,15 @@
 #include "muduo/base/Types.h"
 #include "muduo/net/Endian.h"
 
+#include <algorithm>
+
 #include <errno.h>
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdio.h> // snprintf
+#include <string.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h> // readv
 #include <unistd.h>
@@ -27,6 +33,14 @@ namespace
 
   typedef struct sockaddr SA;
 
+  sockets::Hooks *g_hooks = NULL;
+
+  // the hooks if they own sockfd
+  inline sockets::Hooks *hooked(int sockfd)
+  {
+    return g_hooks && g_hooks->owns(sockfd) ? g_hooks : NULL;
+  }
+
 #if VALGRIND || defined(NO_ACCEPT4)
   void setNonBlockAndCloseOnExec(int sockfd)
   {
@@ -73,8 +87,22 @@ const struct sockaddr_in6 *sockets::sockaddr_in6_cast(const struct sockaddr *add
   return static_cast<const struct sockaddr_in6 *>(implicit_cast<const void *>(addr));
 }
 
+void sockets::setHooks(Hooks *hooks)
+{
+  g_hooks = hooks;
+}
+
 int sockets::createNonblockingOrDie(sa_family_t family)
 {
+  if (g_hooks)
+  {
+    int sockfd = g_hooks->socket(family);
+    if (sockfd < 0)
+    {
+      LOG_SYSFATAL << "sockets::createNonblockingOrDie";
+    }
+    return sockfd;
+  }
   // valgrind既可以检测内存泄漏，又可以检测文件描述符状态
 #if VALGRIND
   int sockfd = ::socket(family, SOCK_STREAM, IPPROTO_TCP);
@@ -96,7 +124,9 @@ int sockets::createNonblockingOrDie(sa_family_t family)
 
 void sockets::bindOrDie(int sockfd, const struct sockaddr *addr)
 {
-  int ret = ::bind(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
+  Hooks *hooks = hooked(sockfd);
+  int ret = hooks ? hooks->bind(sockfd, addr)
+                  : ::bind(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
   if (ret < 0)
   {
     LOG_SYSFATAL << "sockets::bindOrDie";
@@ -105,7 +135,8 @@ void sockets::bindOrDie(int sockfd, const struct sockaddr *addr)
 
 void sockets::listenOrDie(int sockfd)
 {
-  int ret = ::listen(sockfd, SOMAXCONN);
+  Hooks *hooks = hooked(sockfd);
+  int ret = hooks ? hooks->listen(sockfd) : ::listen(sockfd, SOMAXCONN);
   if (ret < 0)
   {
     LOG_SYSFATAL << "sockets::listenOrDie";
@@ -115,17 +146,28 @@ void sockets::listenOrDie(int sockfd)
 int sockets::accept(int sockfd, struct sockaddr_in6 *addr)
 {
   socklen_t addrlen = static_cast<socklen_t>(sizeof *addr);
+  int connfd = -1;
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    connfd = hooks->accept(sockfd, addr);
+  }
+  else
+  {
 #if VALGRIND || defined(NO_ACCEPT4)
-  int connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
-  setNonBlockAndCloseOnExec(connfd);
+    connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
+    setNonBlockAndCloseOnExec(connfd);
 #else
-  int connfd = ::accept4(sockfd, sockaddr_cast(addr),
-                         &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    connfd = ::accept4(sockfd, sockaddr_cast(addr),
+                       &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 #endif
+  }
   if (connfd < 0)
   {
     int savedErrno = errno;
-    LOG_SYSERR << "Socket::accept";
+    if (savedErrno != EAGAIN) // ends a batch of accepts
+    {
+      LOG_SYSERR << "Socket::accept";
+    }
     switch (savedErrno)
     {
     case EAGAIN:
@@ -159,11 +201,22 @@ int sockets::accept(int sockfd, struct sockaddr_in6 *addr)
 
 int sockets::connect(int sockfd, const struct sockaddr *addr)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->connect(sockfd, addr);
+  }
   return ::connect(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
 }
 
 ssize_t sockets::read(int sockfd, void *buf, size_t count)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    struct iovec vec;
+    vec.iov_base = buf;
+    vec.iov_len = count;
+    return hooks->readv(sockfd, &vec, 1);
+  }
   return ::read(sockfd, buf, count);
 }
 
@@ -173,17 +226,48 @@ ssize_t sockets::read(int sockfd, void *buf, size_t count)
 */
 ssize_t sockets::readv(int sockfd, const struct iovec *iov, int iovcnt)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->readv(sockfd, iov, iovcnt);
+  }
   return ::readv(sockfd, iov, iovcnt);
 }
 
 ssize_t sockets::write(int sockfd, const void *buf, size_t count)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->write(sockfd, buf, count);
+  }
   return ::write(sockfd, buf, count);
 }
 
+// 由内核把文件内容直接拷贝到socket，省去用户态的两次拷贝
+ssize_t sockets::sendfile(int sockfd, int fd, off_t *offset, size_t count)
+{
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    // no page cache to splice from, a copy through user space
+    char buf[64 * 1024];
+    ssize_t n = ::pread(fd, buf, std::min(count, sizeof buf), *offset);
+    if (n <= 0)
+    {
+      return n;
+    }
+    ssize_t nw = hooks->write(sockfd, buf, static_cast<size_t>(n));
+    if (nw > 0)
+    {
+      *offset += nw;
+    }
+    return nw;
+  }
+  return ::sendfile(sockfd, fd, offset, count);
+}
+
 void sockets::close(int sockfd)
 {
-  if (::close(sockfd) < 0)
+  Hooks *hooks = hooked(sockfd);
+  if ((hooks ? hooks->close(sockfd) : ::close(sockfd)) < 0)
   {
     LOG_SYSERR << "sockets::close";
   }
@@ -192,12 +276,115 @@ void sockets::close(int sockfd)
 // 只关闭写端
 void sockets::shutdownWrite(int sockfd)
 {
-  if (::shutdown(sockfd, SHUT_WR) < 0)
+  Hooks *hooks = hooked(sockfd);
+  if ((hooks ? hooks->shutdownWrite(sockfd) : ::shutdown(sockfd, SHUT_WR)) < 0)
   {
     LOG_SYSERR << "sockets::shutdownWrite";
   }
 }
 
+void sockets::setTcpNoDelay(int sockfd, bool on)
+{
+  int optval = on ? 1 : 0;
+  ::setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY,
+               &optval, static_cast<socklen_t>(sizeof optval));
+  // FIXME CHECK
+}
+
+void sockets::setTcpCork(int sockfd, bool on)
+{
+  int optval = on ? 1 : 0;
+  if (::setsockopt(sockfd, IPPROTO_TCP, TCP_CORK,
+                   &optval, static_cast<socklen_t>(sizeof optval)) < 0)
+  {
+    LOG_SYSERR << "sockets::setTcpCork";
+  }
+}
+
+void sockets::setKeepAlive(int sockfd, bool on)
+{
+  int optval = on ? 1 : 0;
+  ::setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE,
+               &optval, static_cast<socklen_t>(sizeof optval));
+  // FIXME CHECK
+}
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69 // Linux 5.11
+#endif
+
+bool sockets::setBusyPoll(int sockfd, int microseconds)
+{
+  int optval = microseconds;
+  bool ok = ::setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL,
+                         &optval, static_cast<socklen_t>(sizeof optval)) == 0;
+  optval = microseconds > 0 ? 1 : 0;
+  // fails on older kernels, harmless
+  ::setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+               &optval, static_cast<socklen_t>(sizeof optval));
+  return ok;
+}
+
+int sockets::getIncomingCpu(int sockfd)
+{
+  int cpu = -1;
+  socklen_t len = static_cast<socklen_t>(sizeof cpu);
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+  {
+    return -1;
+  }
+  return cpu;
+}
+
+bool sockets::getTcpInfo(int sockfd, struct tcp_info *tcpi, TcpInfoExt *ext)
+{
+  // linux/tcp.h, tcpi_pacing_rate follows tcpi_total_retrans
+  const size_t kExtOffset = 104;
+  char info[kExtOffset + sizeof(TcpInfoExt)];
+  socklen_t len = sizeof info;
+  memZero(info, len);
+  if (::getsockopt(sockfd, SOL_TCP, TCP_INFO, info, &len) != 0)
+  {
+    return false;
+  }
+  memcpy(tcpi, info, std::min(sizeof(*tcpi), sizeof info));
+  memcpy(ext, info + kExtOffset, sizeof(*ext));
+  return true;
+}
+
+bool sockets::getTcpInfo(int sockfd, struct tcp_info *tcpi)
+{
+  socklen_t len = sizeof(*tcpi);
+  memZero(tcpi, len);
+  return ::getsockopt(sockfd, SOL_TCP, TCP_INFO, tcpi, &len) == 0;
+}
+
+bool sockets::getTcpInfoString(int sockfd, char *buf, int len)
+{
+  struct tcp_info tcpi;
+  bool ok = getTcpInfo(sockfd, &tcpi);
+  if (ok)
+  {
+    snprintf(buf, len, "unrecovered=%u "
+                       "rto=%u ato=%u snd_mss=%u rcv_mss=%u "
+                       "lost=%u retrans=%u rtt=%u rttvar=%u "
+                       "sshthresh=%u cwnd=%u total_retrans=%u",
+             tcpi.tcpi_retransmits, // Number of unrecovered [RTO] timeouts
+             tcpi.tcpi_rto,         // Retransmit timeout in usec
+             tcpi.tcpi_ato,         // Predicted tick of soft clock in usec
+             tcpi.tcpi_snd_mss,
+             tcpi.tcpi_rcv_mss,
+             tcpi.tcpi_lost,    // Lost packets
+             tcpi.tcpi_retrans, // Retransmitted packets out
+             tcpi.tcpi_rtt,     // Smoothed round trip time in usec
+             tcpi.tcpi_rttvar,  // Medium deviation
+             tcpi.tcpi_snd_ssthresh,
+             tcpi.tcpi_snd_cwnd,
+             tcpi.tcpi_total_retrans); // Total retransmits for entire connection
+  }
+  return ok;
+}
+
 void sockets::toIpPort(char *buf, size_t size, const struct sockaddr *addr)
 {
   if (addr->sa_family == AF_INET6)
@@ -258,6 +445,10 @@ void sockets::fromIpPort(const char *ip, uint16_t port, struct sockaddr_in6 *add
 
 int sockets::getSocketError(int sockfd)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->getSocketError(sockfd);
+  }
   int optval;
   socklen_t optlen = static_cast<socklen_t>(sizeof optval);
 
@@ -273,6 +464,10 @@ int sockets::getSocketError(int sockfd)
 
 struct sockaddr_in6 sockets::getLocalAddr(int sockfd)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->getLocalAddr(sockfd);
+  }
   struct sockaddr_in6 localaddr;
   memZero(&localaddr, sizeof localaddr);
   socklen_t addrlen = static_cast<socklen_t>(sizeof localaddr);
@@ -285,6 +480,10 @@ struct sockaddr_in6 sockets::getLocalAddr(int sockfd)
 
 struct sockaddr_in6 sockets::getPeerAddr(int sockfd)
 {
+  if (Hooks *hooks = hooked(sockfd))
+  {
+    return hooks->getPeerAddr(sockfd);
+  }
   struct sockaddr_in6 peeraddr;
   memZero(&peeraddr, sizeof peeraddr);
   socklen_t addrlen = static_cast<socklen_t>(sizeof peeraddr);
@@ -13,6 +13,9 @@
 
 #include <arpa/inet.h>
 
+// struct tcp_info is in <netinet/tcp.h>
+struct tcp_info;
+
 namespace muduo
 {
     namespace net
@@ -32,8 +35,37 @@ namespace muduo
             ssize_t read(int sockfd, void *buf, size_t count);
             ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
             ssize_t write(int sockfd, const void *buf, size_t count);
+            /// sendfile(2), *offset is advanced by bytes sent.
+            ssize_t sendfile(int sockfd, int fd, off_t *offset, size_t count);
             void close(int sockfd);
             void shutdownWrite(int sockfd);
+            void setTcpNoDelay(int sockfd, bool on);
+            void setKeepAlive(int sockfd, bool on);
+            void setTcpCork(int sockfd, bool on);
+            /// SO_BUSY_POLL and SO_PREFER_BUSY_POLL, raising it may need CAP_NET_ADMIN.
+            bool setBusyPoll(int sockfd, int microseconds);
+            /// SO_INCOMING_CPU, the CPU that handled the packets of sockfd, -1 if unknown.
+            int getIncomingCpu(int sockfd);
+            /// TCP_INFO beyond struct tcp_info of glibc, zero where the kernel is older.
+            struct TcpInfoExt
+            {
+              uint64_t pacingRate;
+              uint64_t maxPacingRate;
+              uint64_t bytesAcked;
+              uint64_t bytesReceived;
+              uint32_t segsOut;
+              uint32_t segsIn;
+              uint32_t notsentBytes;
+              uint32_t minRtt;
+              uint32_t dataSegsIn;
+              uint32_t dataSegsOut;
+              uint64_t deliveryRate;
+            };
+            // return true if success.
+            bool getTcpInfo(int sockfd, struct tcp_info *tcpi, TcpInfoExt *ext);
+            // return true if success.
+            bool getTcpInfo(int sockfd, struct tcp_info *tcpi);
+            bool getTcpInfoString(int sockfd, char *buf, int len);
 
             void toIpPort(char *buf, size_t size, const struct sockaddr *addr);
             void toIp(char *buf, size_t size, const struct sockaddr *addr);
@@ -53,6 +85,36 @@ namespace muduo
             struct sockaddr_in6 getPeerAddr(int sockfd);
             bool isSelfConnect(int sockfd);
 
+            ///
+            /// Stands in for the kernel's TCP, eg. SimNetwork.
+            /// createNonblockingOrDie() makes its sockets, calls above on
+            /// fds it owns() go to it instead of the syscalls, other fds
+            /// (eventfd, files, unix sockets) are untouched.
+            ///
+            class Hooks
+            {
+            public:
+              virtual ~Hooks() = default;
+
+              virtual bool owns(int sockfd) const = 0;
+              virtual int socket(sa_family_t family) = 0;
+              // these return -1 and set errno on errors, as the syscalls
+              virtual int connect(int sockfd, const struct sockaddr *addr) = 0;
+              virtual int bind(int sockfd, const struct sockaddr *addr) = 0;
+              virtual int listen(int sockfd) = 0;
+              virtual int accept(int sockfd, struct sockaddr_in6 *addr) = 0;
+              virtual ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt) = 0;
+              virtual ssize_t write(int sockfd, const void *buf, size_t count) = 0;
+              virtual int close(int sockfd) = 0;
+              virtual int shutdownWrite(int sockfd) = 0;
+              virtual int getSocketError(int sockfd) = 0;
+              virtual struct sockaddr_in6 getLocalAddr(int sockfd) = 0;
+              virtual struct sockaddr_in6 getPeerAddr(int sockfd) = 0;
+            };
+
+            /// NULL uninstalls. Not thread safe, set it before creating sockets.
+            void setHooks(Hooks *hooks);
+
         } // namespace sockets
     }     // namespace net
 } // namespace muduo
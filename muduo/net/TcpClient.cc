@@ -13,6 +13,7 @@
 #include "muduo/net/Connector.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/SocketsOps.h"
+#include "muduo/net/TlsContext.h"
 
 #include <stdio.h> // snprintf
 
@@ -139,6 +140,18 @@ void TcpClient::newConnection(int sockfd)
   ++nextConnId_;
   string connName = name_ + buf;
 
+  std::unique_ptr<TlsEngine> tlsEngine;
+  if (tlsContext_)
+  {
+    tlsEngine = tlsContext_->newEngine(sockfd, false);
+    if (!tlsEngine)
+    {
+      LOG_ERROR << "TcpClient::newConnection[" << name_
+                << "] - failed to create TLS engine for " << connName;
+      sockets::close(sockfd);
+      return;
+    }
+  }
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
   // FIXME use make_shared if necessary
@@ -152,7 +165,11 @@ void TcpClient::newConnection(int sockfd)
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
   conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
-  
+  if (tlsEngine)
+  {
+    conn->setTlsEngine(std::move(tlsEngine));
+  }
+
   {
     MutexLockGuard lock(mutex_);
     connection_ = conn; // 保存TcpConnection
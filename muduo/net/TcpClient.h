@@ -72,6 +72,14 @@ namespace muduo
         writeCompleteCallback_ = std::move(cb);
       }
 
+      /// Starts TLS on new connections, see muduo/net/tls/SslContext.h
+      /// The connection callback is called after the handshake.
+      /// Not thread safe.
+      void setTlsContext(const TlsContextPtr &ctx)
+      {
+        tlsContext_ = ctx;
+      }
+
     private:
       /// Not thread safe, but in loop
       void newConnection(int sockfd);
@@ -84,6 +92,7 @@ namespace muduo
       ConnectionCallback connectionCallback_;   // 连接建立回调
       MessageCallback messageCallback_;         // 消息到来回调
       WriteCompleteCallback writeCompleteCallback_; // 数据发送完毕回调
+      TlsContextPtr tlsContext_;
       bool retry_;   // atomic  重连，是指连接建立之后又意外断开的时候是否重连
       bool connect_; // atomic
       // always in loop thread
@@ -12,10 +12,20 @@
 #include "muduo/base/WeakCallback.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/EventLoop.h"
-#include "muduo/net/Socket.h"
+#include "muduo/net/Relay.h"
 #include "muduo/net/SocketsOps.h"
+#include "muduo/net/TlsContext.h"
+#include "muduo/net/TransportStats.h"
+
+#include <algorithm>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -40,45 +50,160 @@ TcpConnection::TcpConnection(EventLoop *loop,
                              int sockfd,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
+    : TcpConnection(loop, 0, std::shared_ptr<const string>(), sockfd, localAddr, peerAddr)
+{
+  name_ = nameArg;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                             int64_t id,
+                             const std::shared_ptr<const string> &namePrefix,
+                             int sockfd,
+                             const InetAddress &localAddr,
+                             const InetAddress &peerAddr,
+                             bool compact)
     : loop_(CHECK_NOTNULL(loop)),
-      name_(nameArg),
+      id_(id),
       state_(kConnecting),
+      readPauses_(0),
       reading_(true),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      tlsHandshaking_(false),
+      throttling_(false),
+      compact_(compact),
+      timeMessageCallback_(false),
+      coalesceWrites_(false),
+      flushQueued_(false),
+      namePrefix_(namePrefix),
+      channel_(loop, sockfd),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)
+      highWaterMark_(64 * 1024 * 1024),
+      lowWaterMark_(0),
+      inputBuffer_(compact ? 0 : Buffer::kInitialSize),
+      outputBuffer_(compact ? 0 : Buffer::kInitialSize),
+      spillThreshold_(0),
+      spoolFd_(-1),
+      spoolEnd_(0),
+      spoolRegions_(0)
 {
-  channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, _1));
-  channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-  channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-  channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
-  LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at " << this << " fd=" << sockfd;
-  socket_->setKeepAlive(true);
+  channel_.setReadCallback(std::bind(&TcpConnection::handleRead, this, _1));
+  channel_.setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
+  channel_.setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+  channel_.setErrorCallback(std::bind(&TcpConnection::handleError, this));
+  LOG_DEBUG << "TcpConnection::ctor[#" << id_ << "] at " << this << " fd=" << sockfd;
+  sockets::setKeepAlive(sockfd, true);
 }
 
 TcpConnection::~TcpConnection()
 {
-  LOG_DEBUG << "TcpConnection::dtor[" << name_ << "] at " << this
-            << " fd=" << channel_->fd()
+  LOG_DEBUG << "TcpConnection::dtor[" << name() << "] at " << this
+            << " fd=" << channel_.fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
+  sockets::close(channel_.fd());
+  if (spoolFd_ >= 0)
+  {
+    ::close(spoolFd_);
+  }
+}
+
+TcpConnection::Callbacks *TcpConnection::mutableCallbacks()
+{
+  // copy on write, the table may be shared with TcpServer and other connections
+  if (!callbacks_)
+  {
+    callbacks_ = std::make_shared<Callbacks>();
+  }
+  else if (callbacks_.use_count() > 1)
+  {
+    callbacks_ = std::make_shared<Callbacks>(*callbacks_);
+  }
+  return get_pointer(callbacks_);
+}
+
+// a compact connection keeps no buffer memory while idle
+void TcpConnection::releaseIfEmpty(Buffer *buf)
+{
+  if (compact_ && buf->readableBytes() == 0 && buf->internalCapacity() > Buffer::kCheapPrepend)
+  {
+    Buffer empty(0);
+    buf->swap(empty);
+  }
+}
+
+// Formatting the name of every accepted connection is wasted if nobody asks,
+// eg. with INFO logging off.
+const string &TcpConnection::name() const
+{
+  if (namePrefix_)
+  {
+    std::call_once(nameOnce_, [this] {
+      char buf[32];
+      snprintf(buf, sizeof buf, "#%" PRId64, id_);
+      name_ = *namePrefix_ + buf;
+    });
+  }
+  return name_;
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info *tcpi) const
 {
-  return socket_->getTcpInfo(tcpi);
+  return sockets::getTcpInfo(channel_.fd(), tcpi);
+}
+
+bool TcpConnection::sampleTransport(TransportSample *sample) const
+{
+  struct tcp_info tcpi;
+  sockets::TcpInfoExt ext;
+  if (!sockets::getTcpInfo(channel_.fd(), &tcpi, &ext))
+  {
+    return false;
+  }
+  sample->connId = id_;
+  sample->name = name();
+  sample->rtt = tcpi.tcpi_rtt;
+  sample->rttVar = tcpi.tcpi_rttvar;
+  sample->cwnd = tcpi.tcpi_snd_cwnd;
+  sample->unacked = tcpi.tcpi_unacked;
+  sample->totalRetrans = tcpi.tcpi_total_retrans;
+  sample->deliveryRate = ext.deliveryRate;
+  sample->notsentBytes = ext.notsentBytes;
+  sample->outputBytes = bufferedBytes();
+  return true;
 }
 
 string TcpConnection::getTcpInfoString() const
 {
   char buf[1024];
   buf[0] = '\0';
-  socket_->getTcpInfoString(buf, sizeof buf);
+  sockets::getTcpInfoString(channel_.fd(), buf, sizeof buf);
   return buf;
 }
 
+bool TcpConnection::isKernelTls() const
+{
+  return tls_ && !tlsHandshaking_ && tls_->kernelSend();
+}
+
+void TcpConnection::setTlsEngine(std::unique_ptr<TlsEngine> engine)
+{
+  assert(state_ == kConnecting);
+  tls_ = std::move(engine);
+}
+
+ssize_t TcpConnection::writeSome(const void *data, size_t len)
+{
+  // with kTLS, the kernel frames and encrypts what we write(2).
+  ssize_t n = tls_ && !tls_->kernelSend() ? tls_->write(data, len)
+                                          : sockets::write(channel_.fd(), data, len);
+  ++traffic_.writes;
+  if (n > 0)
+  {
+    traffic_.bytesOut += n;
+  }
+  return n;
+}
+
 void TcpConnection::send(const void *data, int len)
 {
   send(StringPiece(static_cast<const char *>(data), len));
@@ -144,18 +269,21 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     LOG_WARN << "disconnected, give up writing";
     return;
   }
+  ++traffic_.messagesOut;
   // if no thing in output queue, try writing directly
   // 通道没有关注可写事件并且发送缓冲区没有数据，直接write
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  // TLS握手期间，数据先放入output buffer，握手完成后再发送
+  if (!coalesceWrites_ && !channel_.isWriting() && outputBuffer_.readableBytes() == 0 && pendingFiles_.empty() && !tlsHandshaking_)
   {
-    nwrote = sockets::write(channel_->fd(), data, len);
+    nwrote = writeSome(data, len);
     if (nwrote >= 0)
     {
+      lastActive_ = loop_->pollReturnTime();
       remaining = len - nwrote;
-      // 写完了，回调writeCompleteCallback_
-      if (remaining == 0 && writeCompleteCallback_)
+      // 写完了，回调writeComplete
+      if (remaining == 0 && callbacks_->writeComplete)
       {
-        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        loop_->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
       }
     }
     else // nwrote < 0 出错了
@@ -176,18 +304,296 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
   // 没有错误，并且还有未写完的数据(说明内核发送缓冲区满，要将未写完的数据添加到output buffer中)
   if (!faultError && remaining > 0)
   {
-    size_t oldLen = outputBuffer_.readableBytes();
-    // 如果超过highWaterMark_, 回调highWaterMarkCallback_
-    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+    size_t oldLen = bufferedBytes();
+    // 如果超过highWaterMark_, 回调highWaterMark
+    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && callbacks_->highWaterMark)
+    {
+      loop_->queueInLoop(std::bind(callbacks_->highWaterMark, shared_from_this(), oldLen + remaining));
+    }
+    if (spillThreshold_ == 0 || oldLen + remaining <= spillThreshold_ ||
+        !spill(static_cast<const char *>(data) + nwrote, remaining))
+    {
+      tailBuffer()->append(static_cast<const char *>(data) + nwrote, remaining);
+    }
+    traffic_.outputHighWater = std::max(traffic_.outputHighWater, oldLen + remaining);
+    if (!throttling_ && !throttledSources_.empty() && oldLen + remaining >= highWaterMark_)
+    {
+      pauseSources();
+    }
+    if (coalesceWrites_ && !channel_.isWriting() && pendingFiles_.empty() && !tlsHandshaking_)
+    {
+      // written at the end of this iteration, together with later sends
+      if (!flushQueued_)
+      {
+        flushQueued_ = true;
+        loop_->runAtIterationEnd(std::bind(&TcpConnection::flushCoalesced, shared_from_this()));
+      }
+    }
+    else if (!channel_.isWriting())
+    {
+      channel_.enableWriting();  // 关注POLLOUT事件
+    }
+  }
+}
+
+void TcpConnection::flushCoalesced()
+{
+  loop_->assertInLoopThread();
+  flushQueued_ = false;
+  // handleWrite() takes over once POLLOUT is on
+  if (state_ == kDisconnected || channel_.isWriting() || outputBuffer_.readableBytes() == 0)
+  {
+    return;
+  }
+  ssize_t n = writeSome(outputBuffer_.peek(), outputBuffer_.readableBytes());
+  if (n < 0)
+  {
+    if (errno != EWOULDBLOCK)
+    {
+      // as in handleWrite(), the connection closes on POLLHUP or the next read
+      LOG_SYSERR << "TcpConnection::flushCoalesced";
+      return;
+    }
+    n = 0;
+  }
+  lastActive_ = loop_->pollReturnTime();
+  outputBuffer_.retrieve(n);
+  if (throttling_ && bufferedBytes() <= lowWaterMark_)
+  {
+    resumeSources();
+  }
+  if (outputBuffer_.readableBytes() > 0)
+  {
+    channel_.enableWriting();
+    return;
+  }
+  // a relay waits for our earlier send()s, as in handleWrite()
+  if (relay_ && relay_->handleWrite(this))
+  {
+    return; // relay has more in its pipe, it turned POLLOUT on
+  }
+  releaseIfEmpty(&outputBuffer_);
+  if (callbacks_->writeComplete)
+  {
+    loop_->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
+  }
+  if (state_ == kDisconnecting)
+  {
+    shutdownInLoop();
+  }
+}
+
+size_t TcpConnection::bufferedBytes() const
+{
+  size_t n = outputBuffer_.readableBytes();
+  for (const FileRegion &region : pendingFiles_)
+  {
+    n += region.trailer.readableBytes();
+  }
+  return n;
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length, const SendFileCallback &cb)
+{
+  if (loop_->isInLoopThread())
+  {
+    sendFileInLoop(fd, offset, length, cb);
+  }
+  else
+  {
+    loop_->runInLoop(
+        std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, length, cb));
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length, const SendFileCallback &cb)
+{
+  loop_->assertInLoopThread();
+  if (state_ != kConnected)
+  {
+    LOG_WARN << "not connected, give up sending file";
+    if (cb)
     {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+      loop_->queueInLoop(std::bind(cb, shared_from_this(), false));
     }
-    outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
-    if (!channel_->isWriting())
+    return;
+  }
+  // nothing queued, try sending directly
+  if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0 && pendingFiles_.empty() && !tlsHandshaking_)
+  {
+    while (length > 0)
     {
-      channel_->enableWriting();  // 关注POLLOUT事件
+      ssize_t n = sendFileSome(fd, offset, length);
+      if (n < 0 && errno == EWOULDBLOCK)
+      {
+        break;
+      }
+      else if (n <= 0)
+      {
+        // queued, it would never be sent
+        if (n < 0)
+        {
+          LOG_SYSERR << "TcpConnection::sendFileInLoop fd " << fd;
+        }
+        else
+        {
+          LOG_ERROR << "TcpConnection::sendFileInLoop unexpected EOF of fd " << fd
+                    << " at offset " << offset;
+        }
+        if (cb)
+        {
+          loop_->queueInLoop(std::bind(cb, shared_from_this(), false));
+        }
+        return;
+      }
+      lastActive_ = loop_->pollReturnTime();
+      offset += n;
+      length -= n;
+    }
+    if (length == 0)
+    {
+      if (cb)
+      {
+        loop_->queueInLoop(std::bind(cb, shared_from_this(), true));
+      }
+      if (callbacks_->writeComplete)
+      {
+        loop_->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
+      }
+      return;
     }
   }
+  pendingFiles_.emplace_back(fd, offset, length, cb);
+  if (!channel_.isWriting() && !tlsHandshaking_)
+  {
+    channel_.enableWriting();
+  }
+}
+
+ssize_t TcpConnection::sendFileSome(int fd, off_t offset, size_t length)
+{
+  // 64KiB at most per call, so that one big file won't starve other connections
+  const size_t kMaxChunk = 64 * 1024;
+  size_t count = std::min(length, kMaxChunk);
+  if (!tls_ || tls_->kernelSend())
+  {
+    ssize_t n = sockets::sendfile(channel_.fd(), fd, &offset, count);
+    ++traffic_.writes;
+    if (n > 0)
+    {
+      traffic_.bytesOut += n;
+    }
+    return n;
+  }
+  // user space TLS has to see the plaintext, writeSome() counts it
+  if (!fileChunk_)
+  {
+    fileChunk_.reset(new char[kMaxChunk]);
+  }
+  ssize_t nread = ::pread(fd, fileChunk_.get(), count, offset);
+  if (nread <= 0)
+  {
+    return nread;
+  }
+  return writeSome(fileChunk_.get(), nread);
+}
+
+void TcpConnection::setSpill(size_t memoryBytes, const string &dir)
+{
+  loop_->assertInLoopThread();
+  spillThreshold_ = memoryBytes;
+  spillDir_ = dir;
+}
+
+size_t TcpConnection::spilledBytes() const
+{
+  size_t n = 0;
+  for (const FileRegion &region : pendingFiles_)
+  {
+    if (region.spool)
+    {
+      n += region.remaining;
+    }
+  }
+  return n;
+}
+
+bool TcpConnection::spill(const char *data, size_t len)
+{
+  if (spoolFd_ < 0)
+  {
+    spoolFd_ = ::open(spillDir_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (spoolFd_ < 0)
+    {
+      // no O_TMPFILE in this file system
+      string path = spillDir_ + "/muduo-spill-XXXXXX";
+      spoolFd_ = ::mkostemp(&path[0], O_CLOEXEC);
+      if (spoolFd_ >= 0)
+      {
+        ::unlink(path.c_str());
+      }
+    }
+    if (spoolFd_ < 0)
+    {
+      LOG_SYSERR << "TcpConnection::spill open " << spillDir_;
+      spillThreshold_ = 0; // don't try again
+      return false;
+    }
+  }
+  size_t written = 0;
+  while (written < len)
+  {
+    ssize_t n = ::pwrite(spoolFd_, data + written, len - written,
+                         spoolEnd_ + static_cast<off_t>(written));
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      // eg. ENOSPC, the bytes past spoolEnd_ are overwritten by the next spill
+      LOG_SYSERR << "TcpConnection::spill write";
+      return false;
+    }
+    written += n;
+  }
+  FileRegion *last = pendingFiles_.empty() ? NULL : &pendingFiles_.back();
+  if (last && last->spool && last->trailer.readableBytes() == 0)
+  {
+    assert(last->offset + static_cast<off_t>(last->remaining) == spoolEnd_);
+    last->remaining += len;
+  }
+  else
+  {
+    pendingFiles_.emplace_back(spoolFd_, spoolEnd_, len, SendFileCallback(), true);
+    ++spoolRegions_;
+  }
+  spoolEnd_ += static_cast<off_t>(len);
+  return true;
+}
+
+void TcpConnection::abortPendingFiles()
+{
+  std::list<FileRegion> files;
+  files.swap(pendingFiles_);
+  spoolRegions_ = 0;
+  for (const FileRegion &region : files)
+  {
+    if (region.callback)
+    {
+      region.callback(shared_from_this(), false);
+    }
+  }
+}
+
+void TcpConnection::detachRelay()
+{
+  if (relay_)
+  {
+    std::shared_ptr<Relay> relay;
+    relay.swap(relay_);
+    relay->handleClose(this);
+  }
 }
 
 // 不可跨线程调用
@@ -208,10 +614,15 @@ void TcpConnection::shutdownInLoop()
 {
   loop_->assertInLoopThread();
   // 如果此时正在发送数据，则要等output buffer中的数据都被发送完了再关闭
-  if (!channel_->isWriting()) // 如果不再关注POLLOUT事件了(说明数据都写完了)，则关闭写端
+  // TLS握手完成后会再次调用shutdownInLoop
+  if (!channel_.isWriting() && !tlsHandshaking_ && !flushQueued_) // 如果不再关注POLLOUT事件了(说明数据都写完了)，则关闭写端
   {
     // we are not writing
-    socket_->shutdownWrite();
+    if (tls_)
+    {
+      tls_->shutdown(); // send close_notify before FIN
+    }
+    sockets::shutdownWrite(channel_.fd());
   }
 }
 
@@ -228,10 +639,10 @@ void TcpConnection::shutdownInLoop()
 // void TcpConnection::shutdownAndForceCloseInLoop(double seconds)
 // {
 //   loop_->assertInLoopThread();
-//   if (!channel_->isWriting())
+//   if (!channel_.isWriting())
 //   {
 //     // we are not writing
-//     socket_->shutdownWrite();
+//     sockets::shutdownWrite(channel_.fd());
 //   }
 //   loop_->runAfter(
 //       seconds,
@@ -290,7 +701,23 @@ const char *TcpConnection::stateToString() const
 
 void TcpConnection::setTcpNoDelay(bool on)
 {
-  socket_->setTcpNoDelay(on);
+  sockets::setTcpNoDelay(channel_.fd(), on);
+}
+
+void TcpConnection::cork()
+{
+  loop_->assertInLoopThread();
+  sockets::setTcpCork(channel_.fd(), true);
+}
+
+void TcpConnection::uncork()
+{
+  loop_->assertInLoopThread();
+  if (flushQueued_)
+  {
+    flushCoalesced();
+  }
+  sockets::setTcpCork(channel_.fd(), false);
 }
 
 void TcpConnection::startRead()
@@ -301,9 +728,12 @@ void TcpConnection::startRead()
 void TcpConnection::startReadInLoop()
 {
   loop_->assertInLoopThread();
-  if (!reading_ || !channel_->isReading())
+  if (!reading_ || !channel_.isReading())
   {
-    channel_->enableReading();
+    if (readPauses_ == 0)
+    {
+      channel_.enableReading();
+    }
     reading_ = true;
   }
 }
@@ -316,55 +746,270 @@ void TcpConnection::stopRead()
 void TcpConnection::stopReadInLoop()
 {
   loop_->assertInLoopThread();
-  if (reading_ || channel_->isReading())
+  if (reading_ || channel_.isReading())
   {
-    channel_->disableReading();
+    channel_.disableReading();
     reading_ = false;
   }
 }
 
+void TcpConnection::throttle(const TcpConnectionPtr &source)
+{
+  loop_->runInLoop(std::bind(&TcpConnection::throttleInLoop, shared_from_this(),
+                             std::weak_ptr<TcpConnection>(source)));
+}
+
+void TcpConnection::unthrottle(const TcpConnectionPtr &source)
+{
+  loop_->runInLoop(std::bind(&TcpConnection::unthrottleInLoop, shared_from_this(),
+                             std::weak_ptr<TcpConnection>(source)));
+}
+
+void TcpConnection::throttleInLoop(const std::weak_ptr<TcpConnection> &source)
+{
+  loop_->assertInLoopThread();
+  throttledSources_.push_back(source);
+  if (throttling_)
+  {
+    TcpConnectionPtr src(source.lock());
+    if (src)
+    {
+      src->getLoop()->runInLoop(std::bind(&TcpConnection::pauseRead, src));
+    }
+  }
+  else if (bufferedBytes() >= highWaterMark_)
+  {
+    pauseSources();
+  }
+}
+
+void TcpConnection::unthrottleInLoop(const std::weak_ptr<TcpConnection> &source)
+{
+  loop_->assertInLoopThread();
+  for (size_t i = 0; i < throttledSources_.size(); ++i)
+  {
+    const std::weak_ptr<TcpConnection> &s = throttledSources_[i];
+    if (!s.owner_before(source) && !source.owner_before(s))
+    {
+      if (throttling_)
+      {
+        resumeSource(s);
+      }
+      throttledSources_.erase(throttledSources_.begin() + i);
+      break;
+    }
+  }
+}
+
+void TcpConnection::pauseSources()
+{
+  loop_->assertInLoopThread();
+  assert(!throttling_);
+  throttling_ = true;
+  LOG_TRACE << name() << " above high water mark, pause " << throttledSources_.size() << " sources";
+  std::vector<std::weak_ptr<TcpConnection>> alive;
+  for (const std::weak_ptr<TcpConnection> &source : throttledSources_)
+  {
+    TcpConnectionPtr src(source.lock());
+    if (src)
+    {
+      src->getLoop()->runInLoop(std::bind(&TcpConnection::pauseRead, src));
+      alive.push_back(source);
+    }
+  }
+  throttledSources_.swap(alive);
+}
+
+void TcpConnection::resumeSources()
+{
+  loop_->assertInLoopThread();
+  if (throttling_)
+  {
+    throttling_ = false;
+    LOG_TRACE << name() << " below low water mark, resume " << throttledSources_.size() << " sources";
+    for (const std::weak_ptr<TcpConnection> &source : throttledSources_)
+    {
+      resumeSource(source);
+    }
+  }
+}
+
+void TcpConnection::resumeSource(const std::weak_ptr<TcpConnection> &source)
+{
+  TcpConnectionPtr src(source.lock());
+  if (src)
+  {
+    src->getLoop()->runInLoop(std::bind(&TcpConnection::resumeRead, src));
+  }
+}
+
+void TcpConnection::pauseRead()
+{
+  loop_->assertInLoopThread();
+  ++readPauses_;
+  if (readPauses_ == 1 && state_ != kDisconnected && channel_.isReading())
+  {
+    channel_.disableReading();
+  }
+}
+
+void TcpConnection::resumeRead()
+{
+  loop_->assertInLoopThread();
+  assert(readPauses_ > 0);
+  --readPauses_;
+  if (readPauses_ == 0 && reading_ && state_ != kDisconnected && !channel_.isReading())
+  {
+    channel_.enableReading();
+  }
+}
+
 void TcpConnection::connectEstablished()
 {
   loop_->assertInLoopThread();
   assert(state_ == kConnecting);
+  assert(callbacks_);
   setState(kConnected);
-  channel_->tie(shared_from_this()); // shared_from_this() use_count == 3 ---> 临时对象销毁use_count又变成2
-  channel_->enableReading();
+  lastActive_ = Timestamp::now();
+  traffic_.since = lastActive_;
+  if (loop_->busyPollMicroseconds() > 0
+      && !sockets::setBusyPoll(channel_.fd(), loop_->busyPollMicroseconds()))
+  {
+    LOG_DEBUG << "TcpConnection::connectEstablished [" << name() << "] SO_BUSY_POLL failed, errno " << errno;
+  }
+  channel_.tie(shared_from_this()); // shared_from_this() use_count == 3 ---> 临时对象销毁use_count又变成2
+  channel_.enableReading();
+
+  if (tls_)
+  {
+    // the connection callback is called once the handshake is done
+    tlsHandshaking_ = true;
+    handleHandshake();
+  }
+  else
+  {
+    callbacks_->connection(shared_from_this()); // +1 -1 use_count == 2
+  }
+}
 
-  connectionCallback_(shared_from_this()); // +1 -1 use_count == 2
+void TcpConnection::handleHandshake()
+{
+  loop_->assertInLoopThread();
+  assert(tlsHandshaking_);
+  switch (tls_->handshake())
+  {
+  case TlsEngine::kHandshakeDone:
+    LOG_DEBUG << "TcpConnection::handleHandshake [" << name() << "] done"
+              << (tls_->kernelSend() ? ", kTLS" : "");
+    tlsHandshaking_ = false;
+    if (channel_.isWriting())
+    {
+      channel_.disableWriting();
+    }
+    callbacks_->connection(shared_from_this());
+    // flush what was sent during handshake
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+      if (outputBuffer_.readableBytes() > 0 || !pendingFiles_.empty())
+      {
+        channel_.enableWriting();
+      }
+      else if (state_ == kDisconnecting)
+      {
+        shutdownInLoop();
+      }
+    }
+    break;
+  case TlsEngine::kHandshakeWantRead:
+    if (channel_.isWriting())
+    {
+      channel_.disableWriting();
+    }
+    break;
+  case TlsEngine::kHandshakeWantWrite:
+    if (!channel_.isWriting())
+    {
+      channel_.enableWriting();
+    }
+    break;
+  case TlsEngine::kHandshakeFailed:
+    LOG_ERROR << "TcpConnection::handleHandshake [" << name() << "] failed";
+    handleClose();
+    break;
+  }
 }
 
 void TcpConnection::connectDestroyed()
 {
   loop_->assertInLoopThread();
-  if (state_ == kConnected)
+  // kDisconnecting: shutdown() but the peer hasn't closed yet, eg. TcpServer destructs
+  if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
-    connectionCallback_(shared_from_this());
+    if (!tlsHandshaking_)
+    {
+      callbacks_->connection(shared_from_this());
+    }
   }
-  channel_->remove();
+  abortPendingFiles();
+  detachRelay();
+  resumeSources();
+  channel_.remove();
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
   loop_->assertInLoopThread();
+  lastActive_ = receiveTime;
+  if (tlsHandshaking_)
+  {
+    handleHandshake();
+    return;
+  }
+  if (relay_ && relay_->handleRead(this))
+  {
+    return;
+  }
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  ssize_t n = tls_ ? tls_->read(&inputBuffer_, &savedErrno)
+                   : inputBuffer_.readFd(channel_.fd(), &savedErrno);
   if (n > 0)
   {
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    traffic_.bytesIn += n;
+    ++traffic_.messagesIn;
+    traffic_.inputHighWater = std::max(traffic_.inputHighWater, inputBuffer_.readableBytes());
+    if (timeMessageCallback_)
+    {
+      Timestamp start(Timestamp::now());
+      callbacks_->message(shared_from_this(), &inputBuffer_, receiveTime);
+      traffic_.callbackMicroseconds += Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+    }
+    else
+    {
+      callbacks_->message(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    releaseIfEmpty(&inputBuffer_);
   }
   else if (n == 0) // 对端关闭
   {
     handleClose();
   }
+  else if (tls_ && savedErrno == EWOULDBLOCK)
+  {
+    // a partial TLS record, or a non-application record
+  }
   else
   {
     errno = savedErrno;
     LOG_SYSERR << "TcpConnection::handleRead";
     handleError();
+    if (tls_)
+    {
+      // the TLS session is broken, can't continue.
+      handleClose();
+    }
   }
 }
 
@@ -372,59 +1017,148 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 void TcpConnection::handleWrite()
 {
   loop_->assertInLoopThread();
-  if (channel_->isWriting())
+  lastActive_ = loop_->pollReturnTime();
+  if (tlsHandshaking_)
   {
-    ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
-    if (n > 0)
+    handleHandshake();
+  }
+  else if (channel_.isWriting())
+  {
+    // 先发 outputBuffer_, 再发文件, 文件之后 send() 的数据在 trailer 中, 保持先后顺序
+    while (true)
     {
-      outputBuffer_.retrieve(n);  // readIndex 向前移动 n 字节长度
-      if (outputBuffer_.readableBytes() == 0) // 发送缓冲区的数据都被发送完了，则需要停止关注POLLOUT事件
+      if (outputBuffer_.readableBytes() > 0)
+      {
+        ssize_t n = writeSome(outputBuffer_.peek(), outputBuffer_.readableBytes());
+        if (n <= 0)
+        {
+          if (n < 0 && errno != EWOULDBLOCK)
+          {
+            LOG_SYSERR << "TcpConnection::handleWrite";
+          }
+          return;
+        }
+        outputBuffer_.retrieve(n); // readIndex 向前移动 n 字节长度
+        if (throttling_ && bufferedBytes() <= lowWaterMark_)
+        {
+          resumeSources();
+        }
+        if (outputBuffer_.readableBytes() > 0)
+        {
+          return; // socket 发送缓冲区满了, 等下一次可写事件
+        }
+      }
+      if (pendingFiles_.empty())
       {
-        channel_->disableWriting(); // 停止关注可写(POLLOUT)事件，以免出现Busy Loop
-        if (writeCompleteCallback_)
+        break;
+      }
+
+      FileRegion &region = pendingFiles_.front();
+      if (region.remaining > 0)
+      {
+        ssize_t n = sendFileSome(region.fd, region.offset, region.remaining);
+        if (n < 0 && errno == EWOULDBLOCK)
+        {
+          return;
+        }
+        else if (n <= 0)
+        {
+          // file can't be sent or is shorter than expected, give up this region
+          // rather than polling for POLLOUT on it forever
+          if (n < 0)
+          {
+            LOG_SYSERR << "TcpConnection::handleWrite sendfile fd " << region.fd;
+          }
+          else
+          {
+            LOG_ERROR << "TcpConnection::handleWrite unexpected EOF of fd " << region.fd
+                      << " at offset " << region.offset;
+          }
+          if (region.callback)
+          {
+            loop_->queueInLoop(std::bind(region.callback, shared_from_this(), false));
+          }
+          region.remaining = 0;
+          region.callback = SendFileCallback();
+          if (region.spool)
+          {
+            // spilled bytes are part of the stream, it can't go on without them
+            forceClose();
+          }
+        }
+        else
         {
-          // 应用层发送缓冲区被清空，就回调低水位回调 writeCompleteCallback_
-          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+          region.offset += n;
+          region.remaining -= n;
+          if (region.remaining > 0)
+          {
+            return;
+          }
         }
-        if (state_ == kDisconnecting) // 发送缓冲区被清空并且连接状态是kDisconnecting，要关闭连接
+      }
+      if (region.callback)
+      {
+        loop_->queueInLoop(std::bind(region.callback, shared_from_this(), true));
+      }
+      if (region.spool && --spoolRegions_ == 0)
+      {
+        // all sent, start the spill file over
+        if (::ftruncate(spoolFd_, 0) < 0)
         {
-          shutdownInLoop(); // 关闭写端，此时处于半连接状态
+          LOG_SYSERR << "TcpConnection::handleWrite ftruncate";
         }
+        spoolEnd_ = 0;
       }
+      outputBuffer_.swap(region.trailer);
+      pendingFiles_.pop_front();
     }
-    else
+
+    if (relay_ && relay_->handleWrite(this))
+    {
+      return; // relay has more in its pipe
+    }
+    // 发送缓冲区的数据都被发送完了，则需要停止关注POLLOUT事件
+    channel_.disableWriting(); // 停止关注可写(POLLOUT)事件，以免出现Busy Loop
+    releaseIfEmpty(&outputBuffer_);
+    if (callbacks_->writeComplete)
+    {
+      // 应用层发送缓冲区被清空，就回调低水位回调 writeComplete
+      loop_->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
+    }
+    if (state_ == kDisconnecting) // 发送缓冲区被清空并且连接状态是kDisconnecting，要关闭连接
     {
-      LOG_SYSERR << "TcpConnection::handleWrite";
-      // if (state_ == kDisconnecting)
-      // {
-      //   shutdownInLoop();
-      // }
+      shutdownInLoop(); // 关闭写端，此时处于半连接状态
     }
   }
   else
   {
-    LOG_TRACE << "Connection fd = " << channel_->fd() << " is down, no more writing";
+    LOG_TRACE << "Connection fd = " << channel_.fd() << " is down, no more writing";
   }
 }
 
 void TcpConnection::handleClose()
 {
   loop_->assertInLoopThread();
-  LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
+  LOG_TRACE << "fd = " << channel_.fd() << " state = " << stateToString();
   assert(state_ == kConnected || state_ == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
   setState(kDisconnected);
-  channel_->disableAll();
+  channel_.disableAll();
 
   // shared_from_this引用计数+1，构造guardThis引用计数+1，TcpServer::connections_中还有一个引用计数 use_count == 3
   TcpConnectionPtr guardThis(shared_from_this());   // shared_from_this调用结束，usecount-1，此时usecount == 2
-  connectionCallback_(guardThis);
+  detachRelay();
+  resumeSources(); // nothing more to send, don't leave them paused
+  if (!tlsHandshaking_)
+  {
+    callbacks_->connection(guardThis);
+  }
   // must be the last line
-  closeCallback_(guardThis); // call TcpServer::removeConnection
+  callbacks_->close(guardThis); // call TcpServer::removeConnection
 }
 
 void TcpConnection::handleError()
 {
-  int err = sockets::getSocketError(channel_->fd());
-  LOG_ERROR << "TcpConnection::handleError [" << name_ << "] - SO_ERROR = " << err << " " << strerror_tl(err);
+  int err = sockets::getSocketError(channel_.fd());
+  LOG_ERROR << "TcpConnection::handleError [" << name() << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
@@ -16,9 +16,13 @@
 #include "muduo/base/Types.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
+#include "muduo/net/Channel.h"
 #include "muduo/net/InetAddress.h"
 
+#include <list>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <boost/any.hpp>
 
@@ -36,9 +40,10 @@ namespace muduo
   namespace net
   {
 
-    class Channel;
     class EventLoop;
-    class Socket;
+    class Relay;
+    class TlsEngine;
+    struct TransportSample;
 
     ///
     /// TCP connection, for both client and server usage.
@@ -55,54 +60,155 @@ namespace muduo
                     int sockfd,
                     const InetAddress &localAddr,
                     const InetAddress &peerAddr);
+      /// Named "namePrefix#id", formatted on first call to name().
+      /// A compact connection starts with empty buffers and frees them
+      /// whenever they drain, for servers of many idle connections.
+      TcpConnection(EventLoop *loop,
+                    int64_t id,
+                    const std::shared_ptr<const string> &namePrefix,
+                    int sockfd,
+                    const InetAddress &localAddr,
+                    const InetAddress &peerAddr,
+                    bool compact = false);
       ~TcpConnection();
 
       EventLoop *getLoop() const { return loop_; }
-      const string &name() const { return name_; }
+      /// unique in its TcpServer, 0 if not accepted by a TcpServer.
+      int64_t id() const { return id_; }
+      const string &name() const;
       const InetAddress &localAddress() const { return localAddr_; }
       const InetAddress &peerAddress() const { return peerAddr_; }
       bool connected() const { return state_ == kConnected; }
       bool disconnected() const { return state_ == kDisconnected; }
+      bool isTls() const { return static_cast<bool>(tls_); }
+      // valid after connectionCallback, true if TLS records are encrypted by kernel.
+      bool isKernelTls() const;
       // return true if success.
       bool getTcpInfo(struct tcp_info *) const;
       string getTcpInfoString() const;
+      /// TCP_INFO and queued bytes, see TcpServer::setTransportSampling().
+      /// NOT thread safe, in loop
+      bool sampleTransport(TransportSample *sample) const;
 
       // void send(string&& message); // C++11
       void send(const void *message, int len);
       void send(const StringPiece &message);
       // void send(Buffer&& message); // C++11
       void send(Buffer *message); // this one will swap data
+      /// Sends [offset, offset+length) of file @c fd with sendfile(2),
+      /// in order with data sent before and after it.
+      /// @c fd must stay open until @c cb is called.
+      /// Thread safe.
+      void sendFile(int fd, off_t offset, size_t length,
+                    const SendFileCallback &cb = SendFileCallback());
       
       void shutdown();            // NOT thread safe, no simultaneous calling
       // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
       void forceClose();
       void forceCloseWithDelay(double seconds);
       void setTcpNoDelay(bool on);
+      /// Coalesces writes: send() in the loop appends to the output buffer,
+      /// which is written once at the end of the loop iteration, so ten
+      /// pipelined responses cost one write(2) instead of ten.
+      /// NOT thread safe, in loop
+      void setCoalesceWrites(bool on) { coalesceWrites_ = on; }
+      bool coalesceWrites() const { return coalesceWrites_; }
+      /// TCP_CORK: holds partial frames until uncork(), which flushes
+      /// coalesced writes first.
+      /// NOT thread safe, in loop
+      void cork();
+      void uncork();
+
+      /// Spills output beyond @c memoryBytes buffered in memory to an
+      /// unlinked temp file in @c dir, sent back with sendfile(2) as the
+      /// peer reads, so that slow consumers cost disk instead of memory.
+      /// 0 turns it off. highWaterMarkCallback sees memory only.
+      /// NOT thread safe, in loop
+      void setSpill(size_t memoryBytes, const string &dir = "/tmp");
+      /// Bytes waiting in the spill file.
+      /// NOT thread safe, in loop
+      size_t spilledBytes() const;
       
       // reading or not
       void startRead();
       void stopRead();
       bool isReading() const { return reading_; }; // NOT thread safe, may race with start/stopReadInLoop
+      /// Last readable or writable event, or direct write.
+      /// NOT thread safe, in loop
+      Timestamp lastActive() const { return lastActive_; }
+
+      /// Traffic of a connection, counted in its loop without atomics.
+      struct Traffic
+      {
+        Timestamp since;              // established
+        int64_t bytesIn = 0;
+        int64_t bytesOut = 0;         // written to the socket
+        int64_t messagesIn = 0;       // messageCallback calls
+        int64_t messagesOut = 0;      // send() calls
+        size_t inputHighWater = 0;    // most bytes seen in the input buffer
+        size_t outputHighWater = 0;   // most bytes waiting to be sent
+        int64_t callbackMicroseconds = 0; // in messageCallback, if timed
+        int64_t writes = 0;           // write(2) or sendfile(2) calls
+      };
+      /// NOT thread safe, in loop
+      const Traffic &traffic() const { return traffic_; }
+      /// Times messageCallback, at the cost of a clock read per call.
+      /// NOT thread safe, in loop
+      void setTimeMessageCallback(bool on) { timeMessageCallback_ = on; }
+
+      /// Flow control: stops reading on @c source while this connection has
+      /// more than highWaterMark bytes to send, resumes reading once it
+      /// drains to lowWaterMark. A source may be throttled by many
+      /// connections, eg. a publisher by its subscribers, it reads only when
+      /// none of them is above high water. @c source can be in another loop.
+      /// Thread safe.
+      void throttle(const TcpConnectionPtr &source);
+      void unthrottle(const TcpConnectionPtr &source);
 
       void setContext(const boost::any &context) { context_ = context; }
       const boost::any &getContext() const { return context_; }
       boost::any *getMutableContext() { return &context_; }
 
-      void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
-      void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
-      void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+      /// Callbacks of a connection, shared by all connections of a TcpServer,
+      /// setting one on a connection copies the table first.
+      struct Callbacks
+      {
+        ConnectionCallback connection;
+        MessageCallback message;
+        WriteCompleteCallback writeComplete;
+        HighWaterMarkCallback highWaterMark;
+        CloseCallback close;
+      };
+
+      void setConnectionCallback(const ConnectionCallback &cb) { mutableCallbacks()->connection = cb; }
+      void setMessageCallback(const MessageCallback &cb) { mutableCallbacks()->message = cb; }
+      void setWriteCompleteCallback(const WriteCompleteCallback &cb) { mutableCallbacks()->writeComplete = cb; }
       void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
       {
-        highWaterMarkCallback_ = cb;
+        mutableCallbacks()->highWaterMark = cb;
         highWaterMark_ = highWaterMark;
       }
+      // NOT thread safe, set them in connectionCallback.
+      void setHighWaterMark(size_t highWaterMark) { highWaterMark_ = highWaterMark; }
+      void setLowWaterMark(size_t lowWaterMark) { lowWaterMark_ = lowWaterMark; }
 
       /// Advanced interface
       Buffer *inputBuffer() { return &inputBuffer_; }
       Buffer *outputBuffer() { return &outputBuffer_; }
+      /// Bytes in memory waiting to be sent, excluding file regions.
+      /// NOT thread safe, in loop
+      size_t bufferedBytes() const;
+      /// Nothing waiting to be sent, in memory or in file regions.
+      /// NOT thread safe, in loop
+      bool outputEmpty() const { return outputBuffer_.readableBytes() == 0 && pendingFiles_.empty(); }
 
       /// Internal use only.
-      void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+      void setCloseCallback(const CloseCallback &cb) { mutableCallbacks()->close = cb; }
+      /// Internal use only, shares @c callbacks with other connections.
+      void setCallbacks(const std::shared_ptr<Callbacks> &callbacks) { callbacks_ = callbacks; }
+      /// Internal use only, must be called before connectEstablished().
+      /// The connectionCallback is delayed until the TLS handshake finishes.
+      void setTlsEngine(std::unique_ptr<TlsEngine> engine);
 
       // called when TcpServer accepts a new connection
       void connectEstablished(); // should be called only once
@@ -110,6 +216,8 @@ namespace muduo
       void connectDestroyed(); // should be called only once
 
     private:
+      friend class Relay;
+
       enum StateE
       {
         kDisconnected,
@@ -117,13 +225,32 @@ namespace muduo
         kConnected,
         kDisconnecting
       };
+      Callbacks *mutableCallbacks();
+      void releaseIfEmpty(Buffer *buf);
       void handleRead(Timestamp receiveTime);
       void handleWrite();
       void handleClose();
       void handleError();
+      void handleHandshake();
+      // write(2) or TLS write, errno is set on failure
+      ssize_t writeSome(const void *data, size_t len);
       // void sendInLoop(string&& message);
       void sendInLoop(const StringPiece &message);
       void sendInLoop(const void *message, size_t len);
+      void sendFileInLoop(int fd, off_t offset, size_t length, const SendFileCallback &cb);
+      // bytes of file sent, or -1 with errno set
+      ssize_t sendFileSome(int fd, off_t offset, size_t length);
+      void abortPendingFiles();
+      // writes coalesced in this iteration, see setCoalesceWrites()
+      void flushCoalesced();
+      // appends to the spill file, false if it can't
+      bool spill(const char *data, size_t len);
+      void detachRelay();
+      // where new data goes, outputBuffer_ or trailer of last file region
+      Buffer *tailBuffer()
+      {
+        return pendingFiles_.empty() ? &outputBuffer_ : &pendingFiles_.back().trailer;
+      }
       void shutdownInLoop();
       // void shutdownAndForceCloseInLoop(double seconds);
       void forceCloseInLoop();
@@ -131,19 +258,36 @@ namespace muduo
       const char *stateToString() const;
       void startReadInLoop();
       void stopReadInLoop();
+      void throttleInLoop(const std::weak_ptr<TcpConnection> &source);
+      void unthrottleInLoop(const std::weak_ptr<TcpConnection> &source);
+      // pause/resume reading on behalf of a throttling peer, in our loop
+      void pauseRead();
+      void resumeRead();
+      void pauseSources();
+      void resumeSources();
+      void resumeSource(const std::weak_ptr<TcpConnection> &source);
 
       EventLoop *loop_;
-      const string name_;
+      const int64_t id_;
+      Timestamp lastActive_;
       StateE state_; // FIXME: use atomic variable
+      int readPauses_; // by throttling peers, read only if reading_ && readPauses_ == 0
       bool reading_;
-      // we don't expose those classes to client.
-      std::unique_ptr<Socket> socket_;
-      std::unique_ptr<Channel> channel_;
+      bool tlsHandshaking_; // connectionCallback not called yet
+      bool throttling_;     // sources are paused by us
+      const bool compact_;  // free buffers once drained
+      bool timeMessageCallback_;
+      bool coalesceWrites_;
+      bool flushQueued_;    // flushCoalesced() runs at the end of this iteration
+      mutable std::once_flag nameOnce_;
+      std::shared_ptr<const string> namePrefix_; // null if named by ctor
+      mutable string name_;
+      Channel channel_; // its fd is the socket, closed by our dtor
       const InetAddress localAddr_;
       const InetAddress peerAddr_;
+      std::unique_ptr<TlsEngine> tls_;
+      std::unique_ptr<char[]> fileChunk_; // sendFile() plaintext for user space TLS, on first use
 
-      ConnectionCallback connectionCallback_;
-      MessageCallback messageCallback_;
       /*
         大流量场景：
         不断生成数据，然后发送conn->send();
@@ -156,12 +300,14 @@ namespace muduo
 
         数据发送完毕回调函数，即所有的用户数据都已拷贝到内核缓冲区时回调该函数
         outputbuffer被清空也会回调该函数，可以理解为低水位标回调函数
+        高水位标回调，超过高水位标时，为了防止内存被撑爆，可以断开连接
       */
-      WriteCompleteCallback writeCompleteCallback_;// 低水位标回调
-      HighWaterMarkCallback highWaterMarkCallback_;// 高水位标回调，超过高水位标时，为了防止内存被撑爆，可以断开连接
-      CloseCallback closeCallback_;
+      std::shared_ptr<Callbacks> callbacks_; // maybe shared, copy before changing
+      Traffic traffic_;
       
       size_t highWaterMark_;  // 高水位标
+      size_t lowWaterMark_;   // 低水位标, resume throttled sources
+      std::vector<std::weak_ptr<TcpConnection>> throttledSources_;
       Buffer inputBuffer_;    // 应用层接收缓冲区
       Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.  // 应用层发送缓冲区
       /*
@@ -170,9 +316,30 @@ namespace muduo
           boost::any: 任意类型的类型安全存储以及安全的取回
                       在标准库容器中存放不同类型的方法，比如说vector<boost::any>
       */
+      // A file region queued by sendFile(), data sent after it goes to trailer,
+      // trailer becomes outputBuffer_ once the region is sent.
+      struct FileRegion
+      {
+        FileRegion(int f, off_t off, size_t len, const SendFileCallback &cb, bool isSpool = false)
+            : fd(f), offset(off), remaining(len), callback(cb), spool(isSpool), trailer(0)
+        {
+        }
+
+        int fd;
+        off_t offset;
+        size_t remaining;
+        SendFileCallback callback;
+        bool spool; // part of the spill file
+        Buffer trailer;
+      };
+      std::list<FileRegion> pendingFiles_; // empty std::deque allocates
+      size_t spillThreshold_; // 0 if not spilling
+      string spillDir_;
+      int spoolFd_;           // spill file, -1 until the first spill
+      off_t spoolEnd_;
+      int spoolRegions_;      // in pendingFiles_, the file is truncated at 0
+      std::shared_ptr<Relay> relay_; // splicing to another connection, see Relay.h
       boost::any context_;  // 绑定一个未知类型的上下文对象
-      // FIXME: creationTime_, lastReceiveTime_
-      //        bytesReceived_, bytesSent_
     };
 
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -8,44 +8,150 @@
 
 #include "muduo/net/TcpServer.h"
 
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/Acceptor.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/SocketsOps.h"
+#include "muduo/net/TlsContext.h"
 
-#include <stdio.h> // snprintf
+#include <algorithm>
+#include <iterator>
 
 using namespace muduo;
 using namespace muduo::net;
 
+// Shared with the IO loop, its close callbacks, timers and queued functors
+// may outlive the server, they check server first.
+struct TcpServer::Registry
+{
+    Registry(TcpServer *owner, EventLoop *ioLoop)
+        : loop(ioLoop),
+          server(owner),
+          idleTimeout(owner->idleTimeout_),
+          sampleWorst(owner->sampleWorst_),
+          timeMessageCallbacks(owner->timeMessageCallbacks_)
+    {
+    }
+
+    EventLoop *loop;
+    MutexLock serverMutex;
+    TcpServer *server GUARDED_BY(serverMutex); // null once destructed
+    // settings, fixed at start()
+    const double idleTimeout;
+    const size_t sampleWorst;
+    const bool timeMessageCallbacks;
+    // shared by connections in loop, its close callback knows the registry
+    std::shared_ptr<TcpConnection::Callbacks> callbacks;
+    // accepted in this batch, in the acceptor loop
+    std::vector<TcpConnectionPtr> pending;
+    std::unordered_map<int64_t, TcpConnectionPtr> connections; // 连接列表, in loop
+
+    // Timing wheel of idle connections, a bucket per tick. A connection is
+    // in one bucket, by the deadline it had when put there, and is moved
+    // when that bucket expires, so activity only updates lastActive().
+    std::vector<std::vector<int64_t>> wheel;
+    std::vector<int64_t> expiring; // scratch, keeps its capacity
+    size_t cursor = 0;
+    TimerId wheelTimer;
+
+    // latest transport statistics, see setTransportSampling()
+    mutable MutexLock statsMutex;
+    TransportStats stats GUARDED_BY(statsMutex);
+    TimerId sampleTimer;
+
+    // in loop, of closed connections, see trafficSnapshot()
+    TcpConnection::Traffic closedTraffic;
+};
+
+namespace
+{
+    const int kWheelTicks = 8; // per idle timeout
+}
+
 TcpServer::TcpServer(EventLoop *loop,
                      const InetAddress &listenAddr,
                      const string &nameArg,
                      Option option)
-    : loop_(CHECK_NOTNULL(loop)),
-      ipPort_(listenAddr.toIpPort()),
+    : TcpServer(loop, new Acceptor(CHECK_NOTNULL(loop), listenAddr, option == kReusePort),
+                listenAddr.toIpPort(), nameArg)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop, int listenFd, const string &nameArg)
+    : TcpServer(loop, new Acceptor(CHECK_NOTNULL(loop), listenFd),
+                InetAddress(sockets::getLocalAddr(listenFd)).toIpPort(), nameArg)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+                     Acceptor *acceptor,
+                     const string &ipPort,
+                     const string &nameArg)
+    : loop_(loop),
+      ipPort_(ipPort),
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      acceptor_(acceptor),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
-      nextConnId_(1)
+      callbacksChanged_(true),
+      compactConnections_(false),
+      incomingCpuAffinity_(false),
+      nextConnId_(1),
+      nextRegistry_(0),
+      connNamePrefix_(std::make_shared<const string>(name_ + "-" + ipPort_)),
+      self_(std::make_shared<TcpServer *>(this)),
+      maxConnections_(0),
+      maxConnectionsPerIp_(0),
+      acceptRate_(0),
+      acceptBurst_(0),
+      acceptTokens_(0),
+      overloadThreshold_(0),
+      probeInterval_(0),
+      pauseReasons_(0),
+      numRejected_(0),
+      idleTimeout_(0),
+      sampleInterval_(0),
+      sampleWorst_(0),
+      timeMessageCallbacks_(false)
 {
     // _1对应的是socket文件描述符，_2对应的是对等方地址
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, _1, _2));
+    acceptor_->setBatchDoneCallback(std::bind(&TcpServer::newConnectionsDone, this));
 }
 
 TcpServer::~TcpServer()
 {
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+    loop_->cancel(refillTimer_);
+    loop_->cancel(probeTimer_);
+    loop_->cancel(drainTimer_);
 
-    for (auto &item : connections_)
+    // each IO loop destroys its own connections, without waiting for it,
+    // connections closing meanwhile find the registry without a server.
+    for (const auto &registry : registries_)
     {
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        {
+            MutexLockGuard lock(registry->serverMutex);
+            registry->server = NULL;
+        }
+        registry->loop->runInLoop(std::bind(&TcpServer::destroyConnections, registry));
+    }
+}
+
+void TcpServer::destroyConnections(const std::shared_ptr<Registry> &registry)
+{
+    registry->loop->assertInLoopThread();
+    registry->loop->cancel(registry->wheelTimer);
+    registry->loop->cancel(registry->sampleTimer);
+    std::unordered_map<int64_t, TcpConnectionPtr> connections;
+    connections.swap(registry->connections);
+    for (auto &item : connections)
+    {
+        item.second->connectDestroyed();
     }
 }
 
@@ -62,56 +168,624 @@ void TcpServer::start()
     if (started_.getAndSet(1) == 0)
     {
         threadPool_->start(threadInitCallback_);    // 先创建IO线程池
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            registries_.push_back(std::make_shared<Registry>(this, ioLoop));
+            const std::shared_ptr<Registry> &registry = registries_.back();
+            if (idleTimeout_ > 0)
+            {
+                ioLoop->runInLoop(std::bind(&TcpServer::startWheel, registry));
+            }
+            if (sampleInterval_ > 0)
+            {
+                registry->sampleTimer = ioLoop->runEvery(
+                    sampleInterval_, std::bind(&TcpServer::sampleTransport, registry));
+            }
+        }
 
         assert(!acceptor_->listening());
         loop_->runInLoop(std::bind(&Acceptor::listen, get_pointer(acceptor_))); // 再执行监听操作，避免io线程还没创建完，连接就到来了。
+        if (overloadThreshold_ > 0)
+        {
+            for (size_t i = 0; i < threadPool_->getAllLoops().size(); ++i)
+            {
+                probes_.push_back(std::make_shared<LoopProbe>());
+            }
+            probeTimer_ = loop_->runEvery(probeInterval_, std::bind(&TcpServer::probeLoops, this));
+        }
+    }
+}
+
+int TcpServer::listenFd() const
+{
+    return acceptor_->listenFd();
+}
+
+void TcpServer::stopAccepting()
+{
+    pauseAccepting(kStopped);
+}
+
+void TcpServer::drain(double seconds, const std::function<void()> &done)
+{
+    loop_->assertInLoopThread();
+    stopAccepting();
+    LOG_INFO << "TcpServer::drain [" << name_ << "] - " << numConnections()
+             << " connections, deadline " << seconds << "s";
+    drainedCallback_ = done;
+    draining_.getAndSet(1);
+    drainTimer_ = loop_->runAfter(seconds, std::bind(&TcpServer::forceCloseAll, this));
+    checkDrained();
+}
+
+void TcpServer::checkDrained()
+{
+    loop_->assertInLoopThread();
+    if (drainedCallback_ && numConnections_.get() == 0)
+    {
+        LOG_INFO << "TcpServer::checkDrained [" << name_ << "] - drained";
+        loop_->cancel(drainTimer_);
+        std::function<void()> done;
+        done.swap(drainedCallback_);
+        done();
+    }
+}
+
+void TcpServer::forceCloseAll()
+{
+    loop_->assertInLoopThread();
+    LOG_WARN << "TcpServer::forceCloseAll [" << name_ << "] - "
+             << numConnections() << " connections left at deadline";
+    for (const auto &registry : registries_)
+    {
+        registry->loop->runInLoop(std::bind(&TcpServer::forceCloseConnections, registry));
+    }
+}
+
+void TcpServer::forceCloseConnections(const std::shared_ptr<Registry> &registry)
+{
+    registry->loop->assertInLoopThread();
+    for (const auto &item : registry->connections)
+    {
+        item.second->forceClose(); // queued, doesn't touch connections now
+    }
+}
+
+void TcpServer::setIdleTimeout(double seconds)
+{
+    assert(!started_.get());
+    idleTimeout_ = seconds;
+}
+
+void TcpServer::startWheel(const std::shared_ptr<Registry> &registry)
+{
+    registry->loop->assertInLoopThread();
+    registry->wheel.resize(kWheelTicks + 2);
+    registry->wheelTimer = registry->loop->runEvery(
+        registry->idleTimeout / kWheelTicks, std::bind(&TcpServer::onWheelTick, registry));
+}
+
+void TcpServer::addToWheel(Registry *registry, int64_t connId, Timestamp deadline, Timestamp now)
+{
+    double tick = registry->idleTimeout / kWheelTicks;
+    // at least the next tick, never wraps around
+    int ticks = static_cast<int>(timeDifference(deadline, now) / tick) + 1;
+    ticks = std::min(std::max(ticks, 1), static_cast<int>(registry->wheel.size()) - 1);
+    registry->wheel[(registry->cursor + ticks) % registry->wheel.size()].push_back(connId);
+}
+
+void TcpServer::onWheelTick(const std::shared_ptr<Registry> &registry)
+{
+    registry->loop->assertInLoopThread();
+    int64_t numIdle = 0;
+    registry->cursor = (registry->cursor + 1) % registry->wheel.size();
+    registry->expiring.swap(registry->wheel[registry->cursor]);
+    Timestamp now(Timestamp::now());
+    for (int64_t connId : registry->expiring)
+    {
+        auto it = registry->connections.find(connId);
+        if (it == registry->connections.end())
+        {
+            continue; // closed meanwhile
+        }
+        const TcpConnectionPtr &conn = it->second;
+        Timestamp deadline = addTime(conn->lastActive(), registry->idleTimeout);
+        if (now < deadline)
+        {
+            addToWheel(get_pointer(registry), connId, deadline, now);
+        }
+        else
+        {
+            LOG_INFO << "TcpServer::onWheelTick [" << conn->name() << "] - idle, close";
+            ++numIdle;
+            conn->forceClose();
+        }
+    }
+    registry->expiring.clear();
+    if (numIdle > 0)
+    {
+        MutexLockGuard lock(registry->serverMutex);
+        if (registry->server)
+        {
+            registry->server->numIdleClosed_.addAndGet(numIdle);
+        }
+    }
+}
+
+void TcpServer::setTransportSampling(double interval, size_t worst)
+{
+    assert(!started_.get());
+    sampleInterval_ = interval;
+    sampleWorst_ = worst;
+}
+
+// getsockopt() per connection, off the hot path of reads and writes
+void TcpServer::sampleTransport(const std::shared_ptr<Registry> &registry)
+{
+    registry->loop->assertInLoopThread();
+    TransportStats stats;
+    stats.sampled = Timestamp::now();
+    stats.worst.reserve(registry->connections.size());
+    TransportSample sample;
+    for (const auto &item : registry->connections)
+    {
+        const TcpConnectionPtr &conn = item.second;
+        if (!conn->connected() || !conn->sampleTransport(&sample))
+        {
+            continue;
+        }
+        ++stats.connections;
+        stats.rtt.add(sample.rtt);
+        stats.cwnd.add(sample.cwnd);
+        stats.unacked.add(sample.unacked);
+        stats.totalRetrans.add(sample.totalRetrans);
+        stats.deliveryRate.add(sample.deliveryRate);
+        stats.outputBytes.add(sample.outputBytes);
+        stats.worst.push_back(sample);
+    }
+    stats.trimWorst(registry->sampleWorst);
+    MutexLockGuard lock(registry->statsMutex);
+    std::swap(registry->stats, stats);
+}
+
+TransportStats TcpServer::transportStats() const
+{
+    TransportStats stats;
+    for (const auto &registry : registries_)
+    {
+        MutexLockGuard lock(registry->statsMutex);
+        stats.merge(registry->stats);
+    }
+    stats.trimWorst(sampleWorst_);
+    return stats;
+}
+
+namespace
+{
+    void addTraffic(TcpConnection::Traffic *total, const TcpConnection::Traffic &traffic)
+    {
+        total->bytesIn += traffic.bytesIn;
+        total->bytesOut += traffic.bytesOut;
+        total->messagesIn += traffic.messagesIn;
+        total->messagesOut += traffic.messagesOut;
+        total->inputHighWater = std::max(total->inputHighWater, traffic.inputHighWater);
+        total->outputHighWater = std::max(total->outputHighWater, traffic.outputHighWater);
+        total->callbackMicroseconds += traffic.callbackMicroseconds;
+        total->writes += traffic.writes;
+    }
+}
+
+void TcpServer::collectTraffic(Registry *registry, TrafficSnapshot *snapshot, CountDownLatch *latch) const
+{
+    registry->loop->assertInLoopThread();
+    snapshot->total = registry->closedTraffic;
+    snapshot->connections.reserve(registry->connections.size());
+    for (const auto &item : registry->connections)
+    {
+        const TcpConnectionPtr &conn = item.second;
+        ConnectionTraffic traffic = { conn->id(), conn->traffic() };
+        addTraffic(&snapshot->total, traffic.traffic);
+        snapshot->connections.push_back(traffic);
+    }
+    if (latch)
+    {
+        latch->countDown();
+    }
+}
+
+TcpServer::TrafficSnapshot TcpServer::trafficSnapshot() const
+{
+    std::vector<TrafficSnapshot> parts(registries_.size());
+    CountDownLatch latch(static_cast<int>(registries_.size()));
+    for (size_t i = 0; i < registries_.size(); ++i)
+    {
+        Registry *registry = get_pointer(registries_[i]);
+        if (registry->loop->isInLoopThread())
+        {
+            collectTraffic(registry, &parts[i], &latch);
+        }
+        else
+        {
+            registry->loop->queueInLoop(
+                std::bind(&TcpServer::collectTraffic, this, registry, &parts[i], &latch));
+        }
+    }
+    latch.wait();
+
+    TrafficSnapshot snapshot;
+    snapshot.when = Timestamp::now();
+    for (TrafficSnapshot &part : parts)
+    {
+        addTraffic(&snapshot.total, part.total);
+        snapshot.connections.insert(snapshot.connections.end(),
+                                    std::make_move_iterator(part.connections.begin()),
+                                    std::make_move_iterator(part.connections.end()));
+    }
+    return snapshot;
+}
+
+void TcpServer::setAcceptBatch(int batch)
+{
+    assert(!started_.get());
+    acceptor_->setAcceptBatch(batch);
+}
+
+void TcpServer::setDeferAccept(int seconds)
+{
+    assert(!started_.get());
+    acceptor_->setDeferAccept(seconds);
+}
+
+void TcpServer::setExclusiveAccept()
+{
+    assert(!started_.get());
+    acceptor_->setExclusive();
+}
+
+void TcpServer::setAcceptRate(double perSecond, int burst)
+{
+    assert(!started_.get());
+    acceptRate_ = perSecond;
+    acceptBurst_ = std::max(burst, 1);
+    acceptTokens_ = acceptBurst_;
+    lastRefill_ = Timestamp::now();
+}
+
+void TcpServer::setOverloadThreshold(double seconds, double interval)
+{
+    assert(!started_.get());
+    overloadThreshold_ = seconds;
+    probeInterval_ = interval;
+}
+
+void TcpServer::pauseAccepting(PauseReason reason)
+{
+    loop_->assertInLoopThread();
+    if (pauseReasons_ == 0)
+    {
+        LOG_WARN << "TcpServer::pauseAccepting [" << name_ << "] - reason " << reason;
+        acceptor_->pause();
+    }
+    pauseReasons_ |= reason;
+}
+
+void TcpServer::resumeAccepting(PauseReason reason)
+{
+    loop_->assertInLoopThread();
+    if (pauseReasons_ & reason)
+    {
+        pauseReasons_ &= ~reason;
+        if (pauseReasons_ == 0)
+        {
+            LOG_INFO << "TcpServer::resumeAccepting [" << name_ << "]";
+            acceptor_->resume();
+        }
+    }
+}
+
+// token bucket, one token per accepted connection
+bool TcpServer::takeAcceptToken()
+{
+    Timestamp now(Timestamp::now());
+    acceptTokens_ = std::min(acceptBurst_, acceptTokens_ + timeDifference(now, lastRefill_) * acceptRate_);
+    lastRefill_ = now;
+    acceptTokens_ -= 1;
+    if (acceptTokens_ < 1)
+    {
+        // wait for the next token without accepting
+        pauseAccepting(kAcceptRate);
+        refillTimer_ = loop_->runAfter((1 - acceptTokens_) / acceptRate_,
+                                       std::bind(&TcpServer::refillAcceptTokens, this));
+    }
+    return acceptTokens_ >= 0;
+}
+
+void TcpServer::refillAcceptTokens()
+{
+    resumeAccepting(kAcceptRate);
+}
+
+struct TcpServer::LoopProbe
+{
+    // run in the probed loop
+    static void arrive(const std::shared_ptr<LoopProbe> &probe)
+    {
+        probe->lag.getAndSet(Timestamp::now().microSecondsSinceEpoch() - probe->sent.get());
+        probe->sent.getAndSet(0);
+    }
+
+    AtomicInt64 sent; // microseconds, 0 if not in flight
+    AtomicInt64 lag;
+};
+
+// Queues a probe in each IO loop and measures how long it takes to run,
+// a probe still in flight counts as lagging since it was sent.
+void TcpServer::probeLoops()
+{
+    loop_->assertInLoopThread();
+    std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    int64_t maxLag = 0;
+    for (size_t i = 0; i < loops.size() && i < probes_.size(); ++i)
+    {
+        LoopProbe *probe = get_pointer(probes_[i]);
+        int64_t sent = probe->sent.get();
+        if (sent != 0)
+        {
+            maxLag = std::max(maxLag, now - sent);
+        }
+        else
+        {
+            maxLag = std::max(maxLag, probe->lag.get());
+            probe->sent.getAndSet(now);
+            loops[i]->queueInLoop(std::bind(&LoopProbe::arrive, probes_[i]));
+        }
+    }
+
+    if (static_cast<double>(maxLag) > overloadThreshold_ * Timestamp::kMicroSecondsPerSecond)
+    {
+        pauseAccepting(kOverload);
+    }
+    else
+    {
+        resumeAccepting(kOverload);
     }
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     loop_->assertInLoopThread();
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64];
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    string connName = name_ + buf; // 连接名称
+    int index = -1;
+    if (incomingCpuAffinity_)
+    {
+        int cpu = sockets::getIncomingCpu(sockfd);
+        index = cpu >= 0 ? threadPool_->loopIndexForCpu(cpu) : -1;
+    }
+    Registry *registry = NULL;
+    if (index >= 0)
+    {
+        registry = get_pointer(registries_[index]);
+    }
+    else
+    {
+        // same round-robin as EventLoopThreadPool::getNextLoop()
+        registry = get_pointer(registries_[nextRegistry_]);
+        if (++nextRegistry_ >= registries_.size())
+        {
+            nextRegistry_ = 0;
+        }
+    }
+    EventLoop *ioLoop = registry->loop;
+    int64_t connId = nextConnId_++;
 
     LOG_INFO << "TcpServer::newConnection [" << name_
-             << "] - new connection [" << connName
-             << "] from " << peerAddr.toIpPort();
+             << "] - new connection #" << connId
+             << " from " << peerAddr.toIpPort();
+    if (acceptRate_ > 0 && !takeAcceptToken())
+    {
+        // accepted more than burst before pausing, eg. in a batch
+        LOG_WARN << "TcpServer::newConnection [" << name_
+                 << "] - accept rate exceeded, close #" << connId;
+        ++numRejected_;
+        sockets::close(sockfd);
+        return;
+    }
+    string peerIp;
+    if (maxConnectionsPerIp_ > 0)
+    {
+        peerIp = peerAddr.toIp();
+        MutexLockGuard lock(perIpMutex_);
+        int &count = connectionsPerIp_[peerIp];
+        if (count >= maxConnectionsPerIp_)
+        {
+            LOG_WARN << "TcpServer::newConnection [" << name_
+                     << "] - too many connections from " << peerIp
+                     << ", close #" << connId;
+            ++numRejected_;
+            sockets::close(sockfd);
+            return;
+        }
+        ++count;
+    }
+    std::unique_ptr<TlsEngine> tlsEngine;
+    if (tlsContext_)
+    {
+        tlsEngine = tlsContext_->newEngine(sockfd, true);
+        if (!tlsEngine)
+        {
+            LOG_ERROR << "TcpServer::newConnection [" << name_
+                      << "] - failed to create TLS engine for #" << connId;
+            if (!peerIp.empty())
+            {
+                MutexLockGuard lock(perIpMutex_);
+                if (--connectionsPerIp_[peerIp] <= 0)
+                {
+                    connectionsPerIp_.erase(peerIp);
+                }
+            }
+            sockets::close(sockfd);
+            return;
+        }
+    }
     InetAddress localAddr(sockets::getLocalAddr(sockfd));
     // FIXME poll with zero timeout to double confirm the new connection
     // FIXME use make_shared if necessary
     TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                            connName,
+                                            connId,
+                                            connNamePrefix_,
                                             sockfd,
                                             localAddr,
-                                            peerAddr)); // use_count == 1
-    connections_[connName] = conn;                      // use_count == 2
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+                                            peerAddr,
+                                            compactConnections_)); // use_count == 1
+    if (numConnections_.incrementAndGet() >= maxConnections_ && maxConnections_ > 0)
+    {
+        pauseAccepting(kMaxConnections);
+    }
+    if (callbacksChanged_)
+    {
+        updateCallbacks();
+    }
+    conn->setCallbacks(registry->callbacks);
+    if (tlsEngine)
+    {
+        conn->setTlsEngine(std::move(tlsEngine));
+    }
+    if (ioLoop == loop_)
+    {
+        addConnection(registry, conn);
+    }
+    else
+    {
+        registry->pending.push_back(conn); // handed over in newConnectionsDone()
+    }
 
 } // conn销毁 use_count == 1
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::updateCallbacks()
 {
-    // FIXME: unsafe
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    loop_->assertInLoopThread();
+    for (const auto &registry : registries_)
+    {
+        // connections still share the old table
+        registry->callbacks = std::make_shared<TcpConnection::Callbacks>();
+        registry->callbacks->connection = connectionCallback_;
+        registry->callbacks->message = messageCallback_;
+        registry->callbacks->writeComplete = writeCompleteCallback_;
+        registry->callbacks->close = std::bind(
+            &TcpServer::onConnectionClosed, std::weak_ptr<Registry>(registry), _1);
+    }
+    callbacksChanged_ = false;
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+// One queueInLoop() per IO loop for a batch of accepts.
+void TcpServer::newConnectionsDone()
 {
     loop_->assertInLoopThread();
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_ << "] - connection " << conn->name();
+    for (const auto &registry : registries_)
+    {
+        if (!registry->pending.empty())
+        {
+            std::vector<TcpConnectionPtr> conns;
+            conns.swap(registry->pending);
+            registry->loop->queueInLoop(
+                std::bind(&TcpServer::addConnections, registry, std::move(conns)));
+        }
+    }
+}
+
+void TcpServer::addConnections(const std::shared_ptr<Registry> &registry,
+                               const std::vector<TcpConnectionPtr> &conns)
+{
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        addConnection(get_pointer(registry), conn);
+    }
+}
 
-    size_t n = connections_.erase(conn->name()); // erase后 use_count == 1
+void TcpServer::addConnection(Registry *registry, const TcpConnectionPtr &conn)
+{
+    registry->loop->assertInLoopThread();
+    registry->connections[conn->id()] = conn;
+    conn->setTimeMessageCallback(registry->timeMessageCallbacks);
+    conn->connectEstablished();
+    if (!registry->wheel.empty())
+    {
+        addToWheel(registry, conn->id(), addTime(conn->lastActive(), registry->idleTimeout),
+                   conn->lastActive());
+    }
+}
+
+// Called by TcpConnection::handleClose() in its loop, so closing doesn't
+// touch the acceptor loop, unless accepting is paused by setMaxConnections().
+void TcpServer::onConnectionClosed(const std::weak_ptr<Registry> &weakRegistry,
+                                   const TcpConnectionPtr &conn)
+{
+    std::shared_ptr<Registry> registry(weakRegistry.lock());
+    if (!registry)
+    {
+        return; // destroyed with its registry, can't get here
+    }
+    registry->loop->assertInLoopThread();
+    addTraffic(&registry->closedTraffic, conn->traffic());
+    size_t n = registry->connections.erase(conn->id()); // erase后 use_count == 1
     (void)n;
     assert(n == 1);
+    // conn值传递，use_count == 2，执行完connectDestroyed，usecount=1
+    registry->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+
+    MutexLockGuard lock(registry->serverMutex);
+    if (registry->server)
+    {
+        registry->server->removeConnection(get_pointer(registry), conn);
+    }
+}
 
-    EventLoop *ioLoop = conn->getLoop();                                    // TcpConnection和TcpServer可能不在一个loop中。
-    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn)); // conn值传递，use_count == 2，执行完connectDestroyed，usecount=1
+void TcpServer::removeConnection(Registry *registry, const TcpConnectionPtr &conn)
+{
+    LOG_INFO << "TcpServer::removeConnection [" << name_ << "] - connection #" << conn->id();
+    if (maxConnectionsPerIp_ > 0)
+    {
+        string peerIp(conn->peerAddress().toIp());
+        MutexLockGuard lock(perIpMutex_);
+        std::unordered_map<string, int>::iterator it = connectionsPerIp_.find(peerIp);
+        if (it != connectionsPerIp_.end() && --it->second <= 0)
+        {
+            connectionsPerIp_.erase(it);
+        }
+    }
+    int remaining = numConnections_.decrementAndGet();
+    std::weak_ptr<TcpServer *> weakSelf(self_);
+    if (remaining == maxConnections_ - 1 && maxConnections_ > 0)
+    {
+        loop_->runInLoop([weakSelf] {
+            std::shared_ptr<TcpServer *> self(weakSelf.lock());
+            if (self)
+            {
+                (*self)->connectionsBelowMax();
+            }
+        });
+    }
+    if (remaining == 0 && draining_.get())
+    {
+        // after connectDestroyed(), the last socket is closed once drained
+        EventLoop *loop = loop_;
+        registry->loop->queueInLoop([loop, weakSelf] {
+            loop->runInLoop([weakSelf] {
+                std::shared_ptr<TcpServer *> self(weakSelf.lock());
+                if (self)
+                {
+                    (*self)->checkDrained();
+                }
+            });
+        });
+    }
+}
+
+void TcpServer::connectionsBelowMax()
+{
+    loop_->assertInLoopThread();
+    if (numConnections_.get() < maxConnections_)
+    {
+        resumeAccepting(kMaxConnections);
+    }
 }
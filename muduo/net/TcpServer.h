@@ -12,13 +12,19 @@
 #define MUDUO_NET_TCPSERVER_H
 
 #include "muduo/base/Atomic.h"
+#include "muduo/base/Mutex.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/TcpConnection.h"
+#include "muduo/net/TimerId.h"
+#include "muduo/net/TransportStats.h"
 
-#include <map>
+#include <unordered_map>
+#include <vector>
 
 namespace muduo
 {
+  class CountDownLatch;
+
   namespace net
   {
 
@@ -45,10 +51,15 @@ namespace muduo
                 const InetAddress &listenAddr,
                 const string &nameArg,
                 Option option = kNoReusePort);
+      /// Serves on a listen socket handed over by another process,
+      /// see HotRestart. Takes ownership of @c listenFd.
+      TcpServer(EventLoop *loop, int listenFd, const string &nameArg);
       ~TcpServer(); // force out-line dtor, for std::unique_ptr members.
 
       const string &ipPort() const { return ipPort_; }
       const string &name() const { return name_; }
+      /// For handing it over to another process.
+      int listenFd() const;
       EventLoop *getLoop() const { return loop_; }
 
       /// Set the number of threads for handling input.
@@ -75,25 +86,182 @@ namespace muduo
 
       /// Set connection callback.
       /// Not thread safe.
-      void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+      void setConnectionCallback(const ConnectionCallback &cb)
+      {
+        connectionCallback_ = cb;
+        callbacksChanged_ = true;
+      }
 
       /// Set message callback.
       /// Not thread safe.
-      void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+      void setMessageCallback(const MessageCallback &cb)
+      {
+        messageCallback_ = cb;
+        callbacksChanged_ = true;
+      }
 
       /// Set write complete callback.
       /// Not thread safe.
-      void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+      void setWriteCompleteCallback(const WriteCompleteCallback &cb)
+      {
+        writeCompleteCallback_ = cb;
+        callbacksChanged_ = true;
+      }
+
+      /// Terminates TLS on new connections, see muduo/net/tls/SslContext.h
+      /// The connection callback is called after the handshake.
+      /// Not thread safe.
+      void setTlsContext(const TlsContextPtr &ctx) { tlsContext_ = ctx; }
+
+      /// Compact connections start with empty buffers and free them once
+      /// drained, trading a malloc per message for RAM of idle connections.
+      /// Must be called before @c start
+      void setCompactConnections(bool on) { compactConnections_ = on; }
+
+      /// Accepts up to @c batch connections per wakeup of the acceptor loop,
+      /// handed to each IO loop at once. 1 by default.
+      /// Must be called before @c start
+      void setAcceptBatch(int batch);
+      /// TCP_DEFER_ACCEPT, accept a connection once it has data, or after
+      /// about @c seconds. For protocols where the client speaks first.
+      /// Must be called before @c start
+      void setDeferAccept(int seconds);
+      /// EPOLLEXCLUSIVE on the listen fd, for a listen fd shared by processes.
+      /// Must be called before @c start
+      void setExclusiveAccept();
+      /// Hands a connection to the IO loop running on the CPU that received
+      /// its packets (SO_INCOMING_CPU), round-robin if there is none.
+      /// Useful with threadPool()->setCpuAffinity() and RSS/RPS steering.
+      /// Must be called before @c start
+      void setIncomingCpuAffinity(bool on) { incomingCpuAffinity_ = on; }
+
+      /// Force closes connections without reading or writing for
+      /// @c seconds, checked by a timing wheel in each IO loop, up to
+      /// an eighth of @c seconds late. 0 (the default) turns it off.
+      /// Must be called before @c start
+      void setIdleTimeout(double seconds);
+      /// Thread safe.
+      int64_t numIdleClosed() const { return numIdleClosed_.get(); }
+
+      /// Samples TCP_INFO of all connections every @c interval seconds,
+      /// in their IO loops, into histograms and the @c worst connections
+      /// by each TransportStats::SortKey. 0 (the default) turns it off.
+      /// Must be called before @c start
+      void setTransportSampling(double interval, size_t worst = 10);
+      /// Latest samples of all IO loops, see TransportInspector.
+      /// Thread safe.
+      TransportStats transportStats() const;
+
+      /// Times messageCallback of each connection, see TcpConnection::Traffic.
+      /// Must be called before @c start
+      void setTimeMessageCallbacks(bool on) { timeMessageCallbacks_ = on; }
+
+      struct ConnectionTraffic
+      {
+        int64_t id; // named "name-ip:port#id", formatted by whoever prints it
+        TcpConnection::Traffic traffic;
+      };
+      struct TrafficSnapshot
+      {
+        Timestamp when;
+        /// Of all connections since start, closed ones included,
+        /// high water marks are the highest of any connection.
+        TcpConnection::Traffic total;
+        std::vector<ConnectionTraffic> connections;
+      };
+      /// Traffic of the open connections, and totals of the server.
+      /// Blocks for a round trip to each IO loop, call it in another
+      /// thread, eg. the Inspector's, see TrafficInspector.
+      TrafficSnapshot trafficSnapshot() const;
+
+      /// Admission control, all off (0) by default.
+      /// Must be called before @c start
+
+      /// Stops accepting while there are @c maxConnections connections,
+      /// new ones wait in the listen backlog.
+      void setMaxConnections(int maxConnections) { maxConnections_ = maxConnections; }
+      /// Closes new connections from an IP having @c maxConnectionsPerIp already.
+      void setMaxConnectionsPerIp(int maxConnectionsPerIp) { maxConnectionsPerIp_ = maxConnectionsPerIp; }
+      /// Accepts at most @c perSecond connections on average, in bursts of
+      /// at most @c burst, stops accepting in between.
+      void setAcceptRate(double perSecond, int burst);
+      /// Stops accepting while any IO loop takes more than @c seconds to run
+      /// a queued functor, probed every @c interval seconds.
+      void setOverloadThreshold(double seconds, double interval = 0.1);
+
+      /// Stops accepting for good, connections in the listen backlog are
+      /// left to another process sharing the listen socket.
+      /// Not thread safe, but in loop
+      void stopAccepting();
+      /// Stops accepting, and calls @c done once all connections are closed.
+      /// Connections still open after @c seconds are force closed.
+      /// Connection callbacks may check draining() to close idle keep-alive
+      /// connections early.
+      /// Not thread safe, but in loop
+      void drain(double seconds, const std::function<void()> &done);
+      /// Thread safe.
+      bool draining() const { return draining_.get() != 0; }
+
+      /// Thread safe.
+      int numConnections() const { return numConnections_.get(); }
+
+      /// Connections closed right after accept, by the per IP limit or
+      /// because a batch of accepts exceeded the accept rate burst.
+      /// Not thread safe, but in loop
+      int64_t numRejected() const { return numRejected_; }
+      /// Accepting is paused by any of the limits above.
+      /// Not thread safe, but in loop
+      bool acceptPaused() const { return pauseReasons_ != 0; }
 
     private:
+      struct Registry;
+
+      TcpServer(EventLoop *loop, Acceptor *acceptor, const string &ipPort,
+                const string &nameArg);
+
       /// Not thread safe, but in loop
       void newConnection(int sockfd, const InetAddress &peerAddr);
-      /// Thread safe.
-      void removeConnection(const TcpConnectionPtr &conn);
       /// Not thread safe, but in loop
-      void removeConnectionInLoop(const TcpConnectionPtr &conn);
+      void newConnectionsDone();
+      /// In the IO loop of conn, registries may outlive us
+      static void addConnection(Registry *registry, const TcpConnectionPtr &conn);
+      static void addConnections(const std::shared_ptr<Registry> &registry,
+                                 const std::vector<TcpConnectionPtr> &conns);
+      static void onConnectionClosed(const std::weak_ptr<Registry> &weakRegistry,
+                                     const TcpConnectionPtr &conn);
+      static void destroyConnections(const std::shared_ptr<Registry> &registry);
+      /// In the IO loop of conn, with registry->serverMutex held
+      void removeConnection(Registry *registry, const TcpConnectionPtr &conn);
+      /// Not thread safe, but in loop
+      void connectionsBelowMax();
+      /// Not thread safe, but in loop
+      void updateCallbacks();
+      /// Not thread safe, but in loop
+      void checkDrained();
+      void forceCloseAll();
+      /// In the IO loop of registry
+      static void forceCloseConnections(const std::shared_ptr<Registry> &registry);
+      static void startWheel(const std::shared_ptr<Registry> &registry);
+      static void onWheelTick(const std::shared_ptr<Registry> &registry);
+      static void addToWheel(Registry *registry, int64_t connId, Timestamp deadline, Timestamp now);
+      static void sampleTransport(const std::shared_ptr<Registry> &registry);
+      void collectTraffic(Registry *registry, TrafficSnapshot *snapshot, CountDownLatch *latch) const;
+
+      enum PauseReason
+      {
+        kMaxConnections = 1,
+        kAcceptRate = 2,
+        kOverload = 4,
+        kStopped = 8,
+      };
+      // Not thread safe, but in loop
+      void pauseAccepting(PauseReason reason);
+      void resumeAccepting(PauseReason reason);
+      bool takeAcceptToken();
+      void refillAcceptTokens();
+      void probeLoops();
 
-      typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+      struct LoopProbe; // shared with IO loops, outlives us
 
       EventLoop *loop_; // the acceptor loop
       const string ipPort_; // 服务端口
@@ -105,11 +273,49 @@ namespace muduo
       MessageCallback messageCallback_;
       WriteCompleteCallback writeCompleteCallback_;
       ThreadInitCallback threadInitCallback_; // IO线程池在进入事件循环前，会回调此函数
+      TlsContextPtr tlsContext_;
+      bool callbacksChanged_; // tables of registries are out of date
+      bool compactConnections_;
+      bool incomingCpuAffinity_;
       
       AtomicInt32 started_;
       // always in loop thread
-      int nextConnId_;    // 下一个连接ID
-      ConnectionMap connections_; // 连接列表
+      int64_t nextConnId_;    // 下一个连接ID
+      size_t nextRegistry_;
+      // one per IO loop, connections are added and removed in their own loop
+      std::vector<std::shared_ptr<Registry>> registries_;
+      std::shared_ptr<const string> connNamePrefix_; // "name-ip:port"
+      // weak in functors IO loops queue to our loop, expired once we're gone
+      std::shared_ptr<TcpServer *> self_;
+      mutable AtomicInt32 numConnections_;
+
+      // admission control, always in loop thread
+      int maxConnections_;
+      int maxConnectionsPerIp_;
+      MutexLock perIpMutex_; // decremented in IO loops
+      std::unordered_map<string, int> connectionsPerIp_ GUARDED_BY(perIpMutex_);
+      double acceptRate_;
+      double acceptBurst_;
+      double acceptTokens_;
+      Timestamp lastRefill_;
+      TimerId refillTimer_;
+      double overloadThreshold_;
+      double probeInterval_;
+      TimerId probeTimer_;
+      std::vector<std::shared_ptr<LoopProbe>> probes_;
+      int pauseReasons_;
+      int64_t numRejected_;
+      // hot restart
+      mutable AtomicInt32 draining_;
+      std::function<void()> drainedCallback_;
+      TimerId drainTimer_;
+      // idle connections
+      double idleTimeout_;
+      mutable AtomicInt64 numIdleClosed_;
+      // transport statistics
+      double sampleInterval_;
+      size_t sampleWorst_;
+      bool timeMessageCallbacks_;
     };
 
   } // namespace net
@@ -13,6 +13,16 @@ using namespace muduo::net;
 
 AtomicInt64 Timer::s_numCreated_;
 
+void Timer::align(int64_t slack)
+{
+  int64_t when = expiration_.microSecondsSinceEpoch();
+  int64_t remainder = when % slack;
+  if (remainder != 0)
+  {
+    expiration_ = Timestamp(when - remainder + slack);
+  }
+}
+
 void Timer::restart(Timestamp now)
 {
   if (repeat_)
@@ -45,6 +45,9 @@ namespace muduo
       int64_t sequence() const { return sequence_; }
 
       void restart(Timestamp now);
+      /// Delays expiration to the next multiple of @c slack microseconds
+      /// since the epoch, so timers of similar deadlines expire together.
+      void align(int64_t slack);
 
       static int64_t numCreated() { return s_numCreated_.get(); }
 
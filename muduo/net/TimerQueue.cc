@@ -17,6 +17,8 @@
 #include "muduo/net/Timer.h"
 #include "muduo/net/TimerId.h"
 
+#include <algorithm>
+
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -76,6 +78,16 @@ namespace muduo
         }
       }
 
+      void disarmTimerfd(int timerfd)
+      {
+        struct itimerspec newValue;
+        memZero(&newValue, sizeof newValue);
+        if (::timerfd_settime(timerfd, 0, &newValue, NULL))
+        {
+          LOG_SYSERR << "timerfd_settime()";
+        }
+      }
+
     } // namespace detail
   }   // namespace net
 } // namespace muduo
@@ -89,7 +101,9 @@ TimerQueue::TimerQueue(EventLoop *loop)
       timerfd_(createTimerfd()),
       timerfdChannel_(loop, timerfd_),
       timers_(),
-      callingExpiredTimers_(false)
+      callingExpiredTimers_(false),
+      useTimerfd_(true),
+      slack_(0)
 {
   timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
   
@@ -124,10 +138,12 @@ void TimerQueue::cancel(TimerId timerId)
 void TimerQueue::addTimerInLoop(Timer *timer)
 {
   loop_->assertInLoopThread();  // 添加、处理、删除都是在loop所在线程运行的。
+  alignIfRepeat(timer);
   // 插入一个定时器，有可能会使得最早到期的定时器发生改变
   bool earliestChanged = insert(timer);
 
-  if (earliestChanged)
+  // otherwise the loop picks it up in pollTimeout()
+  if (earliestChanged && useTimerfd_)
   {
     // 重置定时器的超时时刻
     resetTimerfd(timerfd_, timer->expiration());
@@ -161,7 +177,73 @@ void TimerQueue::handleRead()
   
   Timestamp now(Timestamp::now());
   readTimerfd(timerfd_, now); // 清除该事件，避免一直触发
+  expire(now);
+}
+
+void TimerQueue::setUseTimerfd(bool on)
+{
+  loop_->assertInLoopThread();
+  if (on == useTimerfd_)
+  {
+    return;
+  }
+  useTimerfd_ = on;
+  if (!on)
+  {
+    disarmTimerfd(timerfd_);
+  }
+  else if (!timers_.empty())
+  {
+    resetTimerfd(timerfd_, timers_.begin()->first);
+  }
+}
+
+void TimerQueue::setSlack(double seconds)
+{
+  loop_->assertInLoopThread();
+  slack_ = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+}
+
+int TimerQueue::pollTimeout(int maxMs) const
+{
+  if (timers_.empty() || maxMs == 0)
+  {
+    return maxMs;
+  }
+  int64_t us = timers_.begin()->first.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+  if (us <= 0)
+  {
+    return 0;
+  }
+  // rounded up, never wakes up before the timer
+  int64_t ms = (us + 999) / 1000;
+  return static_cast<int>(std::min(ms, static_cast<int64_t>(maxMs)));
+}
 
+void TimerQueue::runExpired()
+{
+  loop_->assertInLoopThread();
+  if (timers_.empty())
+  {
+    return;
+  }
+  Timestamp now(Timestamp::now());
+  if (!(now < timers_.begin()->first))
+  {
+    expire(now);
+  }
+}
+
+void TimerQueue::alignIfRepeat(Timer *timer)
+{
+  if (slack_ > 0 && timer->repeat())
+  {
+    timer->align(slack_);
+  }
+}
+
+void TimerQueue::expire(Timestamp now)
+{
   // 获取该时刻之前所有的定时器列表
   std::vector<Entry> expired = getExpired(now);
 
@@ -219,6 +301,7 @@ void TimerQueue::reset(const std::vector<Entry> &expired, Timestamp now)
     if (it.second->repeat() && cancelingTimers_.find(timer) == cancelingTimers_.end())
     {
       it.second->restart(now);
+      alignIfRepeat(it.second);
       insert(it.second);
     }
     else
@@ -234,7 +317,7 @@ void TimerQueue::reset(const std::vector<Entry> &expired, Timestamp now)
     nextExpire = timers_.begin()->second->expiration();
   }
 
-  if (nextExpire.valid())
+  if (nextExpire.valid() && useTimerfd_)
   {
     resetTimerfd(timerfd_, nextExpire);
   }
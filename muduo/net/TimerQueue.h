@@ -49,6 +49,22 @@ namespace muduo
 
       void cancel(TimerId timerId);
 
+      /// Without timerfd, the loop polls with pollTimeout() and calls
+      /// runExpired() after each poll, saving a timerfd_settime() per
+      /// change of the earliest timer and a read() per expiration.
+      /// Timers are up to 1ms late, the resolution of epoll_wait().
+      /// In loop thread.
+      void setUseTimerfd(bool on);
+      bool useTimerfd() const { return useTimerfd_; }
+      /// Milliseconds until the earliest timer, at most @c maxMs.
+      int pollTimeout(int maxMs) const;
+      void runExpired();
+
+      /// Repeating timers expire at multiples of @c seconds since the epoch,
+      /// up to @c seconds late. 0 (the default) turns it off.
+      /// In loop thread.
+      void setSlack(double seconds);
+
     private:
       // FIXME: use unique_ptr<Timer> instead of raw pointers.
       // This requires heterogeneous comparison lookup (N3465) from C++14
@@ -64,11 +80,13 @@ namespace muduo
       void cancelInLoop(TimerId timerId);
       // called when timerfd alarms
       void handleRead();
+      void expire(Timestamp now);
       // move out all expired timers
       std::vector<Entry> getExpired(Timestamp now);
       void reset(const std::vector<Entry> &expired, Timestamp now);
 
       bool insert(Timer *timer);
+      void alignIfRepeat(Timer *timer);
 
       EventLoop *loop_;
       const int timerfd_;
@@ -78,6 +96,8 @@ namespace muduo
 
       ActiveTimerSet activeTimers_;
       bool callingExpiredTimers_; /* atomic */
+      bool useTimerfd_;
+      int64_t slack_; // microseconds
       // for cancel()
       ActiveTimerSet cancelingTimers_;
     };
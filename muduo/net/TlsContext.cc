@@ -0,0 +1,14 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/TlsContext.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+TlsEngine::~TlsEngine() = default;
+
+TlsContext::~TlsContext() = default;
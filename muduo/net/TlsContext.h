@@ -0,0 +1,81 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TLSCONTEXT_H
+#define MUDUO_NET_TLSCONTEXT_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <memory>
+
+#include <sys/types.h> // ssize_t
+
+namespace muduo
+{
+  namespace net
+  {
+
+    class Buffer;
+
+    ///
+    /// Per-connection TLS session, driven by TcpConnection in its loop thread.
+    ///
+    /// The engine does its own I/O on the (non-blocking) sockfd,
+    /// the return values mimic read(2)/write(2), so that TcpConnection
+    /// can treat TLS and plain TCP alike.
+    class TlsEngine : noncopyable
+    {
+    public:
+      enum HandshakeState
+      {
+        kHandshakeDone,
+        kHandshakeWantRead,
+        kHandshakeWantWrite,
+        kHandshakeFailed,
+      };
+
+      virtual ~TlsEngine();
+
+      /// Continues the handshake, call again on readable/writable.
+      virtual HandshakeState handshake() = 0;
+
+      /// Decrypts as much as available into @c buf.
+      /// @return >0 bytes of plaintext, 0 on close_notify or EOF,
+      /// -1 on error and *savedErrno is set, EWOULDBLOCK if nothing to read.
+      virtual ssize_t read(Buffer *buf, int *savedErrno) = 0;
+
+      /// Encrypts and sends up to @c len bytes.
+      /// @return bytes consumed, or -1 with errno set,
+      /// EWOULDBLOCK if the socket is full.
+      virtual ssize_t write(const void *data, size_t len) = 0;
+
+      /// Sends close_notify, best effort.
+      virtual void shutdown() = 0;
+
+      /// Record encryption has been handed to the kernel (kTLS TX),
+      /// plain write(2) and sendfile(2) on the sockfd are encrypted.
+      virtual bool kernelSend() const = 0;
+    };
+
+    ///
+    /// Factory of TlsEngine, shared by all connections of a TcpServer/TcpClient.
+    ///
+    /// See muduo/net/tls/SslContext.h for an OpenSSL implementation.
+    class TlsContext : noncopyable
+    {
+    public:
+      virtual ~TlsContext();
+
+      /// Thread safe.
+      virtual std::unique_ptr<TlsEngine> newEngine(int sockfd, bool isServer) = 0;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_TLSCONTEXT_H
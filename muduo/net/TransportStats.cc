@@ -0,0 +1,128 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/TransportStats.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+  int bucketOf(uint64_t value)
+  {
+    int i = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return std::min(i, Log2Histogram::kBuckets - 1);
+  }
+
+  uint64_t keyOf(const TransportSample &sample, TransportStats::SortKey key)
+  {
+    switch (key)
+    {
+    case TransportStats::kByRtt:
+      return sample.rtt;
+    case TransportStats::kByRetrans:
+      return sample.totalRetrans;
+    case TransportStats::kByUnacked:
+      return sample.unacked;
+    case TransportStats::kByOutputBytes:
+      return sample.outputBytes;
+    }
+    return 0;
+  }
+
+  void sortBy(std::vector<TransportSample> *samples, TransportStats::SortKey key, size_t n)
+  {
+    n = std::min(n, samples->size());
+    std::partial_sort(samples->begin(), samples->begin() + n, samples->end(),
+                      [key](const TransportSample &lhs, const TransportSample &rhs) {
+                        return keyOf(lhs, key) > keyOf(rhs, key);
+                      });
+    samples->resize(n);
+  }
+}
+
+void Log2Histogram::add(uint64_t value)
+{
+  ++buckets_[bucketOf(value)];
+  ++count_;
+  sum_ += value;
+  max_ = std::max(max_, value);
+}
+
+void Log2Histogram::merge(const Log2Histogram &other)
+{
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t Log2Histogram::percentile(double p) const
+{
+  int64_t target = static_cast<int64_t>(p * static_cast<double>(count_) + 0.999999);
+  int64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    seen += buckets_[i];
+    if (seen >= target && seen > 0)
+    {
+      uint64_t upper = i == 0 ? 0 : (uint64_t(1) << i) - 1;
+      return std::min(upper, max_);
+    }
+  }
+  return max_;
+}
+
+void TransportStats::merge(const TransportStats &other)
+{
+  if (!sampled.valid() || (other.sampled.valid() && other.sampled < sampled))
+  {
+    sampled = other.sampled;
+  }
+  connections += other.connections;
+  rtt.merge(other.rtt);
+  cwnd.merge(other.cwnd);
+  unacked.merge(other.unacked);
+  totalRetrans.merge(other.totalRetrans);
+  deliveryRate.merge(other.deliveryRate);
+  outputBytes.merge(other.outputBytes);
+  worst.insert(worst.end(), other.worst.begin(), other.worst.end());
+}
+
+void TransportStats::sortWorst(SortKey key, size_t n)
+{
+  sortBy(&worst, key, n);
+}
+
+void TransportStats::trimWorst(size_t n)
+{
+  if (worst.size() <= n)
+  {
+    return;
+  }
+  std::set<int64_t> kept;
+  std::vector<TransportSample> result;
+  const SortKey keys[] = { kByRtt, kByRetrans, kByUnacked, kByOutputBytes };
+  for (SortKey key : keys)
+  {
+    std::vector<TransportSample> top(worst);
+    sortBy(&top, key, n);
+    for (TransportSample &sample : top)
+    {
+      if (kept.insert(sample.connId).second)
+      {
+        result.push_back(std::move(sample));
+      }
+    }
+  }
+  worst.swap(result);
+}
@@ -0,0 +1,105 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TRANSPORTSTATS_H
+#define MUDUO_NET_TRANSPORTSTATS_H
+
+#include "muduo/base/copyable.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <vector>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    ///
+    /// Histogram with power of two buckets, bucket i counts values in [2^(i-1), 2^i).
+    ///
+    class Log2Histogram : public muduo::copyable
+    {
+    public:
+      static const int kBuckets = 48;
+
+      Log2Histogram() : count_(0), sum_(0), max_(0)
+      {
+        memZero(buckets_, sizeof buckets_);
+      }
+
+      void add(uint64_t value);
+      void merge(const Log2Histogram &other);
+
+      int64_t count() const { return count_; }
+      uint64_t max() const { return max_; }
+      double mean() const { return count_ > 0 ? static_cast<double>(sum_) / static_cast<double>(count_) : 0; }
+      /// Upper bound of the bucket holding the @c p quantile, 0 < @c p <= 1.
+      uint64_t percentile(double p) const;
+      int64_t bucket(int i) const { return buckets_[i]; }
+
+    private:
+      int64_t buckets_[kBuckets];
+      int64_t count_;
+      uint64_t sum_;
+      uint64_t max_;
+    };
+
+    /// TCP_INFO of a connection, and what it has queued.
+    struct TransportSample
+    {
+      int64_t connId;
+      string name;
+      uint32_t rtt;           // smoothed, in microseconds
+      uint32_t rttVar;
+      uint32_t cwnd;          // segments
+      uint32_t unacked;       // segments in flight
+      uint32_t totalRetrans;  // segments retransmitted over the connection
+      uint64_t deliveryRate;  // bytes per second, 0 if the kernel doesn't tell
+      uint32_t notsentBytes;  // in the socket send buffer, not sent yet
+      size_t outputBytes;     // in our output buffers
+    };
+
+    ///
+    /// Transport statistics of the connections of a TcpServer,
+    /// see TcpServer::setTransportSampling().
+    ///
+    struct TransportStats
+    {
+      enum SortKey
+      {
+        kByRtt,
+        kByRetrans,
+        kByUnacked,
+        kByOutputBytes,
+      };
+
+      TransportStats() : connections(0) {}
+
+      /// Adds the histograms, keeps the union of the worst samples.
+      void merge(const TransportStats &other);
+      /// Sorts worst by @c key, worst first, keeps the first @c n.
+      void sortWorst(SortKey key, size_t n);
+      /// Keeps the worst @c n by each key, in no particular order.
+      void trimWorst(size_t n);
+
+      Timestamp sampled; // oldest sampling merged in
+      int connections;
+      Log2Histogram rtt;
+      Log2Histogram cwnd;
+      Log2Histogram unacked;
+      Log2Histogram totalRetrans;
+      Log2Histogram deliveryRate;
+      Log2Histogram outputBytes;
+      std::vector<TransportSample> worst;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_TRANSPORTSTATS_H
@@ -0,0 +1,38 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_CODEC_ADLER32CHECKSUM_H
+#define MUDUO_NET_CODEC_ADLER32CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    // Checksum of LengthFieldCodec, adler32 of the payload, same as
+    // ProtobufCodecLite's, links with -lz
+    struct Adler32Checksum
+    {
+      static const size_t kLen = sizeof(uint32_t);
+      static uint32_t compute(const char *buf, size_t len)
+      {
+        return static_cast<uint32_t>(
+            ::adler32(1, reinterpret_cast<const Bytef *>(buf), static_cast<uInt>(len)));
+      }
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_CODEC_ADLER32CHECKSUM_H
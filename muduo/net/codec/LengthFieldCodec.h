@@ -0,0 +1,285 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_CODEC_LENGTHFIELDCODEC_H
+#define MUDUO_NET_CODEC_LENGTHFIELDCODEC_H
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/Callbacks.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <limits.h>
+#include <stdint.h>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    // Length field of WIDTH bytes, big endian (network byte order) by default.
+    template <int WIDTH, bool BIGENDIAN = true>
+    struct FixedLengthField
+    {
+      static_assert(WIDTH == 1 || WIDTH == 2 || WIDTH == 4 || WIDTH == 8,
+                    "WIDTH should be 1, 2, 4 or 8");
+      static const size_t kMaxLen = WIDTH;
+
+      // Returns bytes of the field, 0 if incomplete, -1 if malformed.
+      static int decode(const char *buf, size_t readable, uint64_t *length)
+      {
+        if (readable < kMaxLen)
+        {
+          return 0;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(buf);
+        uint64_t x = 0;
+        for (int i = 0; i < WIDTH; ++i)
+        {
+          x |= static_cast<uint64_t>(p[i]) << (8 * (BIGENDIAN ? WIDTH - 1 - i : i));
+        }
+        *length = x;
+        return WIDTH;
+      }
+
+      static size_t encode(uint64_t length, char *buf)
+      {
+        for (int i = 0; i < WIDTH; ++i)
+        {
+          buf[i] = static_cast<char>(length >> (8 * (BIGENDIAN ? WIDTH - 1 - i : i)));
+        }
+        return kMaxLen;
+      }
+    };
+
+    // Base 128 varint length field, as protobuf's.
+    struct VarintLengthField
+    {
+      static const size_t kMaxLen = 10;
+
+      static int decode(const char *buf, size_t readable, uint64_t *length)
+      {
+        uint64_t x = 0;
+        for (size_t i = 0; i < kMaxLen; ++i)
+        {
+          if (i == readable)
+          {
+            return 0;
+          }
+          uint8_t byte = static_cast<uint8_t>(buf[i]);
+          x |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+          if ((byte & 0x80) == 0)
+          {
+            *length = x;
+            return static_cast<int>(i + 1);
+          }
+        }
+        return -1;
+      }
+
+      static size_t encode(uint64_t length, char *buf)
+      {
+        size_t n = 0;
+        while (length >= 0x80)
+        {
+          buf[n++] = static_cast<char>(length | 0x80);
+          length >>= 7;
+        }
+        buf[n++] = static_cast<char>(length);
+        return n;
+      }
+    };
+
+    // Checksum: kLen bytes computed by compute(payload, len),
+    // see Adler32Checksum.h for one
+    struct NoChecksum
+    {
+      static const size_t kLen = 0;
+      static uint32_t compute(const char *, size_t) { return 0; }
+    };
+
+    // wire format
+    //
+    // Field     Length             Content
+    //
+    // length    LengthField        N+C
+    // payload   N-byte             N <= MAX_FRAME
+    // checksum  C-byte, 0 or 4     big endian, of payload
+    //
+    // Frames are handed out as StringPiece into the input buffer, all frames
+    // of one read in one callback, they are valid until the callback returns.
+    // eg. LengthHeaderCodec of examples/asio/chat is
+    //   LengthFieldCodec<FixedLengthField<4>, 65536>
+    template <typename LengthField, size_t MAX_FRAME = 64 * 1024 * 1024,
+              typename Checksum = NoChecksum>
+    class LengthFieldCodec : noncopyable
+    {
+      static_assert(MAX_FRAME <= INT_MAX - Checksum::kLen, "StringPiece holds int length");
+      static_assert(Checksum::kLen == 0 || Checksum::kLen == 4, "checksum is 0 or 4 bytes");
+
+    public:
+      static const size_t kMaxFrameLen = MAX_FRAME;
+      static const size_t kMaxBatch = 64; // frames per callback
+
+      enum ErrorCode
+      {
+        kNoError = 0,
+        kInvalidLength,
+        kCheckSumError,
+      };
+
+      class Frames
+      {
+      public:
+        Frames(const StringPiece *frames, size_t count)
+            : frames_(frames), count_(count)
+        {
+        }
+
+        size_t size() const { return count_; }
+        const StringPiece &operator[](size_t i) const { return frames_[i]; }
+        const StringPiece *begin() const { return frames_; }
+        const StringPiece *end() const { return frames_ + count_; }
+
+      private:
+        const StringPiece *frames_;
+        size_t count_;
+      };
+
+      typedef std::function<void(const TcpConnectionPtr &,
+                                 const Frames &,
+                                 Timestamp)>
+          FramesCallback;
+
+      typedef std::function<void(const TcpConnectionPtr &,
+                                 Buffer *,
+                                 Timestamp,
+                                 ErrorCode)>
+          ErrorCallback;
+
+      explicit LengthFieldCodec(const FramesCallback &cb,
+                                const ErrorCallback &errorCb = defaultErrorCallback)
+          : framesCallback_(cb),
+            errorCallback_(errorCb)
+      {
+      }
+
+      // Frames parsed before an error are delivered, the erroneous one
+      // is left in buf for errorCallback.
+      void onMessage(const TcpConnectionPtr &conn,
+                     Buffer *buf,
+                     Timestamp receiveTime)
+      {
+        StringPiece frames[kMaxBatch];
+        size_t count = 0;
+        size_t consumed = 0;
+        ErrorCode error = kNoError;
+        while (error == kNoError)
+        {
+          const char *data = buf->peek() + consumed;
+          size_t readable = buf->readableBytes() - consumed;
+          uint64_t length = 0;
+          int headerLen = LengthField::decode(data, readable, &length);
+          if (headerLen < 0 || (headerLen > 0 && (length < Checksum::kLen ||
+                                                  length - Checksum::kLen > MAX_FRAME)))
+          {
+            error = kInvalidLength;
+          }
+          else if (headerLen == 0 || readable - static_cast<size_t>(headerLen) < length)
+          {
+            break;
+          }
+          else
+          {
+            const char *payload = data + headerLen;
+            size_t payloadLen = static_cast<size_t>(length) - Checksum::kLen;
+            if (Checksum::kLen > 0 &&
+                Checksum::compute(payload, payloadLen) != peekChecksum(payload + payloadLen))
+            {
+              error = kCheckSumError;
+              break;
+            }
+            frames[count++] = StringPiece(payload, static_cast<int>(payloadLen));
+            consumed += static_cast<size_t>(headerLen) + static_cast<size_t>(length);
+            if (count == kMaxBatch)
+            {
+              framesCallback_(conn, Frames(frames, count), receiveTime);
+              buf->retrieve(consumed);
+              count = 0;
+              consumed = 0;
+            }
+          }
+        }
+        if (count > 0)
+        {
+          framesCallback_(conn, Frames(frames, count), receiveTime);
+        }
+        buf->retrieve(consumed);
+        if (error != kNoError)
+        {
+          errorCallback_(conn, buf, receiveTime, error);
+        }
+      }
+
+      // Appends a frame to buf, several frames may go in one send.
+      static void encode(Buffer *buf, const StringPiece &frame)
+      {
+        assert(static_cast<size_t>(frame.size()) <= MAX_FRAME);
+        char header[LengthField::kMaxLen];
+        size_t len = LengthField::encode(static_cast<size_t>(frame.size()) + Checksum::kLen, header);
+        buf->append(header, len);
+        buf->append(frame);
+        if (Checksum::kLen > 0)
+        {
+          uint32_t sum = Checksum::compute(frame.data(), static_cast<size_t>(frame.size()));
+          char be[sizeof sum];
+          FixedLengthField<4>::encode(sum, be);
+          buf->append(be, sizeof be);
+        }
+      }
+
+      void send(const TcpConnectionPtr &conn, const StringPiece &frame) const
+      {
+        Buffer buf;
+        encode(&buf, frame);
+        conn->send(&buf);
+      }
+
+      static void defaultErrorCallback(const TcpConnectionPtr &conn,
+                                       Buffer *,
+                                       Timestamp,
+                                       ErrorCode errorCode)
+      {
+        LOG_ERROR << "LengthFieldCodec - "
+                  << (errorCode == kInvalidLength ? "InvalidLength" : "CheckSumError");
+        if (conn && conn->connected())
+        {
+          conn->shutdown();
+        }
+      }
+
+    private:
+      static uint32_t peekChecksum(const char *buf)
+      {
+        uint64_t sum = 0;
+        FixedLengthField<4>::decode(buf, sizeof(uint32_t), &sum);
+        return static_cast<uint32_t>(sum);
+      }
+
+      FramesCallback framesCallback_;
+      ErrorCallback errorCallback_;
+    };
+
+  } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_CODEC_LENGTHFIELDCODEC_H
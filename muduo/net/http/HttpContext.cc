@@ -90,8 +90,8 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
       const char* crlf = buf->findCRLF();
       if (crlf)
       {
-        const char* colon = std::find(buf->peek(), crlf, ':');
-        if (colon != crlf)
+        const char* colon = static_cast<const char*>(memchr(buf->peek(), ':', crlf - buf->peek()));
+        if (colon)
         {
           request_.addHeader(buf->peek(), colon, crlf);
         }
@@ -0,0 +1,109 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/PreforkInspector.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/net/EventLoop.h"
+
+#include <sys/wait.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace muduo
+{
+namespace inspect
+{
+string uptime(Timestamp now, Timestamp start, bool showMicroseconds);
+int stringPrintf(string* out, const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
+}
+}
+
+using namespace muduo::inspect;
+
+PreforkInspector::PreforkInspector(PreforkServer* server)
+  : server_(server)
+{
+}
+
+void PreforkInspector::registerCommands(Inspector* ins)
+{
+  ins->add("prefork", "overview", std::bind(&PreforkInspector::overview, this, _1, _2),
+           "print totals of all workers");
+  ins->add("prefork", "workers", std::bind(&PreforkInspector::workers, this, _1, _2),
+           "print each worker");
+}
+
+std::vector<PreforkServer::WorkerStats> PreforkInspector::workerStats()
+{
+  EventLoop* loop = server_->getLoop();
+  if (loop->isInLoopThread())
+  {
+    return server_->workerStats();
+  }
+  std::vector<PreforkServer::WorkerStats> stats;
+  CountDownLatch latch(1);
+  loop->runInLoop([this, &stats, &latch] {
+    stats = server_->workerStats();
+    latch.countDown();
+  });
+  latch.wait();
+  return stats;
+}
+
+string PreforkInspector::overview(HttpRequest::Method, const Inspector::ArgList&)
+{
+  std::vector<PreforkServer::WorkerStats> stats = workerStats();
+  int running = 0, restarts = 0, connections = 0;
+  double cpuSeconds = 0;
+  int64_t rssBytes = 0;
+  for (const PreforkServer::WorkerStats& worker : stats)
+  {
+    running += worker.pid > 0 ? 1 : 0;
+    restarts += worker.restarts;
+    connections += worker.connections;
+    cpuSeconds += worker.cpuSeconds;
+    rssBytes += worker.rssBytes;
+  }
+  string result;
+  stringPrintf(&result, "%s: %d of %zd workers running, %d restarts\n",
+               server_->name().c_str(), running, stats.size(), restarts);
+  stringPrintf(&result, "connections %d\n", connections);
+  stringPrintf(&result, "CPU time %.3f s\n", cpuSeconds);
+  stringPrintf(&result, "RSS memory %.3f MiB\n", static_cast<double>(rssBytes) / 1024.0 / 1024.0);
+  return result;
+}
+
+string PreforkInspector::workers(HttpRequest::Method, const Inspector::ArgList&)
+{
+  std::vector<PreforkServer::WorkerStats> stats = workerStats();
+  Timestamp now = Timestamp::now();
+  string result = "index     pid restarts connections  cpu(s)  rss(MiB) uptime / last exit\n";
+  for (const PreforkServer::WorkerStats& worker : stats)
+  {
+    stringPrintf(&result, "%5d %7d %8d %11d %7.2f %9.3f ",
+                 worker.index, worker.pid, worker.restarts, worker.connections,
+                 worker.cpuSeconds, static_cast<double>(worker.rssBytes) / 1024.0 / 1024.0);
+    if (worker.pid > 0)
+    {
+      result += uptime(now, worker.started, false);
+    }
+    else if (WIFSIGNALED(worker.lastExitStatus))
+    {
+      stringPrintf(&result, "signal %d", WTERMSIG(worker.lastExitStatus));
+    }
+    else
+    {
+      stringPrintf(&result, "exit %d", WEXITSTATUS(worker.lastExitStatus));
+    }
+    result += "\n";
+  }
+  return result;
+}
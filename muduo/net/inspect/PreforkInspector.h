@@ -0,0 +1,44 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_INSPECT_PREFORKINSPECTOR_H
+#define MUDUO_NET_INSPECT_PREFORKINSPECTOR_H
+
+#include "muduo/net/inspect/Inspector.h"
+#include "muduo/net/PreforkServer.h"
+
+namespace muduo
+{
+namespace net
+{
+
+// Workers of a PreforkServer, in the Inspector of the master:
+// /prefork/overview sums them up, /prefork/workers lists them.
+class PreforkInspector : noncopyable
+{
+ public:
+  explicit PreforkInspector(PreforkServer* server);
+
+  void registerCommands(Inspector* ins);
+
+  string overview(HttpRequest::Method, const Inspector::ArgList&);
+  string workers(HttpRequest::Method, const Inspector::ArgList&);
+
+ private:
+  // in the loop of server_
+  std::vector<PreforkServer::WorkerStats> workerStats();
+
+  PreforkServer* server_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_PREFORKINSPECTOR_H
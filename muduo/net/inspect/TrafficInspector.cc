@@ -0,0 +1,150 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/TrafficInspector.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace muduo
+{
+namespace inspect
+{
+int stringPrintf(string* out, const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
+}
+}
+
+using namespace muduo::inspect;
+
+namespace
+{
+
+typedef int64_t (*Metric)(const TcpConnection::Traffic&);
+
+int64_t bytesIn(const TcpConnection::Traffic& t) { return t.bytesIn; }
+int64_t bytesOut(const TcpConnection::Traffic& t) { return t.bytesOut; }
+int64_t messagesIn(const TcpConnection::Traffic& t) { return t.messagesIn; }
+int64_t messagesOut(const TcpConnection::Traffic& t) { return t.messagesOut; }
+int64_t callback(const TcpConnection::Traffic& t) { return t.callbackMicroseconds; }
+int64_t inputHighWater(const TcpConnection::Traffic& t) { return static_cast<int64_t>(t.inputHighWater); }
+int64_t outputHighWater(const TcpConnection::Traffic& t) { return static_cast<int64_t>(t.outputHighWater); }
+
+Metric metricOf(const string& name)
+{
+  if (name == "out")
+    return bytesOut;
+  else if (name == "msgin")
+    return messagesIn;
+  else if (name == "msgout")
+    return messagesOut;
+  else if (name == "callback")
+    return callback;
+  else if (name == "inhw")
+    return inputHighWater;
+  else if (name == "outhw")
+    return outputHighWater;
+  return bytesIn;
+}
+
+double perSecond(int64_t delta, double seconds)
+{
+  return seconds > 0 ? static_cast<double>(delta) / seconds : 0.0;
+}
+
+}  // namespace
+
+TrafficInspector::TrafficInspector(const TcpServer* server, const string& module)
+  : server_(server),
+    module_(module)
+{
+  last_.when = Timestamp::now();
+}
+
+void TrafficInspector::registerCommands(Inspector* ins)
+{
+  ins->add(module_, "overview", std::bind(&TrafficInspector::overview, this, _1, _2),
+           "print traffic totals and rates of " + server_->name());
+  ins->add(module_, "top", std::bind(&TrafficInspector::top, this, _1, _2),
+           "print top connections by in, out, msgin, msgout, callback, inhw or outhw");
+}
+
+string TrafficInspector::overview(HttpRequest::Method, const Inspector::ArgList&)
+{
+  TcpServer::TrafficSnapshot snapshot = server_->trafficSnapshot();
+  TcpServer::TrafficSnapshot last;
+  {
+    MutexLockGuard lock(mutex_);
+    last.when = last_.when;
+    last.total = last_.total;
+    last_.when = snapshot.when;
+    last_.total = snapshot.total;
+  }
+  // rates since the previous overview, or since construction for the first one
+  double seconds = timeDifference(snapshot.when, last.when);
+  const TcpConnection::Traffic& t = snapshot.total;
+  const TcpConnection::Traffic& p = last.total;
+  string result;
+  stringPrintf(&result, "%s: %zd connections at %s, rates over %.3f seconds\n",
+               server_->name().c_str(), snapshot.connections.size(),
+               snapshot.when.toFormattedString().c_str(), seconds);
+  stringPrintf(&result, "%-12s %16s %16s\n", "", "total", "per second");
+  stringPrintf(&result, "%-12s %16lld %16.1f\n", "bytes in",
+               static_cast<long long>(t.bytesIn), perSecond(t.bytesIn - p.bytesIn, seconds));
+  stringPrintf(&result, "%-12s %16lld %16.1f\n", "bytes out",
+               static_cast<long long>(t.bytesOut), perSecond(t.bytesOut - p.bytesOut, seconds));
+  stringPrintf(&result, "%-12s %16lld %16.1f\n", "messages in",
+               static_cast<long long>(t.messagesIn), perSecond(t.messagesIn - p.messagesIn, seconds));
+  stringPrintf(&result, "%-12s %16lld %16.1f\n", "messages out",
+               static_cast<long long>(t.messagesOut), perSecond(t.messagesOut - p.messagesOut, seconds));
+  stringPrintf(&result, "%-12s %16lld %16.1f\n", "callback(us)",
+               static_cast<long long>(t.callbackMicroseconds),
+               perSecond(t.callbackMicroseconds - p.callbackMicroseconds, seconds));
+  stringPrintf(&result, "input high water %zd, output high water %zd\n",
+               t.inputHighWater, t.outputHighWater);
+  return result;
+}
+
+string TrafficInspector::top(HttpRequest::Method, const Inspector::ArgList& args)
+{
+  Metric metric = metricOf(args.empty() ? "in" : args[0]);
+  size_t n = 10;
+  if (args.size() > 1)
+  {
+    int count = atoi(args[1].c_str());
+    n = count > 0 ? static_cast<size_t>(count) : n;
+  }
+  TcpServer::TrafficSnapshot snapshot = server_->trafficSnapshot();
+  std::vector<TcpServer::ConnectionTraffic>& conns = snapshot.connections;
+  n = std::min(n, conns.size());
+  std::partial_sort(conns.begin(), conns.begin() + n, conns.end(),
+                    [metric](const TcpServer::ConnectionTraffic& lhs,
+                             const TcpServer::ConnectionTraffic& rhs)
+                    { return metric(lhs.traffic) > metric(rhs.traffic); });
+
+  string result;
+  stringPrintf(&result, "%14s %14s %10s %10s %12s %10s %10s %8s  %s\n",
+               "in", "out", "msgin", "msgout", "callback(us)", "inhw", "outhw", "age(s)",
+               "connection");
+  for (size_t i = 0; i < n; ++i)
+  {
+    const TcpConnection::Traffic& t = conns[i].traffic;
+    stringPrintf(&result, "%14lld %14lld %10lld %10lld %12lld %10zd %10zd %8.1f  %s-%s#%lld\n",
+                 static_cast<long long>(t.bytesIn), static_cast<long long>(t.bytesOut),
+                 static_cast<long long>(t.messagesIn), static_cast<long long>(t.messagesOut),
+                 static_cast<long long>(t.callbackMicroseconds),
+                 t.inputHighWater, t.outputHighWater,
+                 timeDifference(snapshot.when, t.since), server_->name().c_str(),
+                 server_->ipPort().c_str(), static_cast<long long>(conns[i].id));
+  }
+  return result;
+}
@@ -0,0 +1,47 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_INSPECT_TRAFFICINSPECTOR_H
+#define MUDUO_NET_INSPECT_TRAFFICINSPECTOR_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/inspect/Inspector.h"
+
+namespace muduo
+{
+namespace net
+{
+
+// Per connection traffic of a TcpServer, see TcpConnection::Traffic:
+// /connections/overview prints totals and rates since the previous overview.
+// /connections/top/{in,out,msgin,msgout,callback,inhw,outhw}/N prints
+// the top N connections, 10 by default.
+class TrafficInspector : noncopyable
+{
+ public:
+  explicit TrafficInspector(const TcpServer* server, const string& module = "connections");
+
+  void registerCommands(Inspector* ins);
+
+  string overview(HttpRequest::Method, const Inspector::ArgList&);
+  string top(HttpRequest::Method, const Inspector::ArgList& args);
+
+ private:
+  const TcpServer* server_;
+  const string module_;
+  MutexLock mutex_;
+  TcpServer::TrafficSnapshot last_ GUARDED_BY(mutex_);  // of the previous overview
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_TRAFFICINSPECTOR_H
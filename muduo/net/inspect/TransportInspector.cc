@@ -0,0 +1,101 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/TransportInspector.h"
+
+#include "muduo/net/TcpServer.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace muduo
+{
+namespace inspect
+{
+int stringPrintf(string* out, const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
+}
+}
+
+using namespace muduo::inspect;
+
+namespace
+{
+
+void printHistogram(string* out, const char* name, const Log2Histogram& h)
+{
+  stringPrintf(out, "%-14s %12.1f %12llu %12llu %12llu %12llu\n",
+               name, h.mean(),
+               static_cast<unsigned long long>(h.percentile(0.5)),
+               static_cast<unsigned long long>(h.percentile(0.9)),
+               static_cast<unsigned long long>(h.percentile(0.99)),
+               static_cast<unsigned long long>(h.max()));
+}
+
+}  // namespace
+
+TransportInspector::TransportInspector(const TcpServer* server, const string& module)
+  : server_(server),
+    module_(module)
+{
+}
+
+void TransportInspector::registerCommands(Inspector* ins)
+{
+  ins->add(module_, "overview", std::bind(&TransportInspector::overview, this, _1, _2),
+           "print histograms of TCP_INFO of " + server_->name());
+  ins->add(module_, "worst", std::bind(&TransportInspector::worst, this, _1, _2),
+           "print worst connections by rtt, retrans, unacked or output");
+}
+
+string TransportInspector::overview(HttpRequest::Method, const Inspector::ArgList&)
+{
+  TransportStats stats = server_->transportStats();
+  string result;
+  stringPrintf(&result, "%s: %d connections sampled at %s\n",
+               server_->name().c_str(), stats.connections,
+               stats.sampled.toFormattedString().c_str());
+  stringPrintf(&result, "%-14s %12s %12s %12s %12s %12s\n",
+               "", "mean", "p50", "p90", "p99", "max");
+  printHistogram(&result, "rtt(us)", stats.rtt);
+  printHistogram(&result, "cwnd", stats.cwnd);
+  printHistogram(&result, "unacked", stats.unacked);
+  printHistogram(&result, "retrans", stats.totalRetrans);
+  printHistogram(&result, "delivery(B/s)", stats.deliveryRate);
+  printHistogram(&result, "output(B)", stats.outputBytes);
+  return result;
+}
+
+string TransportInspector::worst(HttpRequest::Method, const Inspector::ArgList& args)
+{
+  TransportStats::SortKey key = TransportStats::kByOutputBytes;
+  if (!args.empty())
+  {
+    if (args[0] == "rtt")
+      key = TransportStats::kByRtt;
+    else if (args[0] == "retrans")
+      key = TransportStats::kByRetrans;
+    else if (args[0] == "unacked")
+      key = TransportStats::kByUnacked;
+  }
+  TransportStats stats = server_->transportStats();
+  stats.sortWorst(key, stats.worst.size());
+  string result;
+  stringPrintf(&result, "%8s %8s %6s %8s %8s %12s %10s %12s  %s\n",
+               "rtt(us)", "rttvar", "cwnd", "unacked", "retrans",
+               "delivery", "notsent", "output", "connection");
+  for (const TransportSample& sample : stats.worst)
+  {
+    stringPrintf(&result, "%8u %8u %6u %8u %8u %12llu %10u %12zu  %s\n",
+                 sample.rtt, sample.rttVar, sample.cwnd, sample.unacked,
+                 sample.totalRetrans,
+                 static_cast<unsigned long long>(sample.deliveryRate),
+                 sample.notsentBytes, sample.outputBytes, sample.name.c_str());
+  }
+  return result;
+}
@@ -0,0 +1,45 @@
+// Copyright 2014, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_INSPECT_TRANSPORTINSPECTOR_H
+#define MUDUO_NET_INSPECT_TRANSPORTINSPECTOR_H
+
+#include "muduo/net/inspect/Inspector.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class TcpServer;
+
+// TCP_INFO of the connections of a TcpServer, sampled by
+// TcpServer::setTransportSampling():
+// /transport/overview prints histograms of RTT, cwnd, retransmits, etc.
+// /transport/worst/{rtt,retrans,unacked,output} prints the worst connections.
+class TransportInspector : noncopyable
+{
+ public:
+  explicit TransportInspector(const TcpServer* server, const string& module = "transport");
+
+  void registerCommands(Inspector* ins);
+
+  string overview(HttpRequest::Method, const Inspector::ArgList&);
+  string worst(HttpRequest::Method, const Inspector::ArgList& args);
+
+ private:
+  const TcpServer* server_;
+  const string module_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_TRANSPORTINSPECTOR_H
@@ -7,8 +7,10 @@
 // Author: Shuo Chen (chenshuo at chenshuo dot com)
 
 #include "muduo/net/Poller.h"
+#include "muduo/net/SimNetwork.h"
 #include "muduo/net/poller/PollPoller.h"
 #include "muduo/net/poller/EPollPoller.h"
+#include "muduo/net/poller/SimPoller.h"
 
 #include <stdlib.h>
 
@@ -16,7 +18,11 @@ using namespace muduo::net;
 
 Poller *Poller::newDefaultPoller(EventLoop *loop)
 {
-  if (::getenv("MUDUO_USE_POLL"))
+  if (SimNetwork *net = SimNetwork::current())
+  {
+    return new SimPoller(loop, net);
+  }
+  else if (::getenv("MUDUO_USE_POLL"))
   {
     return new PollPoller(loop);
   }
@@ -93,13 +93,16 @@ void EPollPoller::fillActiveChannels(int numEvents,
 
   for (int i = 0; i < numEvents; ++i)
   {
-    Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
-#ifndef NDEBUG
-    int fd = channel->fd();
-    ChannelMap::const_iterator it = channels_.find(fd);
-    assert(it != channels_.end());
-    assert(it->second == channel);
-#endif
+    // see update() for the tag
+    uint64_t tag = events_[i].data.u64;
+    int fd = static_cast<int>(tag & 0xFFFFFFFF);
+    Channel *channel = channels_.find(fd, static_cast<uint32_t>(tag >> 32));
+    if (channel == NULL)
+    {
+      LOG_WARN << "EPollPoller::fillActiveChannels stale event of fd " << fd;
+      continue;
+    }
+    assert(channel->fd() == fd);
     channel->set_revents(events_[i].events);
     activeChannels->push_back(channel);
   }
@@ -118,13 +121,12 @@ void EPollPoller::updateChannel(Channel *channel)
     int fd = channel->fd();
     if (index == kNew)
     {
-      assert(channels_.find(fd) == channels_.end());
-      channels_[fd] = channel;
+      assert(channels_.find(fd) == NULL);
+      channels_.add(fd, channel);
     }
     else // index == kDeleted
     {
-      assert(channels_.find(fd) != channels_.end());
-      assert(channels_[fd] == channel);
+      assert(channels_.find(fd) == channel);
     }
 
     channel->set_index(kAdded);
@@ -135,8 +137,7 @@ void EPollPoller::updateChannel(Channel *channel)
     // update existing one with EPOLL_CTL_MOD/DEL
     int fd = channel->fd();
     (void)fd;
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(channels_.find(fd) == channel);
     assert(index == kAdded);
     
     if (channel->isNoneEvent())
@@ -156,20 +157,17 @@ void EPollPoller::removeChannel(Channel *channel)
   Poller::assertInLoopThread();
   int fd = channel->fd();
   LOG_TRACE << "fd = " << fd;
-  assert(channels_.find(fd) != channels_.end());
-  assert(channels_[fd] == channel);
+  assert(channels_.find(fd) == channel);
   assert(channel->isNoneEvent());
   
   int index = channel->index();
   assert(index == kAdded || index == kDeleted);
-  size_t n = channels_.erase(fd);
-  (void)n;
-  assert(n == 1);
 
   if (index == kAdded)
   {
     update(EPOLL_CTL_DEL, channel);
   }
+  channels_.remove(fd);
   channel->set_index(kNew);
 }
 
@@ -178,8 +176,14 @@ void EPollPoller::update(int operation, Channel *channel)
   struct epoll_event event;
   memZero(&event, sizeof event);
   event.events = channel->events();
-  event.data.ptr = channel;
+  if (channel->exclusive() && operation == EPOLL_CTL_ADD)
+  {
+    // EPOLLPRI is not allowed with it
+    event.events = (event.events & (EPOLLIN | EPOLLOUT)) | EPOLLEXCLUSIVE;
+  }
   int fd = channel->fd();
+  // (generation, fd) instead of Channel*, so a stale event can't reach a freed Channel
+  event.data.u64 = static_cast<uint64_t>(channels_.generation(fd)) << 32 | static_cast<uint32_t>(fd);
   LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
             << " fd = " << fd << " event = { " << channel->eventsToString() << " }";
   
@@ -61,10 +61,8 @@ void PollPoller::fillActiveChannels(int numEvents,
         if (pfd->revents > 0)
         {
             --numEvents;
-            ChannelMap::const_iterator ch = channels_.find(pfd->fd);
-            assert(ch != channels_.end());
-
-            Channel *channel = ch->second;
+            Channel *channel = channels_.find(pfd->fd);
+            assert(channel != NULL);
             assert(channel->fd() == pfd->fd);
 
             channel->set_revents(pfd->revents);
@@ -83,7 +81,7 @@ void PollPoller::updateChannel(Channel *channel)
     {
         // index < 0说明是一个新的通道
         // a new one, add to pollfds_
-        assert(channels_.find(channel->fd()) == channels_.end());
+        assert(channels_.find(channel->fd()) == NULL);
 
         struct pollfd pfd;
         pfd.fd = channel->fd();
@@ -93,14 +91,12 @@ void PollPoller::updateChannel(Channel *channel)
 
         int idx = static_cast<int>(pollfds_.size()) - 1;
         channel->set_index(idx);
-        channels_[pfd.fd] = channel;
+        channels_.add(pfd.fd, channel);
     }
     else
     {
         // update existing one
-        assert(channels_.find(channel->fd()) != channels_.end());
-        assert(channels_[channel->fd()] == channel);
-
+        assert(channels_.find(channel->fd()) == channel);
         int idx = channel->index();
         assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
 
@@ -126,8 +122,7 @@ void PollPoller::removeChannel(Channel *channel)
 {
     Poller::assertInLoopThread();
     LOG_TRACE << "fd = " << channel->fd();
-    assert(channels_.find(channel->fd()) != channels_.end());
-    assert(channels_[channel->fd()] == channel);
+    assert(channels_.find(channel->fd()) == channel);
     assert(channel->isNoneEvent());
 
     int idx = channel->index();
@@ -137,9 +132,7 @@ void PollPoller::removeChannel(Channel *channel)
     (void)pfd;
     assert(pfd.fd == -channel->fd() - 1 && pfd.events == channel->events());
 
-    size_t n = channels_.erase(channel->fd());
-    assert(n == 1);
-    (void)n;
+    channels_.remove(channel->fd());
     if (implicit_cast<size_t>(idx) == pollfds_.size() - 1) // 最后一个直接pop_back
     {
         pollfds_.pop_back();
@@ -153,7 +146,7 @@ void PollPoller::removeChannel(Channel *channel)
         {
             channelAtEnd = -channelAtEnd - 1; // 还原
         }
-        channels_[channelAtEnd]->set_index(idx);
+        channels_.find(channelAtEnd)->set_index(idx);
         pollfds_.pop_back();
     }
 }
@@ -0,0 +1,121 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/poller/SimPoller.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/SimNetwork.h"
+
+#include <vector>
+
+#include <assert.h>
+#include <poll.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+  const int kNew = -1;
+  const int kAdded = 1;
+  // a wait without timeout would never end, nobody else moves the clock
+  const int kMaxWaitMs = 10000;
+}
+
+SimPoller::SimPoller(EventLoop *loop, SimNetwork *net)
+    : Poller(loop),
+      net_(net)
+{
+}
+
+SimPoller::~SimPoller() = default;
+
+Timestamp SimPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+  Timestamp deadline = addTime(net_->now(), (timeoutMs < 0 ? kMaxWaitMs : timeoutMs) / 1000.0);
+  fillActiveChannels(activeChannels);
+  while (activeChannels->empty() && net_->now() < deadline)
+  {
+    Timestamp next = net_->nextEvent();
+    net_->advanceTo(next.valid() && next < deadline ? next : deadline);
+    fillActiveChannels(activeChannels);
+  }
+  LOG_TRACE << activeChannels->size() << " events happened";
+  return net_->now();
+}
+
+void SimPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+  std::vector<struct pollfd> others;
+  for (int fd : fds_)
+  {
+    Channel *channel = channels_.find(fd);
+    if (channel->isNoneEvent())
+    {
+      continue;
+    }
+    if (net_->owns(fd))
+    {
+      int revents = net_->events(fd) & (channel->events() | POLLERR | POLLHUP);
+      if (revents)
+      {
+        channel->set_revents(revents);
+        activeChannels->push_back(channel);
+      }
+    }
+    else
+    {
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = static_cast<short>(channel->events());
+      pfd.revents = 0;
+      others.push_back(pfd);
+    }
+  }
+  if (!others.empty() && ::poll(&*others.begin(), others.size(), 0) > 0)
+  {
+    for (const struct pollfd &pfd : others)
+    {
+      if (pfd.revents)
+      {
+        Channel *channel = channels_.find(pfd.fd);
+        channel->set_revents(pfd.revents);
+        activeChannels->push_back(channel);
+      }
+    }
+  }
+}
+
+void SimPoller::updateChannel(Channel *channel)
+{
+  Poller::assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+  if (channel->index() == kNew)
+  {
+    assert(channels_.find(channel->fd()) == NULL);
+    channels_.add(channel->fd(), channel);
+    fds_.insert(channel->fd());
+    channel->set_index(kAdded);
+  }
+  else
+  {
+    assert(channels_.find(channel->fd()) == channel);
+  }
+}
+
+void SimPoller::removeChannel(Channel *channel)
+{
+  Poller::assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd();
+  assert(channels_.find(channel->fd()) == channel);
+  assert(channel->isNoneEvent());
+  channels_.remove(channel->fd());
+  fds_.erase(channel->fd());
+  channel->set_index(kNew);
+}
@@ -0,0 +1,51 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_POLLER_SIMPOLLER_H
+#define MUDUO_NET_POLLER_SIMPOLLER_H
+
+#include "muduo/net/Poller.h"
+
+#include <set>
+
+namespace muduo
+{
+  namespace net
+  {
+
+    class SimNetwork;
+
+    ///
+    /// IO Multiplexing over a SimNetwork.
+    ///
+    /// Instead of sleeping, poll() moves the virtual clock to the next
+    /// arrival, or to the timeout. Other fds, eg. the wakeup eventfd,
+    /// are checked with poll(2) but never waited for.
+    class SimPoller : public Poller
+    {
+    public:
+      SimPoller(EventLoop *loop, SimNetwork *net);
+      ~SimPoller() override;
+
+      Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+      void updateChannel(Channel *channel) override;
+      void removeChannel(Channel *channel) override;
+      bool virtualClock() const override { return true; }
+
+    private:
+      void fillActiveChannels(ChannelList *activeChannels);
+
+      SimNetwork *net_;
+      std::set<int> fds_;  // ordered, so are the active channels
+    };
+
+  } // namespace net
+} // namespace muduo
+#endif // MUDUO_NET_POLLER_SIMPOLLER_H
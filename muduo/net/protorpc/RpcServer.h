@@ -13,6 +13,8 @@
 
 #include "muduo/net/TcpServer.h"
 
+#include <map>
+
 namespace google {
 namespace protobuf {
 
@@ -0,0 +1,161 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/shm/ShmClient.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+ShmClient::ShmClient(EventLoop* loop, const string& path, const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    path_(path),
+    name_(nameArg),
+    sockfd_(-1),
+    connectionCallback_([](const ShmConnectionPtr&) {}),
+    messageCallback_([](const ShmConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); })
+{
+}
+
+ShmClient::~ShmClient()
+{
+  loop_->assertInLoopThread();
+  closeHandshakeSocket();
+  ShmConnectionPtr conn;
+  {
+    MutexLockGuard lock(mutex_);
+    conn.swap(connection_);
+  }
+  if (conn)
+  {
+    // its close callback refers to us
+    conn->setCloseCallback([](const ShmConnectionPtr&) {});
+    conn->connectDestroyed();
+  }
+}
+
+void ShmClient::connect()
+{
+  loop_->runInLoop(std::bind(&ShmClient::connectInLoop, this));
+}
+
+void ShmClient::connectInLoop()
+{
+  loop_->assertInLoopThread();
+  if (sockfd_ >= 0 || connection())
+  {
+    LOG_WARN << "ShmClient::connect [" << name_ << "] already connected";
+    return;
+  }
+  struct sockaddr_un addr;
+  memZero(&addr, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof addr.sun_path)
+  {
+    LOG_ERROR << "ShmClient path too long " << path_;
+    return;
+  }
+  memcpy(addr.sun_path, path_.c_str(), path_.size());
+  sockfd_ = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (sockfd_ < 0)
+  {
+    LOG_SYSERR << "ShmClient::connect socket";
+    return;
+  }
+  // a Unix socket connects at once, or fails with EAGAIN on a full backlog
+  if (::connect(sockfd_, reinterpret_cast<struct sockaddr*>(&addr), static_cast<socklen_t>(sizeof addr)) < 0)
+  {
+    LOG_SYSERR << "ShmClient::connect " << path_;
+    sockets::close(sockfd_);
+    sockfd_ = -1;
+    return;
+  }
+  handshakeChannel_.reset(new Channel(loop_, sockfd_));
+  handshakeChannel_->setReadCallback(std::bind(&ShmClient::handleHandshake, this));
+  handshakeChannel_->enableReading();
+}
+
+void ShmClient::removeHandshakeChannel()
+{
+  handshakeChannel_->disableAll();
+  handshakeChannel_->remove();
+  // we may be in its handleEvent(), free it after, as Connector does
+  std::shared_ptr<Channel> channel(std::move(handshakeChannel_));
+  loop_->queueInLoop([channel] {});
+}
+
+void ShmClient::closeHandshakeSocket()
+{
+  if (handshakeChannel_)
+  {
+    removeHandshakeChannel();
+  }
+  if (sockfd_ >= 0)
+  {
+    sockets::close(sockfd_);
+    sockfd_ = -1;
+  }
+}
+
+void ShmClient::handleHandshake()
+{
+  loop_->assertInLoopThread();
+  ShmConnection::Handshake hs;
+  if (!ShmConnection::recvHandshake(sockfd_, &hs))
+  {
+    if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "ShmClient::handleHandshake " << path_;
+      closeHandshakeSocket();
+    }
+    return;
+  }
+  // the connection takes the socket over, with its own Channel
+  removeHandshakeChannel();
+  int sockfd = sockfd_;
+  sockfd_ = -1;
+
+  ShmConnectionPtr conn(new ShmConnection(loop_, name_ + "#1", sockfd, hs, false));
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(std::bind(&ShmClient::removeConnection, this, _1));  // FIXME: unsafe
+  {
+    MutexLockGuard lock(mutex_);
+    connection_ = conn;
+  }
+  conn->connectEstablished();
+}
+
+void ShmClient::disconnect()
+{
+  ShmConnectionPtr conn = connection();
+  if (conn)
+  {
+    conn->shutdown();
+  }
+}
+
+void ShmClient::removeConnection(const ShmConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  {
+    MutexLockGuard lock(mutex_);
+    assert(connection_ == conn);
+    connection_.reset();
+  }
+  loop_->queueInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+}
@@ -0,0 +1,75 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SHM_SHMCLIENT_H
+#define MUDUO_NET_SHM_SHMCLIENT_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/shm/ShmConnection.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Client of ShmServer, one ShmConnection at a time.
+///
+class ShmClient : noncopyable
+{
+ public:
+  ShmClient(EventLoop* loop, const string& path, const string& nameArg);
+  ~ShmClient();  // force out-line dtor, for std::unique_ptr members.
+
+  /// Connects to the Unix socket at path, the connection callback tells
+  /// once the rings are set up.
+  /// Thread safe.
+  void connect();
+  /// Shuts the connection down.
+  /// Thread safe.
+  void disconnect();
+
+  ShmConnectionPtr connection() const
+  {
+    MutexLockGuard lock(mutex_);
+    return connection_;
+  }
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+
+  /// Not thread safe, set before connect()
+  void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+  void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const ShmWriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+
+ private:
+  void connectInLoop();
+  void handleHandshake();
+  void removeHandshakeChannel();
+  void closeHandshakeSocket();
+  void removeConnection(const ShmConnectionPtr& conn);
+
+  EventLoop* loop_;
+  const string path_;
+  const string name_;
+  int sockfd_;  // until the handshake is done
+  std::unique_ptr<Channel> handshakeChannel_;
+  ShmConnectionCallback connectionCallback_;
+  ShmMessageCallback messageCallback_;
+  ShmWriteCompleteCallback writeCompleteCallback_;
+  mutable MutexLock mutex_;
+  ShmConnectionPtr connection_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SHM_SHMCLIENT_H
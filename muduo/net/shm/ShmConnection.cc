@@ -0,0 +1,480 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/shm/ShmConnection.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <new>
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint32_t kMagic = 0x6d73686d;  // "mshm"
+const int kHandshakeFds = 3;
+// rounds of reading a busy peer before others have their turn
+const int kMaxReadRounds = 16;
+
+struct HandshakeMessage
+{
+  uint32_t magic;
+  uint32_t reserved;
+  uint64_t capacity;
+};
+
+size_t roundUpToPowerOf2(size_t n)
+{
+  size_t capacity = 4096;
+  while (capacity < n)
+  {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+}  // namespace
+
+bool ShmConnection::createShared(size_t capacity, Handshake* hs)
+{
+  hs->capacity = roundUpToPowerOf2(capacity);
+  hs->memfd = ::memfd_create("muduo-shm", MFD_CLOEXEC);
+  hs->serverWakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  hs->clientWakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (hs->memfd < 0 || hs->serverWakeFd < 0 || hs->clientWakeFd < 0 ||
+      ::ftruncate(hs->memfd, static_cast<off_t>(2 * ShmRing::bytesFor(hs->capacity))) < 0)
+  {
+    LOG_SYSERR << "ShmConnection::createShared";
+    closeHandshake(*hs);
+    return false;
+  }
+  return true;
+}
+
+bool ShmConnection::sendHandshake(int sockfd, const Handshake& hs)
+{
+  HandshakeMessage message = { kMagic, 0, hs.capacity };
+  struct iovec iov;
+  iov.iov_base = &message;
+  iov.iov_len = sizeof message;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * kHandshakeFds)];
+  } control;
+  memZero(&control, sizeof control);
+  struct msghdr msg;
+  memZero(&msg, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * kHandshakeFds);
+  int fds[kHandshakeFds] = { hs.memfd, hs.serverWakeFd, hs.clientWakeFd };
+  memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
+  if (::sendmsg(sockfd, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof message))
+  {
+    LOG_SYSERR << "ShmConnection::sendHandshake";
+    return false;
+  }
+  return true;
+}
+
+bool ShmConnection::recvHandshake(int sockfd, Handshake* hs)
+{
+  HandshakeMessage message;
+  memZero(&message, sizeof message);
+  struct iovec iov;
+  iov.iov_base = &message;
+  iov.iov_len = sizeof message;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * kHandshakeFds)];
+  } control;
+  struct msghdr msg;
+  memZero(&msg, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+  ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+  if (n < 0)
+  {
+    return false;
+  }
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+      cmsg->cmsg_len == CMSG_LEN(sizeof(int) * kHandshakeFds))
+  {
+    int fds[kHandshakeFds];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof fds);
+    hs->memfd = fds[0];
+    hs->serverWakeFd = fds[1];
+    hs->clientWakeFd = fds[2];
+  }
+  hs->capacity = static_cast<size_t>(message.capacity);
+  if (n != static_cast<ssize_t>(sizeof message) || message.magic != kMagic ||
+      hs->memfd < 0 || hs->capacity == 0 || (hs->capacity & (hs->capacity - 1)) != 0)
+  {
+    LOG_ERROR << "ShmConnection::recvHandshake bad handshake";
+    closeHandshake(*hs);
+    errno = EPROTO;
+    return false;
+  }
+  return true;
+}
+
+void ShmConnection::closeHandshake(const Handshake& hs)
+{
+  int fds[kHandshakeFds] = { hs.memfd, hs.serverWakeFd, hs.clientWakeFd };
+  for (int fd : fds)
+  {
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+  }
+}
+
+ShmConnection::ShmConnection(EventLoop* loop, const string& nameArg, int sockfd,
+                             const Handshake& hs, bool server)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(nameArg),
+    state_(kConnecting),
+    sockfd_(sockfd),
+    wakeFd_(server ? hs.serverWakeFd : hs.clientWakeFd),
+    peerWakeFd_(server ? hs.clientWakeFd : hs.serverWakeFd),
+    base_(NULL),
+    mapped_(2 * ShmRing::bytesFor(hs.capacity)),
+    capacity_(hs.capacity),
+    socketChannel_(loop, sockfd),
+    wakeChannel_(loop, wakeFd_),
+    wakeupsSent_(0)
+{
+  base_ = ::mmap(NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, hs.memfd, 0);
+  ::close(hs.memfd);
+  if (base_ == MAP_FAILED)
+  {
+    LOG_SYSFATAL << "ShmConnection::ShmConnection mmap";
+  }
+  char* ring0 = static_cast<char*>(base_);
+  char* ring1 = ring0 + ShmRing::bytesFor(capacity_);
+  if (server)
+  {
+    // a fresh memfd is zeros, construct the atomics before the client uses them
+    new (ring0) ShmRing::Header();
+    new (ring1) ShmRing::Header();
+  }
+  // ring0 from server to client, ring1 the other way
+  tx_ = ShmRing(server ? ring0 : ring1, capacity_);
+  rx_ = ShmRing(server ? ring1 : ring0, capacity_);
+  socketChannel_.setReadCallback(std::bind(&ShmConnection::handleSocket, this, _1));
+  socketChannel_.setCloseCallback(std::bind(&ShmConnection::handleClose, this));
+  wakeChannel_.setReadCallback(std::bind(&ShmConnection::handleWake, this, _1));
+  LOG_DEBUG << "ShmConnection::ctor[" << name_ << "] at " << this << " fd=" << sockfd;
+}
+
+ShmConnection::~ShmConnection()
+{
+  LOG_DEBUG << "ShmConnection::dtor[" << name_ << "] at " << this << " fd=" << sockfd_;
+  assert(state_ == kDisconnected);
+  ::munmap(base_, mapped_);
+  sockets::close(sockfd_);
+  ::close(wakeFd_);
+  ::close(peerWakeFd_);
+}
+
+void ShmConnection::send(const void* data, int len)
+{
+  send(StringPiece(static_cast<const char*>(data), len));
+}
+
+void ShmConnection::send(const StringPiece& message)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(message);
+    }
+    else
+    {
+      void (ShmConnection::*fp)(const StringPiece& message) = &ShmConnection::sendInLoop;
+      loop_->runInLoop(std::bind(fp, shared_from_this(), message.as_string()));
+    }
+  }
+}
+
+void ShmConnection::send(Buffer* buf)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
+    }
+    else
+    {
+      void (ShmConnection::*fp)(const StringPiece& message) = &ShmConnection::sendInLoop;
+      loop_->runInLoop(std::bind(fp, shared_from_this(), buf->retrieveAllAsString()));
+    }
+  }
+}
+
+void ShmConnection::sendInLoop(const StringPiece& message)
+{
+  sendInLoop(message.data(), message.size());
+}
+
+void ShmConnection::sendInLoop(const void* data, size_t len)
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return;
+  }
+  size_t written = 0;
+  if (outputBuffer_.readableBytes() == 0)
+  {
+    written = tx_.write(static_cast<const char*>(data), len);
+    if (written > 0 && tx_.takeReaderWaiting())
+    {
+      wakePeer();
+    }
+    if (written == len && writeCompleteCallback_)
+    {
+      loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+  }
+  if (written < len)
+  {
+    // the ring is full, the peer wakes us up once it reads
+    bool wasEmpty = outputBuffer_.readableBytes() == 0;
+    outputBuffer_.append(static_cast<const char*>(data) + written, len - written);
+    if (wasEmpty && !tx_.sleepIfFull())
+    {
+      flushOutput();
+    }
+  }
+}
+
+void ShmConnection::flushOutput()
+{
+  while (outputBuffer_.readableBytes() > 0)
+  {
+    size_t n = tx_.write(outputBuffer_.peek(), outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(n);
+    if (n > 0 && tx_.takeReaderWaiting())
+    {
+      wakePeer();
+    }
+    if (outputBuffer_.readableBytes() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      if (state_ == kDisconnecting)
+      {
+        shutdownInLoop();
+      }
+    }
+    else if (tx_.sleepIfFull())
+    {
+      break;
+    }
+  }
+}
+
+void ShmConnection::wakePeer()
+{
+  uint64_t one = 1;
+  ssize_t n = ::write(peerWakeFd_, &one, sizeof one);
+  if (n != sizeof one)
+  {
+    LOG_SYSERR << "ShmConnection::wakePeer";
+  }
+  ++wakeupsSent_;
+}
+
+void ShmConnection::handleWake(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  uint64_t count = 0;
+  ssize_t n = ::read(wakeFd_, &count, sizeof count);
+  if (n != sizeof count && errno != EAGAIN)
+  {
+    LOG_SYSERR << "ShmConnection::handleWake";
+  }
+  if (closeIfCorrupt())
+  {
+    return;
+  }
+  // space in tx_, or data in rx_, or both
+  flushOutput();
+  for (int i = 0; i < kMaxReadRounds; ++i)
+  {
+    if (closeIfCorrupt())
+    {
+      return;
+    }
+    if (rx_.readInto(&inputBuffer_) > 0)
+    {
+      if (rx_.takeWriterWaiting())
+      {
+        wakePeer();
+      }
+      messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    if (state_ == kDisconnected)
+    {
+      return;
+    }
+    if (rx_.readable() == 0 && rx_.closed())
+    {
+      // the peer shut down, as read(2) returning 0
+      handleClose();
+      return;
+    }
+    if (rx_.sleepIfEmpty())
+    {
+      return;
+    }
+  }
+  // a busy peer, come back after other channels had their turn
+  uint64_t one = 1;
+  if (::write(wakeFd_, &one, sizeof one) != sizeof one)
+  {
+    LOG_SYSERR << "ShmConnection::handleWake self wakeup";
+  }
+}
+
+bool ShmConnection::closeIfCorrupt()
+{
+  if (state_ == kDisconnected || (!rx_.corrupt() && !tx_.corrupt()))
+  {
+    return false;
+  }
+  LOG_ERROR << "ShmConnection::closeIfCorrupt [" << name_ << "] - ring positions out of bounds";
+  handleClose();
+  return true;
+}
+
+void ShmConnection::handleSocket(Timestamp)
+{
+  char buf[64];
+  ssize_t n = sockets::read(sockfd_, buf, sizeof buf);
+  if (n == 0 || (n < 0 && errno != EAGAIN))
+  {
+    // the peer is gone
+    handleClose();
+  }
+}
+
+void ShmConnection::handleClose()
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    return;
+  }
+  LOG_TRACE << name_ << " closed";
+  setState(kDisconnected);
+  // the peer sees the hangup now, not when the last ShmConnectionPtr goes
+  ::shutdown(sockfd_, SHUT_RDWR);
+  socketChannel_.disableAll();
+  wakeChannel_.disableAll();
+  ShmConnectionPtr guardThis(shared_from_this());
+  connectionCallback_(guardThis);
+  closeCallback_(guardThis);
+}
+
+void ShmConnection::shutdown()
+{
+  if (state_ == kConnected)
+  {
+    setState(kDisconnecting);
+    loop_->runInLoop(std::bind(&ShmConnection::shutdownInLoop, shared_from_this()));
+  }
+}
+
+void ShmConnection::shutdownInLoop()
+{
+  loop_->assertInLoopThread();
+  if (outputBuffer_.readableBytes() == 0 && !tx_.closed())
+  {
+    tx_.close();
+    if (tx_.takeReaderWaiting())
+    {
+      wakePeer();
+    }
+  }
+}
+
+void ShmConnection::forceClose()
+{
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    setState(kDisconnecting);
+    loop_->queueInLoop(std::bind(&ShmConnection::forceCloseInLoop, shared_from_this()));
+  }
+}
+
+void ShmConnection::forceCloseInLoop()
+{
+  loop_->assertInLoopThread();
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    handleClose();
+  }
+}
+
+void ShmConnection::connectEstablished()
+{
+  loop_->assertInLoopThread();
+  assert(state_ == kConnecting);
+  setState(kConnected);
+  socketChannel_.tie(shared_from_this());
+  wakeChannel_.tie(shared_from_this());
+  socketChannel_.enableReading();
+  wakeChannel_.enableReading();
+  connectionCallback_(shared_from_this());
+  // bytes sent before we got here
+  handleWake(Timestamp::now());
+}
+
+void ShmConnection::connectDestroyed()
+{
+  loop_->assertInLoopThread();
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    setState(kDisconnected);
+    socketChannel_.disableAll();
+    wakeChannel_.disableAll();
+    connectionCallback_(shared_from_this());
+  }
+  socketChannel_.remove();
+  wakeChannel_.remove();
+}
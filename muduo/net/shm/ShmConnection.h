@@ -0,0 +1,145 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SHM_SHMCONNECTION_H
+#define MUDUO_NET_SHM_SHMCONNECTION_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/shm/ShmRing.h"
+
+#include <functional>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class ShmConnection;
+
+typedef std::shared_ptr<ShmConnection> ShmConnectionPtr;
+typedef std::function<void (const ShmConnectionPtr&)> ShmConnectionCallback;
+typedef std::function<void (const ShmConnectionPtr&)> ShmCloseCallback;
+typedef std::function<void (const ShmConnectionPtr&)> ShmWriteCompleteCallback;
+typedef std::function<void (const ShmConnectionPtr&,
+                            Buffer*,
+                            Timestamp)> ShmMessageCallback;
+
+///
+/// A connection to a peer on the same host, through a pair of rings in
+/// shared memory, with the callbacks of TcpConnection.
+///
+/// Bytes go through the rings without system calls, the eventfd of a side
+/// is written only when it sleeps on an empty ring, or on a full one.
+/// The Unix socket of the handshake stays open, its hangup tells that
+/// the peer is gone. See ShmServer and ShmClient.
+///
+class ShmConnection : noncopyable,
+                      public std::enable_shared_from_this<ShmConnection>
+{
+ public:
+  /// internal, what ShmServer hands over to ShmClient through the Unix socket
+  struct Handshake
+  {
+    int memfd = -1;
+    int serverWakeFd = -1;
+    int clientWakeFd = -1;
+    size_t capacity = 0;  // of each ring
+  };
+  /// memfd of two rings of @c capacity, rounded up to a power of 2, and eventfds
+  static bool createShared(size_t capacity, Handshake* hs);
+  static bool sendHandshake(int sockfd, const Handshake& hs);
+  /// false with errno EAGAIN if it's not there yet
+  static bool recvHandshake(int sockfd, Handshake* hs);
+  static void closeHandshake(const Handshake& hs);
+
+  /// Takes sockfd and the eventfds of hs, memfd is mapped and closed.
+  ShmConnection(EventLoop* loop, const string& name, int sockfd,
+                const Handshake& hs, bool server);
+  ~ShmConnection();
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+  bool connected() const { return state_ == kConnected; }
+  bool disconnected() const { return state_ == kDisconnected; }
+  size_t ringCapacity() const { return capacity_; }
+
+  /// Thread safe.
+  void send(const void* message, int len);
+  void send(const StringPiece& message);
+  void send(Buffer* message);  // this one will swap data
+  void shutdown();  // NOT thread safe, no simultaneous calling
+  void forceClose();
+
+  void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+  void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const ShmWriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+  /// Internal use only.
+  void setCloseCallback(const ShmCloseCallback& cb) { closeCallback_ = cb; }
+
+  Buffer* inputBuffer() { return &inputBuffer_; }
+  Buffer* outputBuffer() { return &outputBuffer_; }
+
+  /// eventfd writes to wake the peer up, NOT thread safe, in loop
+  int64_t wakeupsSent() const { return wakeupsSent_; }
+
+  // called when ShmServer/ShmClient has a new connection
+  void connectEstablished();  // should be called only once
+  // called when ShmServer/ShmClient has removed me from its map
+  void connectDestroyed();  // should be called only once
+
+ private:
+  enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+  void handleWake(Timestamp receiveTime);
+  void handleSocket(Timestamp receiveTime);
+  void handleClose();
+  // closes if the peer broke a ring, see ShmRing::corrupt()
+  bool closeIfCorrupt();
+  void sendInLoop(const StringPiece& message);
+  void sendInLoop(const void* data, size_t len);
+  // moves outputBuffer_ to the ring, as far as it goes
+  void flushOutput();
+  void shutdownInLoop();
+  void forceCloseInLoop();
+  void wakePeer();
+  void setState(StateE s) { state_ = s; }
+
+  EventLoop* loop_;
+  const string name_;
+  StateE state_;  // FIXME: use atomic variable
+  const int sockfd_;
+  const int wakeFd_;      // written by the peer
+  const int peerWakeFd_;  // written by us
+  void* base_;
+  size_t mapped_;
+  size_t capacity_;
+  ShmRing tx_;
+  ShmRing rx_;
+  Channel socketChannel_;
+  Channel wakeChannel_;
+  ShmConnectionCallback connectionCallback_;
+  ShmMessageCallback messageCallback_;
+  ShmWriteCompleteCallback writeCompleteCallback_;
+  ShmCloseCallback closeCallback_;
+  Buffer inputBuffer_;
+  Buffer outputBuffer_;
+  int64_t wakeupsSent_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SHM_SHMCONNECTION_H
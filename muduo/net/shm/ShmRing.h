@@ -0,0 +1,169 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SHM_SHMRING_H
+#define MUDUO_NET_SHM_SHMRING_H
+
+#include "muduo/net/Buffer.h"
+
+#include <atomic>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Single producer single consumer byte ring in shared memory.
+///
+/// Positions only grow, the producer owns head, the consumer owns tail.
+/// A side about to sleep sets its waiting flag, then checks the ring
+/// again, the other side checks the flag after moving its position,
+/// with full fences in between one of them sees the other, so the
+/// eventfd is written only when the peer is asleep.
+///
+/// The peer's position is in memory it can write, positions more than
+/// capacity apart are corrupt(), nothing is copied then, close instead.
+///
+class ShmRing
+{
+ public:
+  struct Header
+  {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> readerWaiting;  // consumer asleep on empty
+    std::atomic<uint32_t> writerWaiting;              // producer asleep on full
+    std::atomic<uint32_t> closed;                     // producer shut down
+  };
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "atomics in shared memory must be lock free");
+
+  static size_t bytesFor(size_t capacity) { return sizeof(Header) + capacity; }
+
+  ShmRing()
+    : header_(NULL), data_(NULL), capacity_(0)
+  {
+  }
+
+  // capacity is a power of 2
+  ShmRing(void* base, size_t capacity)
+    : header_(static_cast<Header*>(base)),
+      data_(static_cast<char*>(base) + sizeof(Header)),
+      capacity_(capacity)
+  {
+  }
+
+  // 0 if corrupt()
+  size_t readable() const
+  {
+    uint64_t n = header_->head.load(std::memory_order_acquire) -
+                 header_->tail.load(std::memory_order_relaxed);
+    return n <= capacity_ ? static_cast<size_t>(n) : 0;
+  }
+
+  // 0 if corrupt()
+  size_t writable() const
+  {
+    uint64_t n = header_->head.load(std::memory_order_relaxed) -
+                 header_->tail.load(std::memory_order_acquire);
+    return n <= capacity_ ? capacity_ - static_cast<size_t>(n) : 0;
+  }
+
+  // head behind tail, or ahead by more than capacity
+  bool corrupt() const
+  {
+    return header_->head.load(std::memory_order_acquire) -
+           header_->tail.load(std::memory_order_acquire) > capacity_;
+  }
+
+  // producer, returns bytes copied, may be less than len
+  size_t write(const char* data, size_t len)
+  {
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    size_t n = std::min(len, writable());
+    size_t index = static_cast<size_t>(head) & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - index);
+    memcpy(data_ + index, data, first);
+    memcpy(data_, data + first, n - first);
+    header_->head.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // consumer, appends everything readable to buf, nothing if corrupt()
+  size_t readInto(Buffer* buf)
+  {
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    size_t n = readable();
+    size_t index = static_cast<size_t>(tail) & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - index);
+    buf->append(data_ + index, first);
+    buf->append(data_, n - first);
+    header_->tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // producer after write(), true if the consumer is asleep and must be woken up
+  bool takeReaderWaiting()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->readerWaiting.load(std::memory_order_relaxed) != 0 &&
+           header_->readerWaiting.exchange(0) != 0;
+  }
+
+  // consumer after readInto(), true if the producer waits for space
+  bool takeWriterWaiting()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->writerWaiting.load(std::memory_order_relaxed) != 0 &&
+           header_->writerWaiting.exchange(0) != 0;
+  }
+
+  // consumer, false if data came in meanwhile, read it instead of sleeping
+  bool sleepIfEmpty()
+  {
+    header_->readerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (readable() > 0 || closed())
+    {
+      header_->readerWaiting.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // producer, false if space came meanwhile, write instead of sleeping
+  bool sleepIfFull()
+  {
+    header_->writerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writable() > 0)
+    {
+      header_->writerWaiting.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void close() { header_->closed.store(1, std::memory_order_release); }
+  bool closed() const { return header_->closed.load(std::memory_order_acquire) != 0; }
+
+ private:
+  Header* header_;
+  char* data_;
+  size_t capacity_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SHM_SHMRING_H
@@ -0,0 +1,156 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/shm/ShmServer.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+ShmServer::ShmServer(EventLoop* loop, const string& path, const string& nameArg,
+                     size_t ringCapacity)
+  : loop_(CHECK_NOTNULL(loop)),
+    path_(path),
+    name_(nameArg),
+    ringCapacity_(ringCapacity),
+    listenFd_(-1),
+    threadPool_(new EventLoopThreadPool(loop, name_)),
+    connectionCallback_([](const ShmConnectionPtr&) {}),
+    messageCallback_([](const ShmConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); }),
+    nextConnId_(1)
+{
+}
+
+ShmServer::~ShmServer()
+{
+  loop_->assertInLoopThread();
+  LOG_TRACE << "ShmServer::~ShmServer [" << name_ << "] destructing";
+
+  for (auto& item : connections_)
+  {
+    ShmConnectionPtr conn(item.second);
+    item.second.reset();
+    conn->getLoop()->runInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+  }
+  if (acceptChannel_)
+  {
+    acceptChannel_->disableAll();
+    acceptChannel_->remove();
+    sockets::close(listenFd_);
+    ::unlink(path_.c_str());
+  }
+}
+
+void ShmServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void ShmServer::start()
+{
+  loop_->assertInLoopThread();
+  assert(!acceptChannel_);
+  threadPool_->start();
+
+  struct sockaddr_un addr;
+  memZero(&addr, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof addr.sun_path)
+  {
+    LOG_FATAL << "ShmServer path too long " << path_;
+  }
+  memcpy(addr.sun_path, path_.c_str(), path_.size());
+  listenFd_ = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0)
+  {
+    LOG_SYSFATAL << "ShmServer::start socket";
+  }
+  ::unlink(path_.c_str());  // left by a crashed process
+  // peers share our memory, only our user may connect
+  mode_t mask = ::umask(077);
+  int ret = ::bind(listenFd_, reinterpret_cast<struct sockaddr*>(&addr), static_cast<socklen_t>(sizeof addr));
+  ::umask(mask);
+  if (ret < 0 || ::listen(listenFd_, SOMAXCONN) < 0)
+  {
+    LOG_SYSFATAL << "ShmServer::start listen " << path_;
+  }
+  acceptChannel_.reset(new Channel(loop_, listenFd_));
+  acceptChannel_->setReadCallback(std::bind(&ShmServer::handleAccept, this));
+  acceptChannel_->enableReading();
+}
+
+void ShmServer::handleAccept()
+{
+  loop_->assertInLoopThread();
+  int connfd = ::accept4(listenFd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (connfd < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "ShmServer::handleAccept";
+    }
+    return;
+  }
+  ShmConnection::Handshake hs;
+  if (!ShmConnection::createShared(ringCapacity_, &hs))
+  {
+    sockets::close(connfd);
+    return;
+  }
+  if (!ShmConnection::sendHandshake(connfd, hs))
+  {
+    ShmConnection::closeHandshake(hs);
+    sockets::close(connfd);
+    return;
+  }
+
+  char buf[32];
+  snprintf(buf, sizeof buf, "#%d", nextConnId_);
+  ++nextConnId_;
+  string connName = name_ + buf;
+  LOG_INFO << "ShmServer::handleAccept [" << name_ << "] - new connection [" << connName << "]";
+
+  EventLoop* ioLoop = threadPool_->getNextLoop();
+  ShmConnectionPtr conn(new ShmConnection(ioLoop, connName, connfd, hs, true));
+  connections_[connName] = conn;
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(std::bind(&ShmServer::removeConnection, this, _1));  // FIXME: unsafe
+  ioLoop->runInLoop(std::bind(&ShmConnection::connectEstablished, conn));
+}
+
+void ShmServer::removeConnection(const ShmConnectionPtr& conn)
+{
+  // FIXME: unsafe
+  loop_->runInLoop(std::bind(&ShmServer::removeConnectionInLoop, this, conn));
+}
+
+void ShmServer::removeConnectionInLoop(const ShmConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  LOG_INFO << "ShmServer::removeConnectionInLoop [" << name_ << "] - connection " << conn->name();
+  size_t n = connections_.erase(conn->name());
+  (void)n;
+  assert(n == 1);
+  EventLoop* ioLoop = conn->getLoop();
+  ioLoop->queueInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+}
@@ -0,0 +1,81 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SHM_SHMSERVER_H
+#define MUDUO_NET_SHM_SHMSERVER_H
+
+#include "muduo/net/shm/ShmConnection.h"
+
+#include <map>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoopThreadPool;
+
+///
+/// Server of ShmConnection for peers on the same host.
+///
+/// Listens on a Unix socket at @c path, each accepted peer gets a memfd
+/// of two rings and two eventfds through SCM_RIGHTS, and talks through
+/// the rings from then on.
+///
+class ShmServer : noncopyable
+{
+ public:
+  ShmServer(EventLoop* loop, const string& path, const string& nameArg,
+            size_t ringCapacity = 1024 * 1024);
+  ~ShmServer();  // force out-line dtor, for std::unique_ptr members.
+
+  const string& name() const { return name_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Connections go to @c numThreads IO loops, see TcpServer::setThreadNum().
+  /// Must be called before @c start
+  void setThreadNum(int numThreads);
+
+  /// Listens on path, replacing a stale one.
+  /// Not thread safe, in loop
+  void start();
+
+  void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+  void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const ShmWriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+
+  /// Not thread safe, in loop
+  size_t numConnections() const { return connections_.size(); }
+
+ private:
+  void handleAccept();
+  void removeConnection(const ShmConnectionPtr& conn);
+  void removeConnectionInLoop(const ShmConnectionPtr& conn);
+
+  typedef std::map<string, ShmConnectionPtr> ConnectionMap;
+
+  EventLoop* loop_;  // the acceptor loop
+  const string path_;
+  const string name_;
+  const size_t ringCapacity_;
+  int listenFd_;
+  std::unique_ptr<Channel> acceptChannel_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  ShmConnectionCallback connectionCallback_;
+  ShmMessageCallback messageCallback_;
+  ShmWriteCompleteCallback writeCompleteCallback_;
+  int nextConnId_;
+  ConnectionMap connections_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SHM_SHMSERVER_H
@@ -0,0 +1,228 @@
+// Echo through shared memory rings, bigger than a ring and in order,
+// eventfd writes only for a sleeping peer, closing from either side,
+// and on a corrupt ring.
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/shm/ShmClient.h"
+#include "muduo/net/shm/ShmServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE ShmTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const size_t kRing = 64 * 1024;
+const size_t kBulk = 8 * 1024 * 1024;
+const int kMessages = 1000;
+
+AtomicInt32 g_serverUp;
+AtomicInt32 g_serverDown;
+MutexLock g_mutex;
+ShmConnectionPtr g_serverConn GUARDED_BY(g_mutex);
+
+// in the IO loop of the server
+void onServerConnection(const ShmConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConn = conn;
+    g_serverUp.increment();
+  }
+  else
+  {
+    g_serverDown.increment();
+  }
+}
+
+void onServerMessage(const ShmConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+char patternAt(size_t k)
+{
+  return static_cast<char>(k % 251);
+}
+
+size_t g_received = 0;
+bool g_inOrder = true;
+bool g_clientUp = false;
+bool g_clientDown = false;
+
+void onClientConnection(const ShmConnectionPtr& conn)
+{
+  g_clientUp = conn->connected();
+  g_clientDown = !conn->connected();
+}
+
+void onClientMessage(const ShmConnectionPtr&, Buffer* buf, Timestamp)
+{
+  for (size_t i = 0; i < buf->readableBytes(); ++i)
+  {
+    if (buf->peek()[i] != patternAt(g_received + i))
+    {
+      g_inOrder = false;
+    }
+  }
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+void sendPattern(const ShmConnectionPtr& conn, size_t offset, size_t len)
+{
+  string data(len, '\0');
+  for (size_t i = 0; i < len; ++i)
+  {
+    data[i] = patternAt(offset + i);
+  }
+  conn->send(data);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testShmEcho)
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  char path[64];
+  snprintf(path, sizeof path, "/tmp/muduo_shm_test.%d", ::getpid());
+
+  ShmServer server(&loop, path, "ShmEcho", kRing);
+  server.setThreadNum(1);
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  ShmClient client(&loop, path, "Client");
+  client.setConnectionCallback(onClientConnection);
+  client.setMessageCallback(onClientMessage);
+  client.connect();
+  BOOST_REQUIRE(runUntil(&loop, [] { return g_clientUp && g_serverUp.get() == 1; }));
+  ShmConnectionPtr conn = client.connection();
+  BOOST_REQUIRE(conn);
+  BOOST_CHECK_EQUAL(conn->ringCapacity(), kRing);
+
+  // small messages back to back
+  size_t sent = 0;
+  for (int i = 0; i < kMessages; ++i)
+  {
+    sendPattern(conn, sent, 100);
+    sent += 100;
+  }
+  BOOST_CHECK(runUntil(&loop, [sent] { return g_received == sent; }));
+  BOOST_CHECK(g_inOrder);
+  printf("%d sends, %lld wakeups sent by client\n", kMessages,
+         static_cast<long long>(conn->wakeupsSent()));
+  // fewer wakeups than sends
+  BOOST_CHECK_LT(conn->wakeupsSent(), kMessages);
+
+  // bigger than the rings, both sides wait for space
+  sendPattern(conn, sent, kBulk);
+  sent += kBulk;
+  BOOST_CHECK(runUntil(&loop, [sent] { return g_received == sent; }));
+  BOOST_CHECK(g_inOrder);
+
+  // both sides see the close, the server removes the connection
+  client.disconnect();
+  BOOST_CHECK(runUntil(&loop, [] { return g_clientDown && g_serverDown.get() == 1; }));
+  BOOST_CHECK(!client.connection());
+  BOOST_CHECK(runUntil(&loop, [&server] { return server.numConnections() == 0; }));
+
+  // the server closes this one
+  g_clientUp = false;
+  client.connect();
+  BOOST_REQUIRE(runUntil(&loop, [] { return g_clientUp && g_serverUp.get() == 2; }));
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConn->forceClose();
+    g_serverConn.reset();
+  }
+  BOOST_CHECK(runUntil(&loop, [] { return g_clientDown && g_serverDown.get() == 2; }));
+  BOOST_CHECK(runUntil(&loop, [&server] { return server.numConnections() == 0; }));
+
+  conn.reset();
+}
+
+BOOST_AUTO_TEST_CASE(testCorruptRing)
+{
+  alignas(64) static char memory[sizeof(ShmRing::Header) + 4096];
+  ShmRing::Header* header = new (memory) ShmRing::Header();
+  ShmRing ring(memory, 4096);
+  Buffer buf;
+  BOOST_CHECK_EQUAL(ring.write("hello", 5), 5);
+  header->head.store(100 * 4096);
+  BOOST_CHECK(ring.corrupt());
+  BOOST_CHECK_EQUAL(ring.readable(), 0);
+  BOOST_CHECK_EQUAL(ring.writable(), 0);
+  BOOST_CHECK_EQUAL(ring.readInto(&buf), 0);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  // head behind tail
+  header->head.store(0);
+  header->tail.store(5);
+  BOOST_CHECK(ring.corrupt());
+  BOOST_CHECK_EQUAL(ring.readable(), 0);
+
+  // a peer scribbling on head closes the connection, rather than
+  // have it copy from beyond the ring
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  ShmConnection::Handshake hs;
+  BOOST_REQUIRE(ShmConnection::createShared(kRing, &hs));
+  int wakeClient = ::dup(hs.clientWakeFd);
+  int memfd = ::dup(hs.memfd);
+  int clientMemfd = ::dup(hs.memfd);
+  int sockets[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                   0, sockets), 0);
+  ShmConnection::Handshake clientHs = hs;
+  clientHs.memfd = clientMemfd;
+  clientHs.serverWakeFd = ::dup(hs.serverWakeFd);
+  clientHs.clientWakeFd = ::dup(hs.clientWakeFd);
+  ShmConnectionPtr server(new ShmConnection(&loop, "Server", sockets[0], hs, true));
+  ShmConnectionPtr client(new ShmConnection(&loop, "Client", sockets[1], clientHs, false));
+  int closed = 0;
+  for (const ShmConnectionPtr& conn : { server, client })
+  {
+    conn->setConnectionCallback([](const ShmConnectionPtr&) {});
+    conn->setCloseCallback([&loop, &closed](const ShmConnectionPtr& c) {
+      ++closed;
+      loop.queueInLoop(std::bind(&ShmConnection::connectDestroyed, c));
+    });
+    conn->connectEstablished();
+  }
+
+  size_t mapped = 2 * ShmRing::bytesFor(hs.capacity);
+  void* base = ::mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  BOOST_REQUIRE(base != MAP_FAILED);
+  // ring0 from server to client
+  static_cast<ShmRing::Header*>(base)->head.store(3 * hs.capacity);
+  uint64_t one = 1;
+  BOOST_REQUIRE_EQUAL(::write(wakeClient, &one, sizeof one), static_cast<ssize_t>(sizeof one));
+  // the client closes, the server sees the hangup
+  BOOST_CHECK(runUntil(&loop, [&closed] { return closed == 2; }));
+  BOOST_CHECK(client->disconnected());
+  BOOST_CHECK(server->disconnected());
+  runFor(&loop, 0.1);
+
+  ::munmap(base, mapped);
+  ::close(memfd);
+  ::close(wakeClient);
+}
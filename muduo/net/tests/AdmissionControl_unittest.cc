@@ -0,0 +1,153 @@
+// TcpServer admission control: per IP limit, max connections, accept rate and overload.
+
+#include "muduo/base/CurrentThread.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <vector>
+
+//#define BOOST_TEST_MODULE AdmissionControlTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+class Counter
+{
+ public:
+  Counter() : up_(0), down_(0) {}
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+      ++up_;
+    else
+      ++down_;
+  }
+
+  int up() const { return up_; }
+  int down() const { return down_; }
+
+ private:
+  int up_;
+  int down_;
+};
+
+typedef std::shared_ptr<TcpClient> TcpClientPtr;
+
+std::vector<TcpClientPtr> connectClients(EventLoop* loop, const InetAddress& addr, int n, Counter* counter)
+{
+  std::vector<TcpClientPtr> clients;
+  for (int i = 0; i < n; ++i)
+  {
+    TcpClientPtr client(new TcpClient(loop, addr, "Client"));
+    client->setConnectionCallback(std::bind(&Counter::onConnection, counter, _1));
+    client->connect();
+    clients.push_back(client);
+  }
+  return clients;
+}
+
+struct WarnLogLevel
+{
+  WarnLogLevel() { Logger::setLogLevel(Logger::WARN); }
+};
+
+}  // namespace
+
+BOOST_GLOBAL_FIXTURE(WarnLogLevel);
+
+BOOST_AUTO_TEST_CASE(testMaxConnectionsPerIp)
+{
+  EventLoop loop;
+  {
+    // at most 2 connections from 127.0.0.1
+    InetAddress addr("127.0.0.1", 23461);
+    TcpServer server(&loop, addr, "PerIp");
+    Counter serverSide, clientSide;
+    server.setConnectionCallback(std::bind(&Counter::onConnection, &serverSide, _1));
+    server.setMaxConnectionsPerIp(2);
+    server.start();
+    std::vector<TcpClientPtr> clients = connectClients(&loop, addr, 3, &clientSide);
+    BOOST_CHECK(runUntil(&loop, [&] { return clientSide.up() == 3 && clientSide.down() == 1; }));
+    BOOST_CHECK_EQUAL(serverSide.up(), 2);
+    BOOST_CHECK_EQUAL(server.numRejected(), 1);
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testMaxConnections)
+{
+  EventLoop loop;
+  {
+    // at most 2 connections, the 3rd waits in backlog until one closes
+    InetAddress addr("127.0.0.1", 23462);
+    TcpServer server(&loop, addr, "MaxConn");
+    Counter serverSide, clientSide;
+    server.setConnectionCallback(std::bind(&Counter::onConnection, &serverSide, _1));
+    server.setMaxConnections(2);
+    server.start();
+    std::vector<TcpClientPtr> clients = connectClients(&loop, addr, 3, &clientSide);
+    // the 3rd is connected by the kernel, not accepted
+    BOOST_CHECK(runUntil(&loop, [&] { return clientSide.up() == 3; }));
+    BOOST_CHECK_EQUAL(serverSide.up(), 2);
+    BOOST_CHECK(server.acceptPaused());
+    clients[0]->disconnect();
+    BOOST_CHECK(runUntil(&loop, [&] { return serverSide.up() == 3; }));
+    BOOST_CHECK_EQUAL(serverSide.down(), 1);
+  }
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testAcceptRate)
+{
+  EventLoop loop;
+  {
+    // 4 per second in bursts of 2, 6 clients take about 1 second
+    InetAddress addr("127.0.0.1", 23463);
+    TcpServer server(&loop, addr, "Rate");
+    Counter serverSide, clientSide;
+    server.setConnectionCallback(std::bind(&Counter::onConnection, &serverSide, _1));
+    server.setAcceptRate(4, 2);
+    server.start();
+    std::vector<TcpClientPtr> clients = connectClients(&loop, addr, 6, &clientSide);
+    runFor(&loop, 0.2);
+    BOOST_CHECK_LE(serverSide.up(), 3);  // burst + 1
+    BOOST_CHECK(runUntil(&loop, [&] { return serverSide.up() == 6; }, 5));
+  }
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testOverload)
+{
+  EventLoop loop;
+  {
+    // a blocked IO loop stops accepting until it catches up
+    InetAddress addr("127.0.0.1", 23464);
+    TcpServer server(&loop, addr, "Overload");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+        CurrentThread::sleepUsec(400 * 1000);
+    });
+    server.setOverloadThreshold(0.05, 0.02);
+    server.start();
+    Counter clientSide;
+    std::vector<TcpClientPtr> clients = connectClients(&loop, addr, 1, &clientSide);
+    BOOST_CHECK(runUntil(&loop, [&] { return server.acceptPaused(); }, 1));
+    BOOST_CHECK(runUntil(&loop, [&] { return !server.acceptPaused(); }, 2));
+  }
+  runFor(&loop, 0.1);
+}
@@ -0,0 +1,78 @@
+// Delimiter search of Buffer over HTTP headers, by instruction set.
+
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/Buffer.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const char kHeaders[] =
+    "GET /index.html?query=muduo HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; lang=en\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+const int kRounds = 200000;
+
+template<typename Func>
+void bench(const char* name, Func func)
+{
+  Timestamp start(Timestamp::now());
+  size_t found = 0;
+  for (int i = 0; i < kRounds; ++i)
+  {
+    found += func();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("  %-14s %8.1f ns/op %8.2f GB/s (%zd)\n", name, seconds * 1e9 / kRounds,
+         static_cast<double>(sizeof kHeaders - 1) * kRounds / seconds / 1e9, found);
+}
+
+}  // namespace
+
+int main()
+{
+  Buffer buf;
+  buf.append(kHeaders, sizeof kHeaders - 1);
+  const scan::Isa best = scan::isa();
+  for (int isa = scan::kScalar; isa <= best; ++isa)
+  {
+    scan::setIsa(static_cast<scan::Isa>(isa));
+    printf("%s:\n", scan::isaName(scan::isa()));
+    // every line, as HttpContext::parseRequest does
+    bench("lines", [&buf] {
+      size_t lines = 0;
+      const char* start = buf.peek();
+      const char* crlf = NULL;
+      while ((crlf = buf.findCRLF(start)) != NULL)
+      {
+        ++lines;
+        start = crlf + 2;
+      }
+      return lines;
+    });
+    bench("double crlf", [&buf] {
+      return static_cast<size_t>(buf.findDoubleCRLF() - buf.peek());
+    });
+    bench("any of \";=\"", [&buf] {
+      size_t n = 0;
+      const char* p = buf.peek();
+      while ((p = buf.findAnyOf(p, ";=")) != NULL)
+      {
+        ++n;
+        ++p;
+      }
+      return n;
+    });
+  }
+}
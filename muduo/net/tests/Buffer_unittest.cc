@@ -152,6 +152,54 @@ BOOST_AUTO_TEST_CASE(testBufferFindEOL)
   BOOST_CHECK_EQUAL(buf.findEOL(buf.peek()+90000), null);
 }
 
+BOOST_AUTO_TEST_CASE(testBufferFindDelimiters)
+{
+  namespace scan = muduo::net::scan;
+  const char* null = NULL;
+  const scan::Isa best = scan::isa();
+  for (int isa = scan::kScalar; isa <= best; ++isa)
+  {
+    scan::setIsa(static_cast<scan::Isa>(isa));
+    BOOST_TEST_MESSAGE("isa " << scan::isaName(scan::isa()));
+    // every position, across the ends of SIMD blocks
+    for (size_t len = 0; len < 80; ++len)
+    {
+      for (size_t pos = 0; pos + 4 <= len; ++pos)
+      {
+        Buffer buf;
+        string data(len, 'x');
+        data[pos] = '\r';  // lone CR first, then CRLF, then CRLFCRLF
+        if (pos + 6 <= len)
+        {
+          data.replace(pos + 2, 4, "\r\n\r\n");
+          buf.append(data);
+          BOOST_CHECK_EQUAL(buf.findCRLF(), buf.peek() + pos + 2);
+          BOOST_CHECK_EQUAL(buf.findDoubleCRLF(), buf.peek() + pos + 2);
+          BOOST_CHECK_EQUAL(buf.findCRLF(buf.peek() + pos + 3), buf.peek() + pos + 4);
+          BOOST_CHECK_EQUAL(buf.findDoubleCRLF(buf.peek() + pos + 3), null);
+        }
+        else
+        {
+          data.replace(pos + 2, 2, "\r\n");
+          buf.append(data);
+          BOOST_CHECK_EQUAL(buf.findCRLF(), buf.peek() + pos + 2);
+          BOOST_CHECK_EQUAL(buf.findDoubleCRLF(), null);
+        }
+        BOOST_CHECK_EQUAL(buf.findAnyOf("?\r"), buf.peek() + pos);
+        BOOST_CHECK_EQUAL(buf.findAnyOf(buf.peek() + pos + 1, "?\r"), buf.peek() + pos + 2);
+        BOOST_CHECK_EQUAL(buf.findAnyOf("0123456789abcdefgh"), null);  // scalar, over 16
+        BOOST_CHECK_EQUAL(buf.findAnyOf("0123456789abcdefghx"), buf.peek() + (pos == 0 ? 1 : 0));
+      }
+    }
+    Buffer buf;
+    buf.append(string(100000, 'x'));
+    BOOST_CHECK_EQUAL(buf.findCRLF(), null);
+    BOOST_CHECK_EQUAL(buf.findDoubleCRLF(), null);
+    BOOST_CHECK_EQUAL(buf.findAnyOf(" \r\n"), null);
+  }
+  scan::setIsa(best);
+}
+
 void output(Buffer&& buf, const void* inner)
 {
   Buffer newbuf(std::move(buf));
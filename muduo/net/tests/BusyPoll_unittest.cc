@@ -0,0 +1,95 @@
+// A busy polling loop runs functors without eventfd wakeups while spinning,
+// and sleeps once its spin budget is used up.
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/CurrentThread.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE BusyPollTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const int kSpinMicroseconds = 2000;
+const int kFunctors = 1000;
+
+void initLoop(EventLoop* loop)
+{
+  loop->setBusyPoll(kSpinMicroseconds);
+}
+
+void getStats(EventLoop* loop, EventLoop::BusyPollStats* stats, CountDownLatch* latch)
+{
+  *stats = loop->busyPollStats();
+  latch->countDown();
+}
+
+EventLoop::BusyPollStats statsOf(EventLoop* loop)
+{
+  EventLoop::BusyPollStats stats;
+  CountDownLatch latch(1);
+  loop->runInLoop(std::bind(getStats, loop, &stats, &latch));
+  latch.wait();
+  return stats;
+}
+
+void record(Timestamp queued, std::vector<int64_t>* latencies)
+{
+  latencies->push_back(Timestamp::now().microSecondsSinceEpoch() - queued.microSecondsSinceEpoch());
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testBusyPoll)
+{
+  EventLoopThread thread(initLoop, "BusyPoll");
+  EventLoop* loop = thread.startLoop();
+
+  // functors queued close together, 20us apart, the loop keeps spinning
+  std::vector<int64_t> latencies;
+  latencies.reserve(kFunctors);
+  loop->runInLoop([] {});
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    loop->queueInLoop(std::bind(record, Timestamp::now(), &latencies));
+    CurrentThread::sleepUsec(20);
+  }
+  EventLoop::BusyPollStats stats = statsOf(loop);
+  BOOST_CHECK_EQUAL(latencies.size(), kFunctors);
+  BOOST_CHECK_GT(stats.wakeupsAvoided, 0);
+  BOOST_CHECK_GT(stats.spins, 0);
+  BOOST_CHECK_GT(stats.idleSpins, 0);
+
+  // idle longer than the budget, the loop sleeps and eventfd wakes it up,
+  // asking it for stats would wake it
+  CurrentThread::sleepUsec(100 * 1000);
+  CountDownLatch latch(1);
+  loop->queueInLoop(std::bind(&CountDownLatch::countDown, &latch));
+  latch.wait();
+  EventLoop::BusyPollStats after = statsOf(loop);
+  BOOST_CHECK_GT(after.sleeps, stats.sleeps);
+
+  std::sort(latencies.begin(), latencies.end());
+  printf("latency us: p50 %lld p99 %lld\n",
+         static_cast<long long>(latencies[latencies.size() / 2]),
+         static_cast<long long>(latencies[latencies.size() * 99 / 100]));
+  printf("spins %lld idle %lld idle us %lld sleeps %lld wakeups avoided %lld\n",
+         static_cast<long long>(after.spins),
+         static_cast<long long>(after.idleSpins),
+         static_cast<long long>(after.idleSpinMicroseconds),
+         static_cast<long long>(after.sleeps),
+         static_cast<long long>(after.wakeupsAvoided));
+}
@@ -0,0 +1,163 @@
+// Pipelined requests answered by a connection coalescing writes cost one
+// write(2), a plain connection writes once per response. Shutdown waits for
+// the coalesced bytes, uncork() flushes them.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <map>
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE CoalesceWritesTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const int kRequests = 10;
+
+std::map<string, TcpConnectionPtr> g_serverConns;  // by client name
+
+// "<client name> <command>\n", commands: ping, corked, bye
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  const char* crlf = NULL;
+  while ((crlf = buf->findEOL()) != NULL)
+  {
+    string line(buf->peek(), crlf);
+    buf->retrieveUntil(crlf + 1);
+    size_t space = line.find(' ');
+    string client = line.substr(0, space);
+    string command = line.substr(space + 1);
+    g_serverConns[client] = conn;
+    conn->setCoalesceWrites(client != "plain");
+    if (command == "corked")
+    {
+      conn->cork();
+      conn->send("corked\n");
+      conn->uncork();
+    }
+    else if (command == "bye")
+    {
+      conn->send("bye\n");
+      conn->shutdown();
+    }
+    else
+    {
+      conn->send("pong\n");
+    }
+  }
+}
+
+struct Client
+{
+  Client(EventLoop* loop, const InetAddress& addr, const string& nameArg, const string& commandArg)
+    : client(loop, addr, nameArg),
+      name(nameArg),
+      command(commandArg),
+      closed(false)
+  {
+    client.setConnectionCallback(std::bind(&Client::onConnection, this, _1));
+    client.setMessageCallback(std::bind(&Client::onMessage, this, _1, _2, _3));
+    client.connect();
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      // all requests in one segment
+      string requests;
+      for (int i = 0; i < kRequests; ++i)
+      {
+        requests += name + " " + command + "\n";
+      }
+      conn->send(requests);
+    }
+    else
+    {
+      closed = true;
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+  {
+    received += buf->retrieveAllAsString();
+  }
+
+  TcpClient client;
+  const string name;
+  const string command;
+  string received;
+  bool closed;
+};
+
+string repeat(const string& s, int n)
+{
+  string result;
+  for (int i = 0; i < n; ++i)
+  {
+    result += s;
+  }
+  return result;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testCoalesceWrites)
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  {
+    InetAddress addr("127.0.0.1", 23475);
+    TcpServer server(&loop, addr, "Coalesce");
+    server.setMessageCallback(onServerMessage);
+    server.start();
+
+    Client plain(&loop, addr, "plain", "ping");
+    Client coalesced(&loop, addr, "coalesced", "ping");
+    Client corked(&loop, addr, "corked", "corked");
+    Client bye(&loop, addr, "bye", "bye");
+    const string pongs = repeat("pong\n", kRequests);
+    const string corks = repeat("corked\n", kRequests);
+    BOOST_CHECK(runUntil(&loop, [&] {
+      return plain.received.size() >= pongs.size() &&
+          coalesced.received.size() >= pongs.size() &&
+          corked.received.size() >= corks.size() &&
+          bye.closed;
+    }));
+
+    BOOST_CHECK_EQUAL(plain.received, pongs);
+    BOOST_CHECK_EQUAL(coalesced.received, pongs);
+    BOOST_REQUIRE_EQUAL(g_serverConns.size(), 4);
+    const TcpConnection::Traffic& plainTraffic = g_serverConns["plain"]->traffic();
+    const TcpConnection::Traffic& coalescedTraffic = g_serverConns["coalesced"]->traffic();
+    printf("writes: plain %lld coalesced %lld\n",
+           static_cast<long long>(plainTraffic.writes),
+           static_cast<long long>(coalescedTraffic.writes));
+    // a write per response, coalesced one write for all
+    BOOST_CHECK_EQUAL(plainTraffic.writes, kRequests);
+    BOOST_CHECK_EQUAL(coalescedTraffic.messagesOut, kRequests);
+    BOOST_CHECK_EQUAL(coalescedTraffic.writes, 1);
+    // uncork flushes
+    BOOST_CHECK_EQUAL(corked.received, corks);
+    // shutdown after coalesced send
+    BOOST_CHECK_EQUAL(bye.received.substr(0, 4), "bye\n");
+    BOOST_CHECK(bye.closed);
+    g_serverConns.clear();
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
@@ -0,0 +1,174 @@
+// Line and fixed length echo written as coroutines, needs -std=c++20.
+
+#include "muduo/net/Coroutine.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE CoroutineTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const int kBlobSize = 1024 * 1024;
+int g_blobFd = -1;  // holds the blob
+bool g_fileDrained = false;
+
+// steps of the client session, done when it returns
+struct ClientResult
+{
+  bool linesEchoed = false;
+  bool blobEchoed = false;
+  bool fileEchoed = false;
+  bool switched = false;
+  bool closed = false;
+  bool done = false;
+} g_result;
+
+string makeBlob()
+{
+  string blob;
+  for (int i = 0; i < kBlobSize; ++i)
+    blob.push_back(static_cast<char>('A' + i % 61));
+  return blob;
+}
+
+coro::Task serverSession(TcpConnectionPtr conn)
+{
+  coro::Stream stream(conn);
+  while (true)
+  {
+    StringPiece line = co_await stream.readUntil("\r\n");
+    if (line.empty())
+      break;
+    if (line == "BLOB\r\n")
+    {
+      StringPiece blob = co_await stream.read(kBlobSize);
+      if (blob.empty())
+        break;
+      conn->send(blob);
+      co_await stream.drain();
+    }
+    else if (line == "FILE\r\n")
+    {
+      // likely more than the socket buffer, drain waits for the queued region
+      int64_t before = conn->traffic().bytesOut;
+      conn->sendFile(g_blobFd, 0, kBlobSize);
+      co_await stream.drain();
+      g_fileDrained = conn->traffic().bytesOut - before == kBlobSize;
+    }
+    else
+    {
+      conn->send(line);
+    }
+  }
+  LOG_INFO << "server session done";
+}
+
+coro::Task clientSession(TcpConnectionPtr conn, EventLoop* other)
+{
+  coro::Stream stream(conn);
+  EventLoop* loop = conn->getLoop();
+  co_await coro::sleep(loop, 0.01);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    string line = "line " + std::to_string(i) + "\r\n";
+    conn->send(line);
+    StringPiece reply = co_await stream.readUntil("\r\n");
+    if (reply != line)
+    {
+      LOG_ERROR << "bad reply " << reply.as_string();
+      g_result.done = true;
+      co_return;
+    }
+  }
+  g_result.linesEchoed = true;
+
+  string blob = makeBlob();
+  conn->send("BLOB\r\n");
+  conn->send(blob);
+  co_await stream.drain();
+  StringPiece reply = co_await stream.read(kBlobSize);
+  if (reply != blob)
+  {
+    LOG_ERROR << "bad blob";
+    g_result.done = true;
+    co_return;
+  }
+  g_result.blobEchoed = true;
+  conn->send("FILE\r\n");
+  reply = co_await stream.read(kBlobSize);
+  g_result.fileEchoed = reply == blob;
+
+  co_await coro::switchTo(other);
+  bool inOther = other->isInLoopThread();
+  co_await coro::switchTo(loop);
+  g_result.switched = inOther && loop->isInLoopThread();
+
+  conn->shutdown();
+  StringPiece eof = co_await stream.readUntil("\r\n");
+  g_result.closed = eof.empty() && stream.closed();
+  g_result.done = true;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testCoroutineEcho)
+{
+  char path[] = "/tmp/muduo_coroutine_XXXXXX";
+  g_blobFd = ::mkstemp(path);
+  BOOST_REQUIRE_GE(g_blobFd, 0);
+  ::unlink(path);
+  string blob = makeBlob();
+  BOOST_REQUIRE_EQUAL(::write(g_blobFd, blob.data(), blob.size()), kBlobSize);
+
+  EventLoopThread otherThread;
+  EventLoop* other = otherThread.startLoop();
+
+  EventLoop loop;
+  {
+    InetAddress listenAddr("127.0.0.1", 23465);
+    TcpServer server(&loop, listenAddr, "CoroServer");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+        serverSession(conn);
+    });
+    server.start();
+
+    TcpClient client(&loop, listenAddr, "CoroClient");
+    client.setConnectionCallback([other](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+        clientSession(conn, other);
+    });
+    client.connect();
+    BOOST_CHECK(runUntil(&loop, [] { return g_result.done; }, 30));
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+  ::close(g_blobFd);
+
+  BOOST_CHECK(g_result.linesEchoed);
+  BOOST_CHECK(g_result.blobEchoed);
+  BOOST_CHECK(g_result.fileEchoed);
+  // drain waited for the queued file region
+  BOOST_CHECK(g_fileDrained);
+  BOOST_CHECK(g_result.switched);
+  BOOST_CHECK(g_result.closed);
+}
@@ -0,0 +1,102 @@
+// IO threads pinned to CPUs before their EventLoop is created,
+// and loops found by the CPU they run on.
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <sched.h>
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE CpuAffinityTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+void getAffinity(cpu_set_t* set, CountDownLatch* latch)
+{
+  sched_getaffinity(0, sizeof *set, set);
+  latch->countDown();
+}
+
+cpu_set_t affinityOf(EventLoop* loop)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CountDownLatch latch(1);
+  loop->runInLoop(std::bind(getAffinity, &set, &latch));
+  latch.wait();
+  return set;
+}
+
+int firstAllowedCpu()
+{
+  cpu_set_t allowed;
+  sched_getaffinity(0, sizeof allowed, &allowed);
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed))
+  {
+    ++cpu;
+  }
+  return cpu;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testPinned)
+{
+  EventLoop loop;
+  int cpu = firstAllowedCpu();
+  EventLoopThreadPool pool(&loop, "Pinned");
+  pool.setThreadNum(2);
+  pool.setCpuAffinity(std::vector<int>(1, cpu));
+  pool.start();
+  std::vector<EventLoop*> loops = pool.getAllLoops();
+  for (EventLoop* ioLoop : loops)
+  {
+    cpu_set_t set = affinityOf(ioLoop);
+    BOOST_CHECK_EQUAL(CPU_COUNT(&set), 1);
+    BOOST_CHECK(CPU_ISSET(cpu, &set));
+  }
+  // loops of the CPU in turn
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(cpu), 0);
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(cpu), 1);
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(cpu), 0);
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(CPU_SETSIZE - 1), -1);
+}
+
+BOOST_AUTO_TEST_CASE(testNumaNode)
+{
+  std::vector<int> cpus = EventLoopThreadPool::cpusOfNode(0);
+  if (cpus.empty())
+  {
+    printf("no NUMA topology in sysfs\n");
+    return;
+  }
+  EventLoop loop;
+  EventLoopThreadPool pool(&loop, "Node");
+  pool.setThreadNum(2);
+  pool.setNumaNodes(std::vector<int>(1, 0));
+  pool.start();
+  cpu_set_t set = affinityOf(pool.getNextLoop());
+  BOOST_CHECK_GT(CPU_COUNT(&set), 0);
+  for (int c = 0; c < CPU_SETSIZE; ++c)
+  {
+    if (CPU_ISSET(c, &set))
+    {
+      BOOST_CHECK(std::find(cpus.begin(), cpus.end(), c) != cpus.end());
+    }
+  }
+  // loops of the node in turn, whichever of its CPUs
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(cpus[0]), 0);
+  BOOST_CHECK_EQUAL(pool.loopIndexForCpu(cpus.back()), 1);
+}
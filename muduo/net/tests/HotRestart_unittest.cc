@@ -0,0 +1,188 @@
+// A new "process" takes the listen socket over from a running server,
+// which stops accepting and drains its connections by a deadline.
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/HotRestart.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <map>
+#include <memory>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE HotRestartTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 23470;
+
+// a reply tells which server answered
+void onMessage(const char* tag, const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+  conn->send(tag);
+}
+
+int connectTo(const InetAddress& addr)
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, addr.getSockAddr(), static_cast<socklen_t>(sizeof(struct sockaddr_in))) < 0)
+  {
+    LOG_SYSFATAL << "connect";
+  }
+  return fd;
+}
+
+// "" on EOF
+string ask(int fd)
+{
+  char buf[16] = "";
+  if (::write(fd, "?", 1) != 1)
+  {
+    return "";
+  }
+  ssize_t n = ::read(fd, buf, sizeof buf);
+  return n > 0 ? string(buf, static_cast<size_t>(n)) : "";
+}
+
+string g_path;
+InetAddress g_addr("127.0.0.1", kPort);
+int g_oldClient = -1;
+bool g_drained = false;
+Timestamp g_handedOver;
+
+// seen by the new process, checked in the main thread
+struct NewProcessResult
+{
+  string oldBefore;
+  bool tookOver = false;
+  string newAnswer;
+  string oldWhileDraining;
+  bool oldClosed = false;
+} g_result;
+
+void startNewServer(EventLoop* loop, int fd, std::unique_ptr<TcpServer>* server, CountDownLatch* latch)
+{
+  server->reset(new TcpServer(loop, fd, "Echo"));
+  (*server)->setMessageCallback(std::bind(onMessage, "new", _1, _2, _3));
+  (*server)->start();
+  latch->countDown();
+}
+
+void stopNewServer(std::unique_ptr<TcpServer>* server, CountDownLatch* latch)
+{
+  server->reset();
+  latch->countDown();
+}
+
+// the new process
+void newProcess()
+{
+  g_result.oldBefore = ask(g_oldClient);
+
+  std::map<string, int> fds;
+  bool found = HotRestart::takeOver(g_path, &fds);
+  g_handedOver = Timestamp::now();
+  g_result.tookOver = found && fds.size() == 1 && fds.count("Echo") == 1;
+  if (fds.count("Echo") == 0)
+  {
+    return;
+  }
+
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  std::unique_ptr<TcpServer> server;
+  CountDownLatch started(1);
+  loop->runInLoop(std::bind(startNewServer, loop, fds["Echo"], &server, &started));
+  started.wait();
+
+  int client = connectTo(g_addr);
+  g_result.newAnswer = ask(client);
+  g_result.oldWhileDraining = ask(g_oldClient);
+  ::close(client);
+
+  // the old one force closes it at the deadline
+  char buf[16];
+  g_result.oldClosed = ::read(g_oldClient, buf, sizeof buf) == 0;
+  ::close(g_oldClient);
+
+  CountDownLatch stopped(1);
+  loop->runInLoop(std::bind(stopNewServer, &server, &stopped));
+  stopped.wait();
+}
+
+void drained(EventLoop* loop)
+{
+  g_drained = true;
+  loop->quit();
+}
+
+void timeout()
+{
+  LOG_ERROR << "timeout";
+  abort();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testHotRestart)
+{
+  Logger::setLogLevel(Logger::WARN);
+  char path[64];
+  snprintf(path, sizeof path, "/tmp/muduo_hotrestart_test.%d", static_cast<int>(::getpid()));
+  g_path = path;
+
+  std::map<string, int> none;
+  // cold start without an old server
+  BOOST_CHECK(!HotRestart::takeOver(g_path, &none));
+
+  EventLoop loop;
+  loop.runAfter(10, timeout);
+  TcpServer server(&loop, g_addr, "Echo");
+  server.setMessageCallback(std::bind(onMessage, "old", _1, _2, _3));
+  HotRestart restart(&loop, g_path);
+  restart.addServer(&server);
+  restart.setDrainTimeout(0.5);
+  restart.setDrainedCallback(std::bind(drained, &loop));
+  server.start();
+  restart.start();
+  loop.runInLoop([] { g_oldClient = connectTo(g_addr); });
+
+  // listening already, the new process waits in the backlog until we loop
+  Thread thread(newProcess, "NewProcess");
+  thread.start();
+  loop.loop();
+  double drainTime = timeDifference(Timestamp::now(), g_handedOver);
+  thread.join();
+
+  BOOST_CHECK_EQUAL(g_result.oldBefore, "old");
+  BOOST_CHECK(g_result.tookOver);
+  // new connections go to the new server, old ones are still served
+  BOOST_CHECK_EQUAL(g_result.newAnswer, "new");
+  BOOST_CHECK_EQUAL(g_result.oldWhileDraining, "old");
+  BOOST_CHECK(g_result.oldClosed);
+
+  BOOST_CHECK(g_drained);
+  BOOST_CHECK(restart.handedOver());
+  // closed at the drain deadline
+  BOOST_CHECK_GT(drainTime, 0.4);
+  BOOST_CHECK_LT(drainTime, 2.0);
+  BOOST_CHECK_EQUAL(server.numConnections(), 0);
+  BOOST_CHECK(server.draining());
+  BOOST_CHECK_NE(::access(g_path.c_str(), F_OK), 0);
+}
@@ -0,0 +1,165 @@
+#include "muduo/net/codec/LengthFieldCodec.h"
+
+//#define BOOST_TEST_MODULE LengthFieldCodecTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::TcpConnectionPtr;
+
+namespace
+{
+
+// sum of the bytes, Adler32Checksum would need zlib
+struct SumChecksum
+{
+  static const size_t kLen = sizeof(uint32_t);
+  static uint32_t compute(const char* buf, size_t len)
+  {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+      sum += static_cast<unsigned char>(buf[i]);
+    }
+    return sum;
+  }
+};
+
+template<typename CODEC>
+struct Receiver
+{
+  Receiver()
+    : codec(std::bind(&Receiver::onFrames, this, muduo::_1, muduo::_2, muduo::_3),
+            std::bind(&Receiver::onError, this, muduo::_1, muduo::_2, muduo::_3, std::placeholders::_4)),
+      batches(0),
+      error(CODEC::kNoError)
+  {
+  }
+
+  void onFrames(const TcpConnectionPtr&, const typename CODEC::Frames& frames, Timestamp)
+  {
+    ++batches;
+    for (const StringPiece& frame : frames)
+    {
+      // views into the input buffer, not copies
+      BOOST_CHECK(frame.data() >= input.peek() &&
+                  frame.data() + frame.size() <= input.peek() + input.readableBytes());
+      received.push_back(frame.as_string());
+    }
+  }
+
+  void onError(const TcpConnectionPtr&, Buffer*, Timestamp, typename CODEC::ErrorCode e)
+  {
+    error = e;
+  }
+
+  void feed()
+  {
+    codec.onMessage(TcpConnectionPtr(), &input, Timestamp::now());
+  }
+
+  CODEC codec;
+  Buffer input;
+  std::vector<string> received;
+  int batches;
+  typename CODEC::ErrorCode error;
+};
+
+}  // namespace
+
+using namespace muduo::net;
+
+BOOST_AUTO_TEST_CASE(testFixedLengthBatch)
+{
+  typedef LengthFieldCodec<FixedLengthField<4> > Codec;
+  Receiver<Codec> r;
+  Codec::encode(&r.input, "hello");
+  Codec::encode(&r.input, "");
+  Codec::encode(&r.input, "world");
+  BOOST_CHECK_EQUAL(r.input.peekInt32(), 5);
+  Buffer partial;
+  Codec::encode(&partial, "tail");
+  r.input.append(partial.peek(), 6);
+
+  r.feed();
+  BOOST_CHECK_EQUAL(r.batches, 1);
+  BOOST_REQUIRE_EQUAL(r.received.size(), 3u);
+  BOOST_CHECK_EQUAL(r.received[0], "hello");
+  BOOST_CHECK_EQUAL(r.received[1], "");
+  BOOST_CHECK_EQUAL(r.received[2], "world");
+  BOOST_CHECK_EQUAL(r.input.readableBytes(), 6u);
+
+  r.input.append(partial.peek() + 6, partial.readableBytes() - 6);
+  r.feed();
+  BOOST_CHECK_EQUAL(r.batches, 2);
+  BOOST_CHECK_EQUAL(r.received.back(), "tail");
+  BOOST_CHECK_EQUAL(r.input.readableBytes(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testManyFrames)
+{
+  typedef LengthFieldCodec<FixedLengthField<2, false> > Codec;
+  Receiver<Codec> r;
+  const size_t kFrames = Codec::kMaxBatch * 2 + 1;
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    Codec::encode(&r.input, "x");
+  }
+  BOOST_CHECK_EQUAL(r.input.peek()[0], 1);  // little endian
+  r.feed();
+  BOOST_CHECK_EQUAL(r.received.size(), kFrames);
+  BOOST_CHECK_EQUAL(r.batches, 3);
+}
+
+BOOST_AUTO_TEST_CASE(testVarint)
+{
+  typedef LengthFieldCodec<VarintLengthField> Codec;
+  Receiver<Codec> r;
+  string big(300, 'v');
+  Codec::encode(&r.input, big);
+  BOOST_CHECK_EQUAL(r.input.readableBytes(), 302u);
+  r.input.append("\x03" "abc");
+  r.feed();
+  BOOST_REQUIRE_EQUAL(r.received.size(), 2u);
+  BOOST_CHECK_EQUAL(r.received[0], big);
+  BOOST_CHECK_EQUAL(r.received[1], "abc");
+
+  // eleven bytes with the continuation bit
+  r.input.append(string(11, '\x80'));
+  r.feed();
+  BOOST_CHECK_EQUAL(r.error, Codec::kInvalidLength);
+}
+
+BOOST_AUTO_TEST_CASE(testMaxFrame)
+{
+  typedef LengthFieldCodec<FixedLengthField<4>, 16> Codec;
+  Receiver<Codec> r;
+  Codec::encode(&r.input, "0123456789abcdef");
+  r.input.appendInt32(17);
+  r.input.append(string(17, 'y'));
+  r.feed();
+  BOOST_CHECK_EQUAL(r.received.size(), 1u);
+  BOOST_CHECK_EQUAL(r.error, Codec::kInvalidLength);
+  BOOST_CHECK_EQUAL(r.input.readableBytes(), 21u);
+}
+
+BOOST_AUTO_TEST_CASE(testChecksum)
+{
+  typedef LengthFieldCodec<FixedLengthField<4>, 1024, SumChecksum> Codec;
+  Receiver<Codec> r;
+  Codec::encode(&r.input, "checked");
+  BOOST_CHECK_EQUAL(r.input.readableBytes(), 4u + 7u + 4u);
+  BOOST_CHECK_EQUAL(r.input.peekInt32(), 11);
+  Codec::encode(&r.input, "corrupted");
+  const_cast<char*>(r.input.peek())[4 + 7 + 4 + 4] = 'C';
+  r.feed();
+  BOOST_REQUIRE_EQUAL(r.received.size(), 1u);
+  BOOST_CHECK_EQUAL(r.received[0], "checked");
+  BOOST_CHECK_EQUAL(r.error, Codec::kCheckSumError);
+}
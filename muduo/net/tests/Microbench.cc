@@ -0,0 +1,517 @@
+// Microbenchmarks of the core primitives in one place, with JSON output
+// and comparison against an earlier run, eg. around pulling upstream:
+//
+//   microbench --json base.json
+//   microbench --baseline base.json    # exits 1 if anything got slower
+//
+// Each benchmark reports the median ns/op of --repeat runs (default 5).
+// --filter SUBSTR runs some, --quick runs a tenth of the iterations,
+// --tolerance 0.10 is how much slower counts as a regression.
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/LogStream.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/ThreadPool.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#ifdef HAVE_PROTOBUF
+#include "muduo/net/protobuf/ProtobufCodecLite.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+struct Benchmark
+{
+  string name;
+  int64_t iterations;
+  int64_t bytesPerOp;  // 0 if MB/s means nothing
+  // runs n iterations, returns the nanoseconds they took, setup excluded
+  std::function<int64_t(int64_t)> run;
+};
+
+struct Result
+{
+  string name;
+  double nsPerOp;  // median
+  double minNs;
+  double maxNs;
+  int64_t iterations;
+  int64_t bytesPerOp;
+};
+
+int64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// keeps results alive, so the compiler can't drop the work
+volatile size_t g_sink;
+// not a constant the compiler can fold into the appends
+const char* volatile g_name = "muduo::net::TcpConnection";
+
+const InetAddress kPingpongAddr("127.0.0.1", 23477);
+
+int64_t benchAppendRetrieve(int64_t n)
+{
+  Buffer buf;
+  char data[64] = {0};
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    buf.append(data, sizeof data);
+    buf.retrieve(sizeof data);
+  }
+  int64_t elapsed = nowNs() - start;
+  g_sink = buf.readableBytes();
+  return elapsed;
+}
+
+int64_t benchAppendMany(int64_t n)
+{
+  Buffer buf;
+  char data[64] = {0};
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    for (int j = 0; j < 64; ++j)
+    {
+      buf.append(data, sizeof data);
+    }
+    g_sink = buf.readableBytes();
+    buf.retrieveAll();
+  }
+  return nowNs() - start;
+}
+
+// with the write(2) that fills the socket
+int64_t benchReadFd(int64_t n)
+{
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+  {
+    perror("socketpair");
+    abort();
+  }
+  Buffer buf;
+  char data[4096] = {0};
+  int savedErrno = 0;
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    if (::write(fds[1], data, sizeof data) != sizeof data)
+    {
+      perror("write");
+      abort();
+    }
+    buf.readFd(fds[0], &savedErrno);
+    buf.retrieveAll();
+  }
+  int64_t elapsed = nowNs() - start;
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return elapsed;
+}
+
+template <typename T>
+int64_t benchLogStream(int64_t n, T value)
+{
+  LogStream os;
+  size_t total = 0;
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    os << value;
+    total += static_cast<size_t>(os.buffer().length());
+    os.resetBuffer();
+  }
+  int64_t elapsed = nowNs() - start;
+  g_sink = total;
+  return elapsed;
+}
+
+int64_t benchTimerAddCancel(EventLoop* loop, int64_t n)
+{
+  // others pending, as in a server with a timeout per connection
+  std::vector<TimerId> pending;
+  for (int i = 0; i < 1000; ++i)
+  {
+    pending.push_back(loop->runAfter(1000 + i, [] {}));
+  }
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    TimerId id = loop->runAfter(1000.5 + static_cast<double>(i % 1000), [] {});
+    loop->cancel(id);
+  }
+  int64_t elapsed = nowNs() - start;
+  for (const TimerId& id : pending)
+  {
+    loop->cancel(id);
+  }
+  return elapsed;
+}
+
+int64_t benchRunInLoop(int64_t n)
+{
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  CountDownLatch done(1);
+  int64_t count = 0;  // in the loop thread
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    loop->runInLoop([&count, &done, n] {
+      if (++count == n)
+      {
+        done.countDown();
+      }
+    });
+  }
+  done.wait();
+  return nowNs() - start;
+}
+
+int64_t benchThreadPool(int64_t n)
+{
+  ThreadPool pool("bench");
+  pool.start(4);
+  CountDownLatch done(1);
+  AtomicInt64 count;
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    pool.run([&count, &done, n] {
+      if (count.incrementAndGet() == n)
+      {
+        done.countDown();
+      }
+    });
+  }
+  done.wait();
+  return nowNs() - start;
+}
+
+#ifdef HAVE_PROTOBUF
+RpcMessage makeRpcMessage()
+{
+  RpcMessage message;
+  message.set_type(REQUEST);
+  message.set_id(12345);
+  message.set_service("muduo.bench.EchoService");
+  message.set_method("Echo");
+  message.set_request(string(100, 'x'));
+  return message;
+}
+
+int64_t benchProtobufEncode(int64_t n)
+{
+  RpcMessage message = makeRpcMessage();
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0",
+                          ProtobufCodecLite::ProtobufMessageCallback());
+  Buffer buf;
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    codec.fillEmptyBuffer(&buf, message);
+    g_sink = buf.readableBytes();
+    buf.retrieveAll();
+  }
+  return nowNs() - start;
+}
+
+int64_t benchProtobufDecode(int64_t n)
+{
+  int64_t decoded = 0;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0",
+                          [&decoded](const TcpConnectionPtr&, const MessagePtr&, Timestamp) {
+                            ++decoded;
+                          });
+  Buffer frame;
+  codec.fillEmptyBuffer(&frame, makeRpcMessage());
+  Buffer buf;
+  int64_t start = nowNs();
+  for (int64_t i = 0; i < n; ++i)
+  {
+    buf.append(frame.peek(), frame.readableBytes());
+    codec.onMessage(TcpConnectionPtr(), &buf, Timestamp());
+  }
+  int64_t elapsed = nowNs() - start;
+  if (decoded != n)
+  {
+    fprintf(stderr, "protobuf decode: %lld of %lld\n", static_cast<long long>(decoded),
+            static_cast<long long>(n));
+    abort();
+  }
+  return elapsed;
+}
+
+int64_t protobufFrameBytes()
+{
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0",
+                          ProtobufCodecLite::ProtobufMessageCallback());
+  Buffer frame;
+  codec.fillEmptyBuffer(&frame, makeRpcMessage());
+  return static_cast<int64_t>(frame.readableBytes());
+}
+#endif
+
+// round trips over loopback, the client in this loop, the server in an IO thread
+int64_t benchPingpong(EventLoop* loop, int64_t n, size_t size)
+{
+  TcpServer server(loop, kPingpongAddr, "Pong");
+  server.setThreadNum(1);
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+  });
+  server.start();
+
+  const string message(size, 'x');
+  int64_t left = n;
+  int64_t start = 0;
+  int64_t elapsed = 0;
+  TcpClient client(loop, kPingpongAddr, "Ping");
+  client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+      start = nowNs();
+      conn->send(message);
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    while (buf->readableBytes() >= size)
+    {
+      buf->retrieve(size);
+      if (--left == 0)
+      {
+        elapsed = nowNs() - start;
+        loop->quit();
+        return;
+      }
+      conn->send(message);
+    }
+  });
+  client.connect();
+  loop->loop();
+  client.disconnect();
+  loop->runAfter(0.01, std::bind(&EventLoop::quit, loop));
+  loop->loop();
+  return elapsed;
+}
+
+Result runBenchmark(const Benchmark& b, int repeat, bool quick)
+{
+  int64_t n = quick ? std::max<int64_t>(b.iterations / 10, 1) : b.iterations;
+  std::vector<double> samples;
+  for (int i = 0; i < repeat; ++i)
+  {
+    samples.push_back(static_cast<double>(b.run(n)) / static_cast<double>(n));
+  }
+  std::sort(samples.begin(), samples.end());
+  Result r = {b.name, samples[samples.size() / 2], samples.front(), samples.back(), n, b.bytesPerOp};
+  return r;
+}
+
+void writeJson(FILE* fp, const std::vector<Result>& results, int repeat, bool quick)
+{
+  char host[256] = "unknown";
+  ::gethostname(host, sizeof host - 1);
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"context\": {\"host\": \"%s\", \"date\": \"%s\", \"compiler\": \"%s\", "
+              "\"repeat\": %d, \"quick\": %s},\n",
+          host, Timestamp::now().toFormattedString(false).c_str(), __VERSION__,
+          repeat, quick ? "true" : "false");
+  fprintf(fp, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& r = results[i];
+    // one per line, readBaseline() depends on it
+    fprintf(fp, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f, "
+                "\"iterations\": %lld, \"bytes_per_op\": %lld}%s\n",
+            r.name.c_str(), r.nsPerOp, r.minNs, r.maxNs, static_cast<long long>(r.iterations),
+            static_cast<long long>(r.bytesPerOp), i + 1 < results.size() ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+}
+
+// reads what writeJson() wrote
+bool readBaseline(const char* path, std::map<string, double>* baseline)
+{
+  FILE* fp = ::fopen(path, "r");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  char line[1024];
+  while (::fgets(line, sizeof line, fp))
+  {
+    char name[256];
+    double ns = 0;
+    if (::sscanf(line, " {\"name\": \"%255[^\"]\", \"ns_per_op\": %lf", name, &ns) == 2)
+    {
+      (*baseline)[name] = ns;
+    }
+  }
+  ::fclose(fp);
+  return true;
+}
+
+void usage(const char* prog)
+{
+  fprintf(stderr, "Usage: %s [--json FILE] [--baseline FILE] [--tolerance FRACTION]\n"
+                  "          [--filter SUBSTR] [--repeat N] [--quick] [--list]\n", prog);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const char* jsonPath = NULL;
+  const char* baselinePath = NULL;
+  const char* filter = "";
+  double tolerance = 0.10;
+  int repeat = 5;
+  bool quick = false;
+  bool list = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--json") == 0 && hasValue)
+      jsonPath = argv[++i];
+    else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+      baselinePath = argv[++i];
+    else if (strcmp(argv[i], "--tolerance") == 0 && hasValue)
+      tolerance = atof(argv[++i]);
+    else if (strcmp(argv[i], "--filter") == 0 && hasValue)
+      filter = argv[++i];
+    else if (strcmp(argv[i], "--repeat") == 0 && hasValue)
+      repeat = std::max(atoi(argv[++i]), 1);
+    else if (strcmp(argv[i], "--quick") == 0)
+      quick = true;
+    else if (strcmp(argv[i], "--list") == 0)
+      list = true;
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  std::vector<Benchmark> benchmarks = {
+    {"buffer/append_retrieve_64", 20000000, 64, benchAppendRetrieve},
+    {"buffer/append_64x64_retrieveAll", 200000, 4096, benchAppendMany},
+    {"buffer/readFd_4k", 200000, 4096, benchReadFd},
+    {"logstream/int", 10000000, 0, [](int64_t n) { return benchLogStream(n, 1234567); }},
+    {"logstream/double", 2000000, 0, [](int64_t n) { return benchLogStream(n, 3.1415926); }},
+    {"logstream/string", 10000000, 0,
+     [](int64_t n) { return benchLogStream(n, g_name); }},
+    {"timerqueue/add_cancel", 1000000, 0,
+     [&loop](int64_t n) { return benchTimerAddCancel(&loop, n); }},
+    {"eventloop/runInLoop_cross_thread", 1000000, 0, benchRunInLoop},
+    {"threadpool/dispatch", 500000, 0, benchThreadPool},
+#ifdef HAVE_PROTOBUF
+    {"protobuf/encode", 1000000, protobufFrameBytes(), benchProtobufEncode},
+    {"protobuf/decode", 1000000, protobufFrameBytes(), benchProtobufDecode},
+#endif
+    {"pingpong/rtt_64", 20000, 64, [&loop](int64_t n) { return benchPingpong(&loop, n, 64); }},
+    {"pingpong/16k", 20000, 16384, [&loop](int64_t n) { return benchPingpong(&loop, n, 16384); }},
+  };
+
+  std::map<string, double> baseline;
+  if (baselinePath && !readBaseline(baselinePath, &baseline))
+  {
+    fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+    return 2;
+  }
+
+  if (list)
+  {
+    for (const Benchmark& b : benchmarks)
+    {
+      printf("%s\n", b.name.c_str());
+    }
+    return 0;
+  }
+
+  std::vector<Result> results;
+  int regressions = 0;
+  printf("%-34s %10s %10s %10s %9s  %s\n", "benchmark", "ns/op", "min", "max", "MB/s",
+         baselinePath ? "vs baseline" : "");
+  for (const Benchmark& b : benchmarks)
+  {
+    if (b.name.find(filter) == string::npos)
+    {
+      continue;
+    }
+    Result r = runBenchmark(b, repeat, quick);
+    results.push_back(r);
+    char rate[32] = "";
+    if (r.bytesPerOp > 0)
+    {
+      snprintf(rate, sizeof rate, "%.1f", static_cast<double>(r.bytesPerOp) * 1e3 / r.nsPerOp);
+    }
+    char compare[64] = "";
+    if (baselinePath)
+    {
+      std::map<string, double>::const_iterator it = baseline.find(r.name);
+      if (it == baseline.end())
+      {
+        snprintf(compare, sizeof compare, "new");
+      }
+      else
+      {
+        double change = r.nsPerOp / it->second - 1;
+        bool regressed = change > tolerance;
+        regressions += regressed ? 1 : 0;
+        snprintf(compare, sizeof compare, "%+.1f%%%s", change * 100, regressed ? " REGRESSION" : "");
+      }
+    }
+    printf("%-34s %10.1f %10.1f %10.1f %9s  %s\n", r.name.c_str(), r.nsPerOp, r.minNs, r.maxNs,
+           rate, compare);
+    fflush(stdout);
+  }
+
+  if (jsonPath)
+  {
+    FILE* fp = ::fopen(jsonPath, "w");
+    if (fp == NULL)
+    {
+      perror(jsonPath);
+      return 2;
+    }
+    writeJson(fp, results, repeat, quick);
+    ::fclose(fp);
+  }
+  if (regressions > 0)
+  {
+    printf("%d regression(s) beyond %.0f%%\n", regressions, tolerance * 100);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,209 @@
+// Workers forked by PreforkServer share the listen socket, are restarted
+// when they die, and drain on stop().
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/PreforkServer.h"
+#include "muduo/net/TcpServer.h"
+
+#include <functional>
+#include <vector>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE PreforkServerTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const int kWorkers = 2;
+
+// in workers, replies with the pid of the worker
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+  char pid[16];
+  snprintf(pid, sizeof pid, "%d", static_cast<int>(::getpid()));
+  conn->send(pid);
+}
+
+void initWorker(TcpServer* server, int)
+{
+  server->setMessageCallback(onMessage);
+}
+
+InetAddress g_addr("127.0.0.1", 23471);
+
+// pid of the worker serving it, 0 on EOF
+int ask(int fd)
+{
+  char buf[16] = "";
+  if (::write(fd, "?", 1) != 1)
+  {
+    return 0;
+  }
+  ssize_t n = ::read(fd, buf, sizeof buf - 1);
+  return n > 0 ? atoi(buf) : 0;
+}
+
+int connectTo()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, g_addr.getSockAddr(), static_cast<socklen_t>(sizeof(struct sockaddr_in))) < 0)
+  {
+    LOG_SYSFATAL << "connect";
+  }
+  return fd;
+}
+
+typedef std::vector<PreforkServer::WorkerStats> WorkerStatsList;
+
+WorkerStatsList statsOf(PreforkServer* server)
+{
+  std::vector<PreforkServer::WorkerStats> stats;
+  CountDownLatch latch(1);
+  server->getLoop()->runInLoop([&] {
+    stats = server->workerStats();
+    latch.countDown();
+  });
+  latch.wait();
+  return stats;
+}
+
+bool isWorker(const std::vector<PreforkServer::WorkerStats>& stats, int pid)
+{
+  for (const PreforkServer::WorkerStats& worker : stats)
+  {
+    if (worker.pid == pid)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Polls the stats until cond() holds, false if it doesn't within 5s.
+bool waitForStats(PreforkServer* server,
+                  const std::function<bool(const WorkerStatsList&)>& cond,
+                  WorkerStatsList* stats)
+{
+  for (int i = 0; i < 500; ++i)
+  {
+    *stats = statsOf(server);
+    if (cond(*stats))
+    {
+      return true;
+    }
+    CurrentThread::sleepUsec(10 * 1000);
+  }
+  return false;
+}
+
+// seen by the client thread, checked in the main thread
+struct ClientResult
+{
+  WorkerStatsList forked;
+  bool servedByWorker = false;
+  bool published = false;
+  WorkerStatsList serving;
+  bool lost = false;
+  bool restarted = false;
+  WorkerStatsList after;
+  bool servedAfterRestart = false;
+  bool closedByStop = false;
+} g_result;
+
+void client(PreforkServer* server)
+{
+  ClientResult& r = g_result;
+  r.forked = statsOf(server);
+
+  int fd = connectTo();
+  int pid = ask(fd);
+  r.servedByWorker = isWorker(r.forked, pid);
+  // workers publish their stats periodically
+  r.published = waitForStats(server, [](const WorkerStatsList& stats) {
+    return stats[0].connections + stats[1].connections == 1 &&
+        stats[0].rssBytes > 0 && stats[1].rssBytes > 0;
+  }, &r.serving);
+
+  // the worker dies with its connection, and is restarted
+  ::kill(pid, SIGKILL);
+  char buf[16];
+  r.lost = ::read(fd, buf, sizeof buf) <= 0;
+  ::close(fd);
+  r.restarted = waitForStats(server, [pid](const WorkerStatsList& stats) {
+    return !isWorker(stats, pid) && stats[0].pid > 0 && stats[1].pid > 0;
+  }, &r.after);
+
+  fd = connectTo();
+  r.servedAfterRestart = isWorker(r.after, ask(fd));
+
+  // stopping drains, the open connection is closed at the deadline
+  server->getLoop()->runInLoop(std::bind(&PreforkServer::stop, server));
+  r.closedByStop = ::read(fd, buf, sizeof buf) == 0;
+  ::close(fd);
+}
+
+void timeout()
+{
+  LOG_ERROR << "timeout";
+  abort();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testPreforkServer)
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  loop.runAfter(20, timeout);
+  PreforkServer server(&loop, g_addr, "Prefork", kWorkers);
+  server.setWorkerInitCallback(initWorker);
+  server.setDrainTimeout(0.5);
+  bool stopped = false;
+  server.setStoppedCallback([&] {
+    stopped = true;
+    loop.quit();
+  });
+  server.start();
+
+  Thread thread(std::bind(client, &server), "Client");
+  thread.start();
+  loop.loop();
+  thread.join();
+
+  const ClientResult& r = g_result;
+  // workers forked
+  BOOST_REQUIRE_EQUAL(r.forked.size(), kWorkers);
+  BOOST_CHECK_GT(r.forked[0].pid, 0);
+  BOOST_CHECK_GT(r.forked[1].pid, 0);
+  BOOST_CHECK(r.servedByWorker);
+  // connections and memory published
+  BOOST_CHECK(r.published);
+
+  BOOST_CHECK(r.lost);
+  BOOST_CHECK(r.restarted);
+  BOOST_REQUIRE_EQUAL(r.after.size(), kWorkers);
+  BOOST_CHECK_EQUAL(r.after[0].restarts + r.after[1].restarts, 1);
+  BOOST_CHECK(r.servedAfterRestart);
+  BOOST_CHECK(r.closedByStop);
+
+  // all workers stopped
+  WorkerStatsList stats = server.workerStats();
+  BOOST_CHECK(stopped);
+  BOOST_CHECK_EQUAL(stats[0].pid, 0);
+  BOOST_CHECK_EQUAL(stats[1].pid, 0);
+}
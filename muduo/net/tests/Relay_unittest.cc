@@ -0,0 +1,162 @@
+// client -> relay proxy -> echo server, all in one loop, checks echoed bytes.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/Relay.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <map>
+
+#include <string.h>
+
+//#define BOOST_TEST_MODULE RelayTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const size_t kMessageSize = 8 * 1024 * 1024;
+
+EventLoop* g_loop;
+InetAddress* g_backendAddr;
+std::map<string, std::shared_ptr<TcpClient> > g_backends;
+RelayPtr g_relay;
+
+void onEchoMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onBackendConnection(const std::weak_ptr<TcpConnection>& weakFrontend,
+                         const TcpConnectionPtr& conn)
+{
+  TcpConnectionPtr frontend(weakFrontend.lock());
+  if (conn->connected() && frontend)
+  {
+    g_relay = Relay::start(frontend, conn);
+    if (!g_relay)
+    {
+      LOG_FATAL << "Relay::start";
+    }
+    frontend->startRead();
+  }
+}
+
+void onProxyConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // don't read until backend is connected
+    conn->stopRead();
+    std::shared_ptr<TcpClient> backend(new TcpClient(g_loop, *g_backendAddr, conn->name()));
+    backend->setConnectionCallback(std::bind(onBackendConnection, std::weak_ptr<TcpConnection>(conn), _1));
+    g_backends[conn->name()] = backend;
+    backend->connect();
+  }
+}
+
+class Client
+{
+ public:
+  Client(EventLoop* loop, const InetAddress& serverAddr)
+    : client_(loop, serverAddr, "RelayClient"),
+      received_(0),
+      ok_(false),
+      closed_(false)
+  {
+    client_.setConnectionCallback(
+        std::bind(&Client::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Client::onMessage, this, _1, _2, _3));
+    for (size_t i = 0; i < kMessageSize; ++i)
+    {
+      message_.push_back(static_cast<char>('A' + i % 61));
+    }
+  }
+
+  void connect() { client_.connect(); }
+  bool ok() const { return ok_; }
+  bool closed() const { return closed_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      conn->send(message_);
+    }
+    else
+    {
+      closed_ = true;
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    size_t n = buf->readableBytes();
+    if (received_ + n > message_.size()
+        || memcmp(buf->peek(), message_.data() + received_, n) != 0)
+    {
+      LOG_ERROR << "mismatch at " << received_;
+      conn->forceClose();
+    }
+    received_ += n;
+    buf->retrieveAll();
+    if (received_ == message_.size())
+    {
+      ok_ = true;
+      // relay passes the FIN to backend, which closes, and the relay closes us.
+      conn->shutdown();
+    }
+  }
+
+  TcpClient client_;
+  string message_;
+  size_t received_;
+  bool ok_;
+  bool closed_;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testRelay)
+{
+  EventLoop loop;
+  g_loop = &loop;
+  {
+    InetAddress backendAddr("127.0.0.1", 23458);
+    g_backendAddr = &backendAddr;
+    TcpServer echo(&loop, backendAddr, "EchoServer");
+    echo.setMessageCallback(onEchoMessage);
+    echo.start();
+
+    InetAddress proxyAddr("127.0.0.1", 23459);
+    TcpServer proxy(&loop, proxyAddr, "RelayProxy");
+    proxy.setConnectionCallback(onProxyConnection);
+    proxy.start();
+
+    Client client(&loop, proxyAddr);
+    client.connect();
+    BOOST_CHECK(runUntil(&loop, [&client] { return client.closed(); }, 30));
+
+    // all echoed, spliced both ways
+    BOOST_CHECK(client.ok());
+    BOOST_REQUIRE(g_relay);
+    BOOST_CHECK_EQUAL(g_relay->bytesFromA(), static_cast<int64_t>(kMessageSize));
+    BOOST_CHECK_EQUAL(g_relay->bytesFromB(), static_cast<int64_t>(kMessageSize));
+    g_relay.reset();
+    g_backends.clear();
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
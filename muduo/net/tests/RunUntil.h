@@ -0,0 +1,60 @@
+// Helpers of the loopback tests, waiting for a condition rather than a
+// fixed time.
+
+#ifndef MUDUO_NET_TESTS_RUNUNTIL_H
+#define MUDUO_NET_TESTS_RUNUNTIL_H
+
+#include "muduo/net/EventLoop.h"
+
+#include <functional>
+
+namespace muduo
+{
+namespace net
+{
+namespace test
+{
+
+// Runs loop until cond() holds, checked every 10ms, false if it doesn't
+// within timeout seconds. Callbacks quitting the loop don't stop the wait.
+inline bool runUntil(EventLoop* loop, const std::function<bool()>& cond, double timeout = 10)
+{
+  if (cond())
+  {
+    return true;
+  }
+  bool done = false;
+  bool expired = false;
+  TimerId poll = loop->runEvery(0.01, [&] {
+    if (cond())
+    {
+      done = true;
+      loop->quit();
+    }
+  });
+  TimerId expire = loop->runAfter(timeout, [&] {
+    expired = true;
+    loop->quit();
+  });
+  while (!done && !expired)
+  {
+    loop->loop();
+  }
+  loop->cancel(poll);
+  loop->cancel(expire);
+  return done;
+}
+
+// Runs loop for seconds, for what can't be waited on, eg. connections
+// still closing after their servers and clients are gone.
+inline void runFor(EventLoop* loop, double seconds)
+{
+  loop->runAfter(seconds, std::bind(&EventLoop::quit, loop));
+  loop->loop();
+}
+
+}  // namespace test
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TESTS_RUNUNTIL_H
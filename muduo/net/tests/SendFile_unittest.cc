@@ -0,0 +1,154 @@
+// sendFile() interleaved with send(), checked byte by byte over loopback.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE SendFileTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const size_t kFileSize = 8 * 1024 * 1024;
+
+string g_expected;
+int g_fd = -1;
+int g_badFd = -1;  // not open for reading, sendfile(2) fails with EBADF
+int g_completed = 0;
+int g_failed = 0;
+
+void onFileSent(const TcpConnectionPtr& conn, bool complete)
+{
+  LOG_INFO << conn->name() << " file sent " << (complete ? "complete" : "aborted");
+  if (complete)
+  {
+    ++g_completed;
+  }
+  else
+  {
+    ++g_failed;
+  }
+}
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // header, two regions of the same file, a trailer between and after,
+    // regions that can't be sent are skipped, sent directly or queued
+    conn->sendFile(g_badFd, 0, 100, onFileSent);
+    conn->send("HEADER\r\n");
+    conn->sendFile(g_fd, 0, kFileSize, onFileSent);
+    conn->send("MIDDLE\r\n");
+    conn->sendFile(g_badFd, 0, 100, onFileSent);
+    conn->sendFile(g_fd, 100, 1000, onFileSent);
+    conn->send("TRAILER\r\n");
+    conn->shutdown();
+  }
+}
+
+class Client
+{
+ public:
+  Client(EventLoop* loop, const InetAddress& serverAddr)
+    : client_(loop, serverAddr, "SendFileClient"),
+      received_(0),
+      inOrder_(true),
+      closed_(false)
+  {
+    client_.setConnectionCallback(
+        std::bind(&Client::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Client::onMessage, this, _1, _2, _3));
+  }
+
+  void connect() { client_.connect(); }
+  size_t received() const { return received_; }
+  bool inOrder() const { return inOrder_; }
+  bool closed() const { return closed_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (!conn->connected())
+    {
+      closed_ = true;
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    size_t n = buf->readableBytes();
+    if (received_ + n > g_expected.size()
+        || memcmp(buf->peek(), g_expected.data() + received_, n) != 0)
+    {
+      LOG_ERROR << "mismatch at " << received_;
+      inOrder_ = false;
+      conn->forceClose();
+    }
+    received_ += n;
+    buf->retrieveAll();
+  }
+
+  TcpClient client_;
+  size_t received_;
+  bool inOrder_;
+  bool closed_;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testSendFile)
+{
+  char path[] = "/tmp/muduo_sendfile_XXXXXX";
+  g_fd = ::mkstemp(path);
+  BOOST_REQUIRE_GE(g_fd, 0);
+  ::unlink(path);
+  g_badFd = ::open("/dev/null", O_WRONLY);
+
+  string content;
+  for (size_t i = 0; i < kFileSize; ++i)
+  {
+    content.push_back(static_cast<char>('A' + i % 61));
+  }
+  BOOST_REQUIRE_EQUAL(::write(g_fd, content.data(), content.size()),
+                      static_cast<ssize_t>(content.size()));
+  g_expected = "HEADER\r\n" + content + "MIDDLE\r\n" + content.substr(100, 1000) + "TRAILER\r\n";
+
+  EventLoop loop;
+  {
+    InetAddress listenAddr("127.0.0.1", 23457);
+    TcpServer server(&loop, listenAddr, "SendFileServer");
+    server.setConnectionCallback(onServerConnection);
+    server.start();
+    Client client(&loop, listenAddr);
+    client.connect();
+    // the server shuts down after the trailer
+    BOOST_CHECK(runUntil(&loop, [&client] { return client.closed(); }, 30));
+    BOOST_CHECK(client.inOrder());
+    BOOST_CHECK_EQUAL(client.received(), g_expected.size());
+    // the bad regions are given up, the rest are complete
+    BOOST_CHECK_EQUAL(g_completed, 2);
+    BOOST_CHECK_EQUAL(g_failed, 2);
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+  ::close(g_fd);
+  ::close(g_badFd);
+}
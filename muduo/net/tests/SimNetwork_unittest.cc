@@ -0,0 +1,263 @@
+// TcpServer and TcpClient over SimNetwork: virtual time, exact latency,
+// bandwidth and backpressure, loss and reordering reproduced by the seed,
+// reconnecting with back-off, all in a fraction of the real time.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SimNetwork.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <memory>
+
+#include <math.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+//#define BOOST_TEST_MODULE SimNetworkTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// Timestamp::now() is virtual in here
+double wallSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+// lets connections still closing finish, after servers and clients are gone
+void closeAll(EventLoop* loop)
+{
+  loop->runAfter(1, std::bind(&EventLoop::quit, loop));
+  loop->loop();
+}
+
+char patternAt(size_t k)
+{
+  return static_cast<char>(k % 251);
+}
+
+struct Transfer
+{
+  double seconds;
+  bool highWater;
+  bool intact;
+  int64_t lost;
+  int64_t reordered;
+};
+
+Transfer runTransfer(const SimNetwork::Link& link, uint64_t seed, size_t total)
+{
+  SimNetwork net(seed);
+  net.setLink(link);
+  EventLoop loop;
+  loop.runAfter(600, std::bind(&EventLoop::quit, &loop));
+  InetAddress addr("127.0.0.1", 2001);
+  Transfer result = {0, false, true, 0, 0};
+  Timestamp start;
+  size_t received = 0;
+
+  {
+    TcpServer server(&loop, addr, "Sink");
+    server.setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+      for (size_t i = 0; i < buf->readableBytes(); ++i)
+      {
+        result.intact = result.intact && buf->peek()[i] == patternAt(received + i);
+      }
+      received += buf->readableBytes();
+      buf->retrieveAll();
+      if (received == total)
+      {
+        result.seconds = timeDifference(Timestamp::now(), start);
+        loop.quit();
+      }
+    });
+    server.start();
+
+    TcpClient client(&loop, addr, "Source");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        conn->setHighWaterMarkCallback(
+            [&](const TcpConnectionPtr&, size_t) { result.highWater = true; }, 128 * 1024);
+        string data(total, '\0');
+        for (size_t i = 0; i < total; ++i)
+        {
+          data[i] = patternAt(i);
+        }
+        start = Timestamp::now();
+        conn->send(data);
+      }
+    });
+    client.connect();
+    loop.loop();
+  }
+  closeAll(&loop);
+  result.intact = result.intact && received == total;
+  result.lost = net.segmentsLost();
+  result.reordered = net.segmentsReordered();
+  return result;
+}
+
+struct WarnLogLevel
+{
+  WarnLogLevel() { Logger::setLogLevel(Logger::WARN); }
+};
+
+}  // namespace
+
+BOOST_GLOBAL_FIXTURE(WarnLogLevel);
+
+BOOST_AUTO_TEST_CASE(testClock)
+{
+  SimNetwork net;
+  EventLoop loop;
+  double wallStart = wallSeconds();
+  Timestamp start = Timestamp::now();
+  // now() is virtual
+  BOOST_CHECK(start == net.now());
+  loop.runAfter(3600, std::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  // an hour passes in no time
+  double elapsed = timeDifference(Timestamp::now(), start);
+  BOOST_CHECK_GE(elapsed, 3600);
+  BOOST_CHECK_LT(elapsed, 3600.002);
+  BOOST_CHECK_LT(wallSeconds() - wallStart, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(testLatency)
+{
+  SimNetwork net;
+  SimNetwork::Link link;
+  link.latency = 0.05;
+  net.setLink(link);
+  EventLoop loop;
+  loop.runAfter(60, std::bind(&EventLoop::quit, &loop));
+  {
+    InetAddress addr("127.0.0.1", 2000);
+    TcpServer server(&loop, addr, "Echo");
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+      conn->send(buf);
+    });
+    server.start();
+
+    Timestamp start = Timestamp::now();
+    Timestamp connected;
+    Timestamp sent;
+    Timestamp echoed;
+    string reply;
+    TcpClient client(&loop, addr, "Client");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        connected = sent = Timestamp::now();
+        conn->send("ping");
+      }
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+      echoed = Timestamp::now();
+      reply = buf->retrieveAllAsString();
+      loop.quit();
+    });
+    client.connect();
+    loop.loop();
+    BOOST_CHECK_EQUAL(reply, "ping");
+    // connected and echoed after one RTT each
+    BOOST_CHECK_LT(fabs(timeDifference(connected, start) - 0.1), 1e-4);
+    BOOST_CHECK_LT(fabs(timeDifference(echoed, sent) - 0.1), 1e-4);
+  }
+  closeAll(&loop);
+}
+
+BOOST_AUTO_TEST_CASE(testBandwidth)
+{
+  SimNetwork::Link link;
+  link.latency = 0.01;
+  link.bandwidth = 1000 * 1000;
+  link.bufferBytes = 64 * 1024;
+  Transfer t = runTransfer(link, 1, 1000 * 1000);
+  printf("1MB at 1MB/s in %.4fs\n", t.seconds);
+  // all bytes in order, at the rate of the link
+  BOOST_CHECK(t.intact);
+  BOOST_CHECK_GE(t.seconds, 1.0);
+  BOOST_CHECK_LT(t.seconds, 1.05);
+  // backpressure reaches the output buffer
+  BOOST_CHECK(t.highWater);
+}
+
+BOOST_AUTO_TEST_CASE(testLossAndReorder)
+{
+  SimNetwork::Link link;
+  link.latency = 0.01;
+  link.bandwidth = 10 * 1000 * 1000;
+  link.lossRate = 0.01;
+  link.reorderRate = 0.05;
+  const size_t kTotal = 1024 * 1024;
+  Transfer a = runTransfer(link, 7, kTotal);
+  Transfer b = runTransfer(link, 7, kTotal);
+  Transfer c = runTransfer(link, 8, kTotal);
+  link.lossRate = 0;
+  link.reorderRate = 0;
+  Transfer clean = runTransfer(link, 7, kTotal);
+  printf("lossy %.4fs, %lld lost %lld reordered; clean %.4fs\n", a.seconds,
+         static_cast<long long>(a.lost), static_cast<long long>(a.reordered), clean.seconds);
+  // all bytes in order, segments lost and reordered
+  BOOST_CHECK(a.intact);
+  BOOST_CHECK(c.intact);
+  BOOST_CHECK_GT(a.lost, 0);
+  BOOST_CHECK_GT(a.reordered, 0);
+  // the same seed, the same run, another seed, another run
+  BOOST_CHECK_EQUAL(a.seconds, b.seconds);
+  BOOST_CHECK_EQUAL(a.lost, b.lost);
+  BOOST_CHECK_EQUAL(a.reordered, b.reordered);
+  BOOST_CHECK(a.lost != c.lost || a.seconds != c.seconds);
+  // retransmits stall the stream
+  BOOST_CHECK_GT(a.seconds, clean.seconds + link.rto);
+}
+
+BOOST_AUTO_TEST_CASE(testReconnect)
+{
+  SimNetwork net;
+  EventLoop loop;
+  loop.runAfter(60, std::bind(&EventLoop::quit, &loop));
+  {
+    InetAddress addr("127.0.0.1", 2002);
+    std::unique_ptr<TcpServer> server;
+    loop.runAfter(3, [&] {
+      server.reset(new TcpServer(&loop, addr, "Late"));
+      server->start();
+    });
+
+    Timestamp start = Timestamp::now();
+    Timestamp connected;
+    TcpClient client(&loop, addr, "Retry");
+    client.enableRetry();
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        connected = Timestamp::now();
+        loop.quit();
+      }
+    });
+    Logger::LogLevel level = Logger::logLevel();
+    Logger::setLogLevel(Logger::ERROR);  // refused connects warn
+    client.connect();
+    loop.loop();
+    Logger::setLogLevel(level);
+    double seconds = timeDifference(connected, start);
+    printf("connected after %.4fs\n", seconds);
+    // refused at 0, 0.5 and 1.5, the back-off retries at 3.5
+    BOOST_CHECK(connected.valid());
+    BOOST_CHECK_LT(fabs(seconds - 3.5), 0.01);
+  }
+  closeAll(&loop);
+}
@@ -0,0 +1,128 @@
+// Output to a client that doesn't read spills to a file beyond the memory
+// threshold, and reaches the client in order once it reads.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE SpillTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const size_t kChunk = 64 * 1024;
+const int kChunks = 256;  // 16 MiB
+const size_t kMemory = 256 * 1024;
+
+// byte k of the stream is k % 251
+char patternAt(size_t k)
+{
+  return static_cast<char>(k % 251);
+}
+
+TcpConnectionPtr g_serverConn;
+size_t g_maxMemory = 0;
+size_t g_maxSpilled = 0;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_serverConn = conn;
+    conn->setSpill(kMemory);
+    size_t offset = 0;
+    for (int i = 0; i < kChunks; ++i)
+    {
+      string chunk(kChunk, '\0');
+      for (size_t j = 0; j < kChunk; ++j)
+      {
+        chunk[j] = patternAt(offset + j);
+      }
+      conn->send(chunk);
+      offset += kChunk;
+      g_maxMemory = std::max(g_maxMemory, conn->bufferedBytes());
+      g_maxSpilled = std::max(g_maxSpilled, conn->spilledBytes());
+    }
+  }
+}
+
+size_t g_received = 0;
+bool g_inOrder = true;
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->stopRead();
+  }
+}
+
+void onClientMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  for (size_t i = 0; i < buf->readableBytes(); ++i)
+  {
+    if (buf->peek()[i] != patternAt(g_received + i))
+    {
+      g_inOrder = false;
+    }
+  }
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testSpill)
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  {
+    InetAddress addr("127.0.0.1", 23476);
+    TcpServer server(&loop, addr, "Spill");
+    server.setConnectionCallback(onServerConnection);
+    server.start();
+
+    TcpClient client(&loop, addr, "Slow");
+    client.setConnectionCallback(onClientConnection);
+    client.setMessageCallback(onClientMessage);
+    client.connect();
+    // the server sends it all in its connection callback
+    BOOST_REQUIRE(runUntil(&loop, [&client] { return g_serverConn && client.connection(); }));
+    // nothing to wait for, the client doesn't read meanwhile
+    runFor(&loop, 0.1);
+
+    printf("max memory %zd, max spilled %zd\n", g_maxMemory, g_maxSpilled);
+    // memory capped, the rest spilled to file
+    BOOST_CHECK_LE(g_maxMemory, kMemory + kChunk);
+    BOOST_CHECK_GE(g_maxSpilled, kChunks * kChunk / 4);
+    // client not reading
+    BOOST_CHECK_EQUAL(g_received, 0);
+
+    client.connection()->startRead();
+    BOOST_CHECK(runUntil(&loop, [] {
+      return g_received == kChunks * kChunk &&
+          g_serverConn->spilledBytes() == 0 && g_serverConn->bufferedBytes() == 0;
+    }));
+    BOOST_CHECK_EQUAL(g_received, kChunks * kChunk);
+    BOOST_CHECK(g_inOrder);
+    // spill file drained
+    BOOST_CHECK_EQUAL(g_serverConn->spilledBytes(), 0);
+    BOOST_CHECK_EQUAL(g_serverConn->bufferedBytes(), 0);
+    g_serverConn.reset();
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
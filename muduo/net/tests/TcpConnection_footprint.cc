@@ -0,0 +1,138 @@
+// Memory of idle TcpConnections, with and without compact connections.
+// usage: tcpconnection_footprint [connections] [compact]
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <vector>
+
+using namespace muduo;
+using namespace muduo::net;
+
+int64_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+#else
+  struct mallinfo mi = mallinfo();
+#endif
+  return static_cast<int64_t>(mi.uordblks) + static_cast<int64_t>(mi.hblkhd);
+}
+
+int64_t residentBytes()
+{
+  long pages = 0, resident = 0;
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    fclose(fp);
+  }
+  return static_cast<int64_t>(resident) * ProcessInfo::pageSize();
+}
+
+// both ends are in this process
+int raiseFileLimit(int connections)
+{
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rlim_t wanted = static_cast<rlim_t>(connections) * 2 + 64;
+  if (rl.rlim_cur < wanted)
+  {
+    rl.rlim_cur = std::min(wanted, rl.rlim_max);
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  return static_cast<int>((rl.rlim_cur - 64) / 2);
+}
+
+int main(int argc, char* argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 10000;
+  bool compact = argc > 2 ? atoi(argv[2]) != 0 : true;
+  int limit = raiseFileLimit(connections);
+  if (connections > limit)
+  {
+    printf("open files limit, %d connections instead of %d\n", limit, connections);
+    connections = limit;
+  }
+  Logger::setLogLevel(Logger::WARN);
+
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 23467);
+  TcpServer server(&loop, listenAddr, "Footprint");
+  server.setCompactConnections(compact);
+  // echo, so each connection has read and written once
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+  });
+  server.start();
+
+  std::vector<int> clients;
+  clients.reserve(connections);
+  loop.runAfter(0.1, [&loop] { loop.quit(); });
+  loop.loop();
+  int64_t heapBefore = heapInUse();
+  int64_t rssBefore = residentBytes();
+
+  // a few at a time, not to overflow the listen backlog
+  const int kBatch = 100;
+  while (static_cast<int>(clients.size()) < connections)
+  {
+    for (int i = 0; i < kBatch && static_cast<int>(clients.size()) < connections; ++i)
+    {
+      int fd = sockets::createNonblockingOrDie(AF_INET);
+      sockets::connect(fd, listenAddr.getSockAddr());
+      clients.push_back(fd);
+    }
+    while (server.numConnections() < static_cast<int>(clients.size()))
+    {
+      loop.runAfter(0.001, [&loop] { loop.quit(); });
+      loop.loop();
+    }
+  }
+  for (int fd : clients)
+  {
+    if (::write(fd, "hello\n", 6) != 6)
+    {
+      LOG_SYSERR << "write";
+    }
+  }
+  loop.runAfter(0.5, [&loop] { loop.quit(); });
+  loop.loop();
+
+  int64_t heap = heapInUse() - heapBefore;
+  int64_t rss = residentBytes() - rssBefore;
+  printf("sizeof(TcpConnection) = %zd\nsizeof(Channel) = %zd\nsizeof(Buffer) = %zd\n",
+         sizeof(TcpConnection), sizeof(Channel), sizeof(Buffer));
+  printf("connections = %d\ncompact = %d\n", server.numConnections(), compact);
+  printf("heap bytes per connection = %.1f\nRSS bytes per connection = %.1f\n",
+         static_cast<double>(heap) / connections,
+         static_cast<double>(rss) / connections);
+
+  for (int fd : clients)
+  {
+    // read the echo, or close() sends RST
+    char buf[16];
+    if (sockets::read(fd, buf, sizeof buf) != 6)
+    {
+      LOG_SYSERR << "read";
+    }
+    sockets::close(fd);
+  }
+  loop.runAfter(0.5, [&loop] { loop.quit(); });
+  loop.loop();
+}
@@ -0,0 +1,239 @@
+// Connection ids, names and per IO loop registries of TcpServer,
+// including destructing the server with connections in other loops,
+// batched and deferred accept, idle timeout.
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+//#define BOOST_TEST_MODULE TcpServerTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const int kClients = 64;
+
+MutexLock g_mutex;
+std::set<int64_t> g_ids GUARDED_BY(g_mutex);
+std::set<string> g_names GUARDED_BY(g_mutex);
+std::set<EventLoop*> g_loops GUARDED_BY(g_mutex);
+int g_up GUARDED_BY(g_mutex) = 0;
+int g_down GUARDED_BY(g_mutex) = 0;
+
+// in IO loops
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  MutexLockGuard lock(g_mutex);
+  if (conn->connected())
+  {
+    ++g_up;
+    g_ids.insert(conn->id());
+    g_names.insert(conn->name());
+    g_loops.insert(conn->getLoop());
+  }
+  else
+  {
+    ++g_down;
+  }
+}
+
+int g_clientsDown = 0;
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    ++g_clientsDown;
+  }
+}
+
+typedef std::shared_ptr<TcpClient> TcpClientPtr;
+
+AtomicInt32 g_accepted;
+
+void countConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_accepted.increment();
+  }
+}
+
+void sayHello(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->send("hello");
+  }
+}
+
+int upCount()
+{
+  MutexLockGuard lock(g_mutex);
+  return g_up;
+}
+
+int downCount()
+{
+  MutexLockGuard lock(g_mutex);
+  return g_down;
+}
+
+struct WarnLogLevel
+{
+  WarnLogLevel() { Logger::setLogLevel(Logger::WARN); }
+};
+
+}  // namespace
+
+BOOST_GLOBAL_FIXTURE(WarnLogLevel);
+
+BOOST_AUTO_TEST_CASE(testConnectionIds)
+{
+  EventLoop loop;
+  InetAddress addr("127.0.0.1", 23466);
+  std::unique_ptr<TcpServer> server(new TcpServer(&loop, addr, "Srv"));
+  server->setThreadNum(4);
+  server->setConnectionCallback(onServerConnection);
+  server->start();
+
+  std::vector<TcpClientPtr> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    TcpClientPtr client(new TcpClient(&loop, addr, "Client"));
+    client->setConnectionCallback(onClientConnection);
+    client->connect();
+    clients.push_back(client);
+  }
+  BOOST_CHECK(runUntil(&loop, [] { return upCount() == kClients; }));
+  BOOST_CHECK_EQUAL(server->numConnections(), kClients);
+  {
+    MutexLockGuard lock(g_mutex);
+    // ids are 1..n, names are unique
+    BOOST_CHECK_EQUAL(g_ids.size(), kClients);
+    BOOST_CHECK_EQUAL(*g_ids.begin(), 1);
+    BOOST_CHECK_EQUAL(*g_ids.rbegin(), kClients);
+    BOOST_CHECK_EQUAL(g_names.size(), kClients);
+    BOOST_CHECK_EQUAL(g_names.count("Srv-127.0.0.1:23466#1"), 1);
+    // spread over IO loops
+    BOOST_CHECK_EQUAL(g_loops.size(), 4);
+  }
+
+  for (int i = 0; i < kClients / 2; ++i)
+  {
+    clients[i]->disconnect();
+  }
+  BOOST_CHECK(runUntil(&loop, [] { return downCount() == kClients / 2; }));
+  BOOST_CHECK_EQUAL(server->numConnections(), kClients / 2);
+
+  // the rest are closed by the server, in their IO loops
+  server.reset();
+  BOOST_CHECK_EQUAL(downCount(), kClients);
+  BOOST_CHECK(runUntil(&loop, [] { return g_clientsDown == kClients; }));
+
+  clients.clear();
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testAcceptBatch)
+{
+  EventLoop loop;
+  g_accepted.getAndSet(0);
+  {
+    // a burst accepted in batches
+    InetAddress addr("127.0.0.1", 23468);
+    TcpServer server(&loop, addr, "Batch");
+    server.setThreadNum(4);
+    server.setAcceptBatch(16);
+    server.setExclusiveAccept();
+    server.setConnectionCallback(countConnection);
+    server.start();
+    std::vector<TcpClientPtr> clients;
+    for (int i = 0; i < kClients; ++i)
+    {
+      TcpClientPtr client(new TcpClient(&loop, addr, "Client"));
+      client->connect();
+      clients.push_back(client);
+    }
+    BOOST_CHECK(runUntil(&loop, [] { return g_accepted.get() == kClients; }));
+    BOOST_CHECK_EQUAL(server.numConnections(), kClients);
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testDeferAccept)
+{
+  EventLoop loop;
+  g_accepted.getAndSet(0);
+  {
+    // deferred accept waits for the first bytes
+    InetAddress addr("127.0.0.1", 23469);
+    TcpServer server(&loop, addr, "Defer");
+    server.setDeferAccept(5);
+    server.setConnectionCallback(countConnection);
+    server.start();
+    TcpClient silent(&loop, addr, "Silent");
+    silent.connect();
+    // nothing to wait for, not accepted before data
+    runFor(&loop, 0.3);
+    BOOST_CHECK_EQUAL(g_accepted.get(), 0);
+    TcpClient talker(&loop, addr, "Talker");
+    talker.setConnectionCallback(sayHello);
+    talker.connect();
+    BOOST_CHECK(runUntil(&loop, [] { return g_accepted.get() == 1; }));
+  }
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testIdleTimeout)
+{
+  EventLoop loop;
+  {
+    // the quiet client is closed, the talking one is kept
+    InetAddress addr("127.0.0.1", 23472);
+    TcpServer server(&loop, addr, "Idle");
+    server.setThreadNum(2);
+    server.setIdleTimeout(0.4);
+    server.start();
+    TcpClient quiet(&loop, addr, "Quiet");
+    quiet.connect();
+    TcpClient talker(&loop, addr, "Talker");
+    talker.connect();
+    TimerId talking = loop.runEvery(0.1, [&talker] {
+      TcpConnectionPtr conn = talker.connection();
+      if (conn)
+      {
+        conn->send("x");
+      }
+    });
+    BOOST_CHECK(runUntil(&loop, [&server] { return server.numIdleClosed() == 1; }, 3));
+    // the talker outlives another timeout
+    runFor(&loop, 0.5);
+    loop.cancel(talking);
+    BOOST_CHECK_EQUAL(server.numIdleClosed(), 1);
+    BOOST_CHECK_EQUAL(server.numConnections(), 1);
+    // the client sees the close
+    BOOST_CHECK(!quiet.connection());
+    TcpConnectionPtr conn = talker.connection();
+    BOOST_CHECK(conn && conn->connected());
+  }
+  runFor(&loop, 0.1);
+}
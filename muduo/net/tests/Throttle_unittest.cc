@@ -0,0 +1,164 @@
+// A forwarder copies a producer to a consumer that doesn't read for a while,
+// the consumer throttles the producer so the forwarder's output stays bounded.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE ThrottleTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const size_t kMessageSize = 32 * 1024 * 1024;
+const size_t kHighWaterMark = 1024 * 1024;
+const size_t kLowWaterMark = 256 * 1024;
+
+TcpConnectionPtr g_consumer;  // server side
+size_t g_maxBuffered = 0;
+
+void onForwarderConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    return;
+  }
+  if (!g_consumer)
+  {
+    g_consumer = conn;
+    conn->setHighWaterMark(kHighWaterMark);
+    conn->setLowWaterMark(kLowWaterMark);
+  }
+  else
+  {
+    g_consumer->throttle(conn);
+  }
+}
+
+void onForwarderMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  if (g_consumer && conn != g_consumer)
+  {
+    g_consumer->send(buf);
+    g_maxBuffered = std::max(g_maxBuffered, g_consumer->outputBuffer()->readableBytes());
+  }
+  buf->retrieveAll();
+}
+
+class Consumer
+{
+ public:
+  Consumer(EventLoop* loop, const InetAddress& serverAddr)
+    : client_(loop, serverAddr, "Consumer"),
+      received_(0),
+      inOrder_(true)
+  {
+    client_.setConnectionCallback(
+        std::bind(&Consumer::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Consumer::onMessage, this, _1, _2, _3));
+  }
+
+  void connect() { client_.connect(); }
+  bool connected() const { return client_.connection() != nullptr; }
+  void startRead() { client_.connection()->startRead(); }
+  size_t received() const { return received_; }
+  bool inOrder() const { return inOrder_; }
+  bool done() const { return !inOrder_ || received_ == kMessageSize; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      // a slow consumer
+      conn->stopRead();
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    const char* data = buf->peek();
+    for (size_t i = 0; i < buf->readableBytes(); ++i)
+    {
+      if (data[i] != static_cast<char>('A' + (received_ + i) % 61))
+      {
+        LOG_ERROR << "mismatch at " << received_ + i;
+        inOrder_ = false;
+        break;
+      }
+    }
+    received_ += buf->readableBytes();
+    buf->retrieveAll();
+  }
+
+  TcpClient client_;
+  size_t received_;
+  bool inOrder_;
+};
+
+void onProducerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    string message;
+    for (size_t i = 0; i < kMessageSize; ++i)
+    {
+      message.push_back(static_cast<char>('A' + i % 61));
+    }
+    conn->send(message);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testThrottle)
+{
+  EventLoop loop;
+  {
+    InetAddress listenAddr("127.0.0.1", 23460);
+    TcpServer forwarder(&loop, listenAddr, "Forwarder");
+    forwarder.setConnectionCallback(onForwarderConnection);
+    forwarder.setMessageCallback(onForwarderMessage);
+    forwarder.start();
+
+    // the first connection is the consumer
+    Consumer consumer(&loop, listenAddr);
+    consumer.connect();
+    BOOST_REQUIRE(runUntil(&loop, [&consumer] { return g_consumer && consumer.connected(); }));
+    TcpClient producer(&loop, listenAddr, "Producer");
+    producer.setConnectionCallback(onProducerConnection);
+    producer.connect();
+
+    // the producer is paused once the consumer reaches high water,
+    // nothing to wait for, the output stays there while it doesn't read
+    BOOST_CHECK(runUntil(&loop, [] { return g_maxBuffered >= kHighWaterMark; }));
+    runFor(&loop, 0.2);
+    BOOST_CHECK_EQUAL(consumer.received(), 0);
+    // one read of the producer may land on top of high water
+    BOOST_CHECK_LT(g_maxBuffered, 2 * kHighWaterMark);
+
+    consumer.startRead();
+    BOOST_CHECK(runUntil(&loop, [&consumer] { return consumer.done(); }, 30));
+    BOOST_CHECK(consumer.inOrder());
+    BOOST_CHECK_EQUAL(consumer.received(), kMessageSize);
+    BOOST_CHECK_LT(g_maxBuffered, 2 * kHighWaterMark);
+    printf("max buffered %zu\n", g_maxBuffered);
+    g_consumer.reset();
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
@@ -0,0 +1,140 @@
+// Timers expired through the poll timeout instead of a timerfd,
+// and timer slack aligning runEvery() timers.
+
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+
+#include <vector>
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE TimerPollTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+struct Fired
+{
+  int id;
+  Timestamp due;
+  Timestamp at;
+};
+
+std::vector<Fired> g_fired;
+
+void fire(int id, Timestamp due)
+{
+  Fired fired = { id, due, Timestamp::now() };
+  g_fired.push_back(fired);
+}
+
+TimerId after(EventLoop* loop, int id, double delay)
+{
+  return loop->runAfter(delay, std::bind(fire, id, addTime(Timestamp::now(), delay)));
+}
+
+// microseconds per runAfter() and cancel(), each timer the earliest
+double addAndCancel(EventLoop* loop, int n)
+{
+  std::vector<TimerId> timers;
+  timers.reserve(n);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    timers.push_back(loop->runAfter(10.0 - i * 1e-5, [] {}));
+  }
+  for (const TimerId& timer : timers)
+  {
+    loop->cancel(timer);
+  }
+  return timeDifference(Timestamp::now(), start) * 1e6 / n;
+}
+
+}  // namespace
+
+// The fixed waits below are what the timers are checked against, no
+// polling timer may wake the loop in between.
+
+BOOST_AUTO_TEST_CASE(testPollTimeout)
+{
+  EventLoop loop;
+  loop.setTimerfd(false);
+
+  g_fired.clear();
+  after(&loop, 2, 0.1);
+  after(&loop, 1, 0.05);
+  after(&loop, 0, 0.02);
+  TimerId cancelled = after(&loop, 9, 0.06);
+  loop.cancel(cancelled);
+  loop.runAfter(0.2, [&loop] { loop.quit(); });
+  loop.loop();
+  // fired but the cancelled, in order
+  BOOST_REQUIRE_EQUAL(g_fired.size(), 3);
+  for (size_t i = 0; i < g_fired.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(g_fired[i].id, static_cast<int>(i));
+    // never early, at most a few ms late
+    double late = timeDifference(g_fired[i].at, g_fired[i].due);
+    BOOST_CHECK_GE(late, 0);
+    BOOST_CHECK_LT(late, 0.02);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testAddedFromAnotherThread)
+{
+  EventLoop loop;
+  loop.setTimerfd(false);
+
+  // added while the loop sleeps
+  g_fired.clear();
+  loop.runAfter(0.3, [&loop] { loop.quit(); });
+  Thread thread([&loop] {
+    CurrentThread::sleepUsec(50 * 1000);
+    after(&loop, 0, 0.05);
+  });
+  thread.start();
+  loop.loop();
+  thread.join();
+  BOOST_REQUIRE_EQUAL(g_fired.size(), 1);
+  BOOST_CHECK_LT(timeDifference(g_fired[0].at, g_fired[0].due), 0.02);
+}
+
+BOOST_AUTO_TEST_CASE(testTimerSlack)
+{
+  EventLoop loop;
+  loop.setTimerfd(false);
+
+  // runEvery() timers aligned to the slack
+  const double kSlack = 0.05;
+  const int64_t kSlackUs = static_cast<int64_t>(kSlack * Timestamp::kMicroSecondsPerSecond);
+  loop.setTimerSlack(kSlack);
+  std::vector<Timestamp> ticks;
+  TimerId every3 = loop.runEvery(0.03, [&ticks] { ticks.push_back(Timestamp::now()); });
+  TimerId every4 = loop.runEvery(0.04, [&ticks] { ticks.push_back(Timestamp::now()); });
+  loop.runAfter(0.5, [&loop] { loop.quit(); });
+  loop.loop();
+  loop.cancel(every3);
+  loop.cancel(every4);
+  BOOST_CHECK_GE(ticks.size(), 10);
+  for (Timestamp tick : ticks)
+  {
+    BOOST_CHECK_LT(tick.microSecondsSinceEpoch() % kSlackUs, 10 * 1000);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testAddAndCancel)
+{
+  EventLoop loop;
+  const int kTimers = 100 * 1000;
+  loop.setTimerfd(false);
+  double pollUs = addAndCancel(&loop, kTimers);
+  loop.setTimerfd(true);
+  double timerfdUs = addAndCancel(&loop, kTimers);
+  printf("runAfter + cancel: poll timeout %.3f us, timerfd %.3f us\n", pollUs, timerfdUs);
+}
@@ -0,0 +1,184 @@
+// Per connection traffic of TcpServer, the chatty client tops bytes in,
+// and the totals keep closed connections. Files sent count once, over TLS too.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+#ifdef HAVE_OPENSSL
+#include "muduo/net/tls/tests/SelfSignedCertificate.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+//#define BOOST_TEST_MODULE TrafficTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+#ifdef HAVE_OPENSSL
+using muduo::net::test::useSelfSignedCertificate;
+#endif
+
+namespace
+{
+
+// in IO loops
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf->peek(), 1);
+  buf->retrieveAll();
+}
+
+void sendOnConnect(const TcpConnectionPtr& conn, size_t bytes)
+{
+  if (conn->connected())
+  {
+    conn->send(string(bytes, 'x'));
+  }
+}
+
+const int64_t kBytesIn = 1024 * 1024 + 10 + 1000;
+
+const size_t kFileSize = 300 * 1000; // several sendFileSome() chunks
+int g_fd = -1;
+
+void sendFileOnConnect(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->sendFile(g_fd, 0, kFileSize);
+  }
+}
+
+void countMessage(size_t* received, Buffer* buf)
+{
+  *received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+// the server only sends the file, its bytes out are the file size
+void runSendFile(const TlsContextPtr& serverTls, const TlsContextPtr& clientTls)
+{
+  char path[] = "/tmp/muduo_traffic_XXXXXX";
+  g_fd = ::mkstemp(path);
+  BOOST_REQUIRE_GE(g_fd, 0);
+  ::unlink(path);
+  string content(kFileSize, 'x');
+  BOOST_REQUIRE_EQUAL(::write(g_fd, content.data(), content.size()),
+                      static_cast<ssize_t>(content.size()));
+
+  EventLoop loop;
+  {
+    InetAddress addr("127.0.0.1", 23475);
+    TcpServer server(&loop, addr, "TrafficFile");
+    if (serverTls)
+    {
+      server.setTlsContext(serverTls);
+    }
+    server.setThreadNum(1);
+    server.setConnectionCallback(sendFileOnConnect);
+    server.start();
+
+    size_t received = 0;
+    TcpClient client(&loop, addr, "Receiver");
+    if (clientTls)
+    {
+      client.setTlsContext(clientTls);
+    }
+    client.setMessageCallback(std::bind(countMessage, &received, _2));
+    client.connect();
+    BOOST_CHECK(runUntil(&loop, [&received] { return received == kFileSize; }, 30));
+
+    TcpServer::TrafficSnapshot snapshot = server.trafficSnapshot();
+    BOOST_REQUIRE_EQUAL(snapshot.connections.size(), 1);
+    BOOST_CHECK_EQUAL(snapshot.total.bytesOut, static_cast<int64_t>(kFileSize));
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+  ::close(g_fd);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testTraffic)
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  {
+    InetAddress addr("127.0.0.1", 23474);
+    TcpServer server(&loop, addr, "Traffic");
+    server.setThreadNum(2);
+    server.setTimeMessageCallbacks(true);
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    TcpClient chatty(&loop, addr, "Chatty");
+    chatty.setConnectionCallback(std::bind(sendOnConnect, _1, 1024 * 1024));
+    chatty.connect();
+    TcpClient quiet(&loop, addr, "Quiet");
+    quiet.setConnectionCallback(std::bind(sendOnConnect, _1, 10));
+    quiet.connect();
+    TcpClient gone(&loop, addr, "Gone");
+    gone.setConnectionCallback(std::bind(sendOnConnect, _1, 1000));
+    gone.connect();
+    BOOST_CHECK(runUntil(&loop, [&server] {
+      TcpServer::TrafficSnapshot snapshot = server.trafficSnapshot();
+      return snapshot.connections.size() == 3 && snapshot.total.bytesIn == kBytesIn;
+    }));
+
+    TcpServer::TrafficSnapshot before = server.trafficSnapshot();
+    BOOST_REQUIRE_EQUAL(before.connections.size(), 3);
+    BOOST_CHECK_EQUAL(before.total.bytesIn, kBytesIn);
+    // a reply per message
+    BOOST_CHECK_EQUAL(before.total.messagesIn, before.total.messagesOut);
+    BOOST_CHECK_GT(before.total.callbackMicroseconds, 0);
+    const TcpServer::ConnectionTraffic* top = &before.connections[0];
+    for (const TcpServer::ConnectionTraffic& conn : before.connections)
+    {
+      if (conn.traffic.bytesIn > top->traffic.bytesIn)
+      {
+        top = &conn;
+      }
+    }
+    // the chatty client tops bytes in
+    BOOST_CHECK_EQUAL(top->traffic.bytesIn, 1024 * 1024);
+    BOOST_CHECK_GT(top->traffic.inputHighWater, 10);
+
+    // the closed connection leaves the snapshot, the totals keep it
+    gone.disconnect();
+    BOOST_CHECK(runUntil(&loop, [&server] {
+      return server.trafficSnapshot().connections.size() == 2;
+    }));
+    TcpServer::TrafficSnapshot after = server.trafficSnapshot();
+    BOOST_CHECK_EQUAL(after.total.bytesIn, before.total.bytesIn);
+    BOOST_CHECK_EQUAL(after.total.bytesOut, before.total.bytesOut);
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testSendFileTraffic)
+{
+  Logger::setLogLevel(Logger::WARN);
+  runSendFile(TlsContextPtr(), TlsContextPtr());
+}
+
+#ifdef HAVE_OPENSSL
+// user space TLS writes the file in chunks, counted as written
+BOOST_AUTO_TEST_CASE(testSendFileTlsTraffic)
+{
+  Logger::setLogLevel(Logger::WARN);
+  std::shared_ptr<SslContext> serverCtx(new SslContext);
+  BOOST_REQUIRE_MESSAGE(useSelfSignedCertificate(serverCtx.get()),
+                        "certificate " << SslContext::errorString());
+  runSendFile(serverCtx, std::make_shared<SslContext>());
+}
+#endif
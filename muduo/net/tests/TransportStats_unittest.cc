@@ -0,0 +1,126 @@
+// TCP_INFO sampling of TcpServer connections, a client that doesn't read
+// is the worst by queued output.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/TransportStats.h"
+#include "muduo/net/tests/RunUntil.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+
+//#define BOOST_TEST_MODULE TransportStatsTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+
+namespace
+{
+
+const string g_payload(4 * 1024 * 1024, 'x');
+
+void sendPayload(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->send(g_payload);
+  }
+}
+
+void stopReading(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->stopRead();
+  }
+}
+
+struct WarnLogLevel
+{
+  WarnLogLevel() { Logger::setLogLevel(Logger::WARN); }
+};
+
+}  // namespace
+
+BOOST_GLOBAL_FIXTURE(WarnLogLevel);
+
+BOOST_AUTO_TEST_CASE(testHistogram)
+{
+  Log2Histogram h;
+  BOOST_CHECK_EQUAL(h.percentile(0.5), 0);
+  BOOST_CHECK_EQUAL(h.max(), 0);
+  for (uint64_t v = 1; v <= 100; ++v)
+  {
+    h.add(v);
+  }
+  BOOST_CHECK_EQUAL(h.count(), 100);
+  BOOST_CHECK_EQUAL(h.max(), 100);
+  BOOST_CHECK_EQUAL(h.mean(), 50.5);
+  // 50 is in [32, 64), 99 in [64, 128) capped by max
+  BOOST_CHECK_EQUAL(h.percentile(0.5), 63);
+  BOOST_CHECK_EQUAL(h.percentile(0.99), 100);
+  Log2Histogram other;
+  other.add(1000);
+  h.merge(other);
+  BOOST_CHECK_EQUAL(h.count(), 101);
+  BOOST_CHECK_EQUAL(h.max(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testSampling)
+{
+  EventLoop loop;
+  {
+    InetAddress addr("127.0.0.1", 23473);
+    TcpServer server(&loop, addr, "Transport");
+    server.setThreadNum(2);
+    server.setTransportSampling(0.1, 2);
+    server.setConnectionCallback(sendPayload);
+    server.start();
+
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < 3; ++i)
+    {
+      clients.emplace_back(new TcpClient(&loop, addr, "Reader"));
+      clients.back()->connect();
+    }
+    TcpClient slow(&loop, addr, "Slow");
+    slow.setConnectionCallback(stopReading);
+    slow.connect();
+
+    // all connections sampled, the readers have drained their payload
+    BOOST_CHECK(runUntil(&loop, [&server] {
+      TransportStats stats = server.transportStats();
+      return stats.connections == 4 && stats.rtt.count() == 4 &&
+          stats.outputBytes.max() > 0 && stats.outputBytes.percentile(0.5) == 0;
+    }));
+
+    TransportStats stats = server.transportStats();
+    BOOST_CHECK_EQUAL(stats.connections, 4);
+    BOOST_CHECK_EQUAL(stats.rtt.count(), 4);
+    BOOST_CHECK(stats.sampled.valid());
+    // worst of each key kept
+    BOOST_CHECK_LE(stats.worst.size(), 4);
+    BOOST_CHECK(!stats.worst.empty());
+    // the slow reader is the worst by output, readers have nothing queued
+    stats.sortWorst(TransportStats::kByOutputBytes, 1);
+    BOOST_REQUIRE_EQUAL(stats.worst.size(), 1);
+    BOOST_CHECK_GT(stats.worst[0].outputBytes, 0);
+    BOOST_CHECK_GT(stats.outputBytes.max(), 0);
+    BOOST_CHECK_EQUAL(stats.outputBytes.percentile(0.5), 0);
+    printf("slow reader: rtt %u us, cwnd %u, output %zd bytes, not sent %u bytes\n",
+           stats.worst[0].rtt, stats.worst[0].cwnd, stats.worst[0].outputBytes,
+           stats.worst[0].notsentBytes);
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
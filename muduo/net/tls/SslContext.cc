@@ -0,0 +1,283 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/tls/SslContext.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Buffer.h"
+
+#include <errno.h>
+#include <limits.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// One SSL per TcpConnection, reads and writes the sockfd directly
+// with a socket BIO, which is what kTLS requires.
+class SslEngine : public TlsEngine
+{
+ public:
+  SslEngine(SSL* ssl, bool isServer)
+    : ssl_(ssl),
+      kernelSend_(false)
+  {
+    if (isServer)
+    {
+      SSL_set_accept_state(ssl_);
+    }
+    else
+    {
+      SSL_set_connect_state(ssl_);
+    }
+  }
+
+  ~SslEngine() override
+  {
+    SSL_free(ssl_);
+  }
+
+  HandshakeState handshake() override
+  {
+    ERR_clear_error();
+    int ret = SSL_do_handshake(ssl_);
+    if (ret == 1)
+    {
+#ifdef BIO_get_ktls_send
+      kernelSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl_)) > 0;
+#endif
+      LOG_DEBUG << "SslEngine::handshake " << SSL_get_version(ssl_)
+                << " " << SSL_get_cipher_name(ssl_);
+      return kHandshakeDone;
+    }
+    int err = SSL_get_error(ssl_, ret);
+    if (err == SSL_ERROR_WANT_READ)
+    {
+      return kHandshakeWantRead;
+    }
+    else if (err == SSL_ERROR_WANT_WRITE)
+    {
+      return kHandshakeWantWrite;
+    }
+    LOG_ERROR << "SslEngine::handshake SSL_get_error = " << err
+              << " " << SslContext::errorString();
+    return kHandshakeFailed;
+  }
+
+  ssize_t read(Buffer* buf, int* savedErrno) override
+  {
+    const size_t kChunk = 16 * 1024; // max TLS record
+    ssize_t total = 0;
+    ERR_clear_error();
+    while (true)
+    {
+      buf->ensureWritableBytes(kChunk);
+      errno = 0;
+      int n = SSL_read(ssl_, buf->beginWrite(), static_cast<int>(buf->writableBytes()));
+      if (n > 0)
+      {
+        buf->hasWritten(n);
+        total += n;
+        continue;
+      }
+      int err = SSL_get_error(ssl_, n);
+      if (total > 0)
+      {
+        // EOF or error will be reported again on next readable event.
+        return total;
+      }
+      if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+      {
+        *savedErrno = EWOULDBLOCK;
+        return -1;
+      }
+      else if (err == SSL_ERROR_ZERO_RETURN)
+      {
+        return 0; // close_notify
+      }
+      else if (err == SSL_ERROR_SYSCALL)
+      {
+        if (errno == 0)
+        {
+          return 0; // EOF without close_notify, treat as FIN
+        }
+        *savedErrno = errno;
+        return -1;
+      }
+      LOG_ERROR << "SslEngine::read " << SslContext::errorString();
+      *savedErrno = EPROTO;
+      return -1;
+    }
+  }
+
+  ssize_t write(const void* data, size_t len) override
+  {
+    ERR_clear_error();
+    errno = 0;
+    int n = SSL_write(ssl_, data, static_cast<int>(std::min(len, implicit_cast<size_t>(INT_MAX))));
+    if (n > 0)
+    {
+      return n;
+    }
+    int err = SSL_get_error(ssl_, n);
+    if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+    {
+      errno = EWOULDBLOCK;
+    }
+    else if (err != SSL_ERROR_SYSCALL || errno == 0)
+    {
+      LOG_ERROR << "SslEngine::write " << SslContext::errorString();
+      errno = EPIPE;
+    }
+    return -1;
+  }
+
+  void shutdown() override
+  {
+    ERR_clear_error();
+    // don't wait for peer's close_notify, a FIN follows.
+    SSL_shutdown(ssl_);
+  }
+
+  bool kernelSend() const override
+  {
+    return kernelSend_;
+  }
+
+ private:
+  SSL* ssl_;
+  bool kernelSend_;
+};
+
+}  // namespace
+
+SslContext::SslContext()
+  : ctx_(SSL_CTX_new(TLS_method()))
+{
+  if (ctx_ == NULL)
+  {
+    LOG_FATAL << "SSL_CTX_new " << errorString();
+  }
+  SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+  // TcpConnection retries from outputBuffer_, which may have moved or grown.
+  SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                         SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                         SSL_MODE_RELEASE_BUFFERS);
+  SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, NULL);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+  // like plain TCP, a FIN without close_notify is a normal close.
+  SSL_CTX_set_options(ctx_, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+}
+
+SslContext::~SslContext()
+{
+  SSL_CTX_free(ctx_);
+}
+
+bool SslContext::useCertificateChainFile(const string& certFile)
+{
+  if (SSL_CTX_use_certificate_chain_file(ctx_, certFile.c_str()) != 1)
+  {
+    LOG_ERROR << "SslContext::useCertificateChainFile " << certFile << " " << errorString();
+    return false;
+  }
+  return true;
+}
+
+bool SslContext::usePrivateKeyFile(const string& keyFile)
+{
+  if (SSL_CTX_use_PrivateKey_file(ctx_, keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+      || SSL_CTX_check_private_key(ctx_) != 1)
+  {
+    LOG_ERROR << "SslContext::usePrivateKeyFile " << keyFile << " " << errorString();
+    return false;
+  }
+  return true;
+}
+
+bool SslContext::loadVerifyLocations(const string& caFile)
+{
+  if (SSL_CTX_load_verify_locations(ctx_, caFile.c_str(), NULL) != 1)
+  {
+    LOG_ERROR << "SslContext::loadVerifyLocations " << caFile << " " << errorString();
+    return false;
+  }
+  return true;
+}
+
+void SslContext::setVerifyPeer(bool on)
+{
+  SSL_CTX_set_verify(ctx_, on ? SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT : SSL_VERIFY_NONE, NULL);
+}
+
+void SslContext::enableKernelTls(bool on)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  if (on)
+  {
+    SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+  }
+  else
+  {
+    SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS);
+  }
+#else
+  if (on)
+  {
+    LOG_WARN << "SslContext::enableKernelTls - OpenSSL built without kTLS";
+  }
+#endif
+}
+
+std::unique_ptr<TlsEngine> SslContext::newEngine(int sockfd, bool isServer)
+{
+  std::unique_ptr<TlsEngine> engine;
+  SSL* ssl = SSL_new(ctx_);
+  if (ssl == NULL)
+  {
+    LOG_ERROR << "SSL_new " << errorString();
+    return engine;
+  }
+  if (SSL_set_fd(ssl, sockfd) != 1)
+  {
+    LOG_ERROR << "SSL_set_fd " << errorString();
+    SSL_free(ssl);
+    return engine;
+  }
+  if (!isServer && !hostName_.empty())
+  {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+    SSL_set_tlsext_host_name(ssl, hostName_.c_str());
+#pragma GCC diagnostic pop
+    SSL_set1_host(ssl, hostName_.c_str());
+  }
+  engine.reset(new SslEngine(ssl, isServer));
+  return engine;
+}
+
+string SslContext::errorString()
+{
+  string result;
+  unsigned long err;
+  while ((err = ERR_get_error()) != 0)
+  {
+    char buf[256];
+    ERR_error_string_n(err, buf, sizeof buf);
+    if (!result.empty())
+    {
+      result += "; ";
+    }
+    result += buf;
+  }
+  return result;
+}
@@ -0,0 +1,66 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TLS_SSLCONTEXT_H
+#define MUDUO_NET_TLS_SSLCONTEXT_H
+
+#include "muduo/base/Types.h"
+#include "muduo/net/TlsContext.h"
+
+// avoid including <openssl/ssl.h> in public header
+typedef struct ssl_ctx_st SSL_CTX;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// OpenSSL backed TlsContext, for both TcpServer and TcpClient.
+///
+/// The handshake is done in the connection's EventLoop,
+/// if enableKernelTls() and the kernel supports it (Linux 4.13+, tls.ko),
+/// record encryption is then handed to the kernel via TCP_ULP "tls",
+/// so large writes and sendfile(2) don't go through user space.
+///
+/// Configure it before passing to TcpServer/TcpClient, it's not thread safe.
+class SslContext : public TlsContext
+{
+ public:
+  SslContext();
+  ~SslContext() override;
+
+  /// PEM files, return false and log errors on failure.
+  bool useCertificateChainFile(const string& certFile);
+  bool usePrivateKeyFile(const string& keyFile);
+  bool loadVerifyLocations(const string& caFile);
+
+  /// Verifies peer's certificate, default off.
+  void setVerifyPeer(bool on);
+  /// Client side, for SNI and hostname verification.
+  void setHostName(const string& hostName) { hostName_ = hostName; }
+  /// Offloads record encryption to kernel TLS when available, default off.
+  void enableKernelTls(bool on);
+
+  /// For anything not covered above, eg. in-memory certificates.
+  SSL_CTX* nativeHandle() { return ctx_; }
+
+  std::unique_ptr<TlsEngine> newEngine(int sockfd, bool isServer) override;
+
+  /// Drains OpenSSL's error queue of this thread.
+  static string errorString();
+
+ private:
+  SSL_CTX* ctx_;
+  string hostName_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TLS_SSLCONTEXT_H
@@ -0,0 +1,55 @@
+// In-memory self-signed certificate for the loopback TLS tests.
+
+#ifndef MUDUO_NET_TLS_TESTS_SELFSIGNEDCERTIFICATE_H
+#define MUDUO_NET_TLS_TESTS_SELFSIGNEDCERTIFICATE_H
+
+#include "muduo/net/tls/SslContext.h"
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+namespace muduo
+{
+namespace net
+{
+namespace test
+{
+
+// self-signed P-256 certificate for CN=localhost
+inline bool useSelfSignedCertificate(SslContext* ctx)
+{
+  EVP_PKEY* pkey = NULL;
+  EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  bool ok = pctx != NULL
+      && EVP_PKEY_keygen_init(pctx) > 0
+      && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) > 0
+      && EVP_PKEY_keygen(pctx, &pkey) > 0;
+  EVP_PKEY_CTX_free(pctx);
+
+  X509* x509 = X509_new();
+  if (ok)
+  {
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME* name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    ok = X509_sign(x509, pkey, EVP_sha256()) > 0
+        && SSL_CTX_use_certificate(ctx->nativeHandle(), x509) == 1
+        && SSL_CTX_use_PrivateKey(ctx->nativeHandle(), pkey) == 1;
+  }
+  X509_free(x509);
+  EVP_PKEY_free(pkey);
+  return ok;
+}
+
+}  // namespace test
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TLS_TESTS_SELFSIGNEDCERTIFICATE_H
@@ -0,0 +1,158 @@
+// TLS echo over loopback with an in-memory self-signed certificate.
+
+#include "muduo/net/tls/SslContext.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/tests/RunUntil.h"
+#include "muduo/net/tls/tests/SelfSignedCertificate.h"
+
+#include <string.h>
+
+//#define BOOST_TEST_MODULE TlsTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+using muduo::net::test::runFor;
+using muduo::net::test::runUntil;
+using muduo::net::test::useSelfSignedCertificate;
+
+namespace
+{
+
+const size_t kMessageSize = 4 * 1024 * 1024;
+
+class EchoServer
+{
+ public:
+  EchoServer(EventLoop* loop, const InetAddress& listenAddr, const TlsContextPtr& tls)
+    : server_(loop, listenAddr, "TlsEchoServer")
+  {
+    server_.setTlsContext(tls);
+    server_.setConnectionCallback(
+        std::bind(&EchoServer::onConnection, this, _1));
+    server_.setMessageCallback(
+        std::bind(&EchoServer::onMessage, this, _1, _2, _3));
+  }
+
+  void start() { server_.start(); }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    LOG_INFO << "server " << conn->name() << (conn->connected() ? " UP" : " DOWN")
+             << (conn->isKernelTls() ? " kTLS" : "");
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    conn->send(buf);
+  }
+
+  TcpServer server_;
+};
+
+class EchoClient
+{
+ public:
+  EchoClient(EventLoop* loop, const InetAddress& serverAddr, const TlsContextPtr& tls)
+    : client_(loop, serverAddr, "TlsEchoClient"),
+      received_(0),
+      ok_(false),
+      closed_(false)
+  {
+    client_.setTlsContext(tls);
+    client_.setConnectionCallback(
+        std::bind(&EchoClient::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&EchoClient::onMessage, this, _1, _2, _3));
+    for (size_t i = 0; i < kMessageSize; ++i)
+    {
+      message_.push_back(static_cast<char>('A' + i % 61));
+    }
+  }
+
+  void connect() { client_.connect(); }
+  bool ok() const { return ok_; }
+  bool closed() const { return closed_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    LOG_INFO << "client " << conn->name() << (conn->connected() ? " UP" : " DOWN");
+    if (conn->connected())
+    {
+      conn->send(message_);
+    }
+    else
+    {
+      closed_ = true;
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    size_t n = buf->readableBytes();
+    if (memcmp(buf->peek(), message_.data() + received_, n) != 0)
+    {
+      LOG_ERROR << "mismatch at " << received_;
+      conn->shutdown();
+    }
+    received_ += n;
+    buf->retrieveAll();
+    if (received_ == message_.size())
+    {
+      ok_ = true;
+      conn->shutdown();
+    }
+  }
+
+  TcpClient client_;
+  string message_;
+  size_t received_;
+  bool ok_;
+  bool closed_;
+};
+
+// echoes a message bigger than a TLS record, the client closes when it's back
+void runEcho(bool ktls)
+{
+  std::shared_ptr<SslContext> serverCtx(new SslContext);
+  BOOST_REQUIRE_MESSAGE(useSelfSignedCertificate(serverCtx.get()),
+                        "certificate " << SslContext::errorString());
+  std::shared_ptr<SslContext> clientCtx(new SslContext);
+  serverCtx->enableKernelTls(ktls);
+  clientCtx->enableKernelTls(ktls);
+
+  EventLoop loop;
+  {
+    InetAddress listenAddr("127.0.0.1", 23456);
+    EchoServer server(&loop, listenAddr, serverCtx);
+    server.start();
+    EchoClient client(&loop, listenAddr, clientCtx);
+    client.connect();
+    BOOST_CHECK(runUntil(&loop, [&client] { return client.closed(); }, 30));
+    BOOST_CHECK(client.ok());
+  }
+  // let connections still closing finish
+  runFor(&loop, 0.1);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testEcho)
+{
+  runEcho(false);
+}
+
+// falls back to user space TLS where the kernel has no tls module
+BOOST_AUTO_TEST_CASE(testKernelTlsEcho)
+{
+  runEcho(true);
+}